@@ -0,0 +1,190 @@
+/**
+ * @file concurrent_queue.h
+ * @brief Lock-free queues for passing work between threads.
+ */
+
+#ifndef CONCURRENT_QUEUE_H
+#define CONCURRENT_QUEUE_H
+
+#include <atomic>
+#include <utility>
+
+/**
+ * @class SpscQueue
+ * @brief Unbounded single-producer, single-consumer FIFO queue.
+ *
+ * A linked list with a dummy head: the producer only touches the tail and the consumer only
+ * the head, and the release/acquire pair on the link publishes each value. Neither side ever
+ * blocks or takes a lock.
+ *
+ * @tparam T Value type; must be default constructible and movable.
+ */
+template <typename T>
+class SpscQueue {
+public:
+
+    SpscQueue() : head(new Node), tail(head) {}
+
+    ~SpscQueue() {
+
+        while (head != nullptr) {
+
+            Node *next = head->next.load(std::memory_order_relaxed);
+            delete head;
+            head = next;
+
+        }
+
+    }
+
+    SpscQueue(const SpscQueue &) = delete;
+    SpscQueue& operator=(const SpscQueue &) = delete;
+
+    /**
+     * Appends a value; called by the producer thread only.
+     * @param value The value to append.
+     */
+    void
+    push(T value) {
+
+        Node *node = new Node;
+        node->value = std::move(value);
+
+        tail->next.store(node, std::memory_order_release);
+        tail = node;
+
+    }
+
+    /**
+     * Removes the oldest value; called by the consumer thread only.
+     * @param value Receives the removed value.
+     * @return False if the queue was empty.
+     */
+    bool
+    pop(T &value) {
+
+        Node *next = head->next.load(std::memory_order_acquire);
+
+        if (next == nullptr) return false;
+
+        value = std::move(next->value);
+        next->value = T();
+
+        delete head;
+        head = next;
+
+        return true;
+
+    }
+
+private:
+
+    /**
+     * @struct Node
+     * @brief A list node; the node at the head is a dummy whose value has been taken.
+     */
+    struct Node {
+        T value;
+        std::atomic<Node*> next{nullptr};
+    };
+
+    Node *head;     ///< Consumer side.
+    Node *tail;     ///< Producer side.
+};
+
+/**
+ * @class MpscQueue
+ * @brief Unbounded multi-producer, single-consumer FIFO queue after Vyukov.
+ *
+ * Producers append with a single atomic exchange on the head and then link the previous node,
+ * so pushes never block each other. The consumer follows the links from the tail. Between the
+ * exchange and the link a pushed value is not yet visible; pop() then reports an empty queue and
+ * the producer's subsequent notification (e.g. scheduling the consumer) covers the value.
+ *
+ * @tparam T Value type; must be default constructible and movable.
+ */
+template <typename T>
+class MpscQueue {
+public:
+
+    MpscQueue() : head(new Node), tail(head.load(std::memory_order_relaxed)) {}
+
+    ~MpscQueue() {
+
+        while (tail != nullptr) {
+
+            Node *next = tail->next.load(std::memory_order_relaxed);
+            delete tail;
+            tail = next;
+
+        }
+
+    }
+
+    MpscQueue(const MpscQueue &) = delete;
+    MpscQueue& operator=(const MpscQueue &) = delete;
+
+    /**
+     * Appends a value; safe to call from any number of threads.
+     * @param value The value to append.
+     */
+    void
+    push(T value) {
+
+        Node *node = new Node;
+        node->value = std::move(value);
+
+        Node *previous = head.exchange(node, std::memory_order_acq_rel);
+        previous->next.store(node, std::memory_order_release);
+
+    }
+
+    /**
+     * Removes the oldest value; called by the consumer thread only.
+     * @param value Receives the removed value.
+     * @return False if no linked value is available.
+     */
+    bool
+    pop(T &value) {
+
+        Node *next = tail->next.load(std::memory_order_acquire);
+
+        if (next == nullptr) return false;
+
+        value = std::move(next->value);
+        next->value = T();
+
+        delete tail;
+        tail = next;
+
+        return true;
+
+    }
+
+    /**
+     * Checks for a linked value; called by the consumer thread only.
+     * @return True if pop() would fail.
+     */
+    bool
+    empty() const {
+
+        return tail->next.load(std::memory_order_acquire) == nullptr;
+
+    }
+
+private:
+
+    /**
+     * @struct Node
+     * @brief A list node; the node at the tail is a dummy whose value has been taken.
+     */
+    struct Node {
+        T value;
+        std::atomic<Node*> next{nullptr};
+    };
+
+    std::atomic<Node*> head;    ///< Producer side: the most recently pushed node.
+    Node *tail;                 ///< Consumer side.
+};
+
+#endif
@@ -0,0 +1,151 @@
+/**
+ * @file coroutine.h
+ * @brief Stackless coroutines and a pool allocator for their frames.
+ *
+ * A coroutine is a resume function whose body is wrapped in CO_BEGIN and CO_END. CO_AWAIT
+ * records the point it was reached at in the coroutine's frame and returns to the caller until
+ * the awaited condition holds; the next call jumps straight back to that point. The frame holds
+ * all state that has to survive a suspension, so local variables of the resume function must not
+ * be used across a CO_AWAIT. A suspended coroutine costs only its frame, which makes millions of
+ * them practical where millions of threads are not.
+ */
+
+#ifndef COROUTINE_H
+#define COROUTINE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+/**
+ * Starts the body of a coroutine; frame.line holds the resume point, 0 for a coroutine that has not run yet.
+ */
+#define CO_BEGIN(frame) switch ((frame).line) { case 0:
+
+/**
+ * Suspends the coroutine until the condition holds; it is evaluated on every resumption.
+ * The resume point is entered only by the switch, never by falling through from the return before it.
+ */
+#define CO_AWAIT(frame, condition) \
+    do { if (!(condition)) { (frame).line = __LINE__; return; case __LINE__: if (!(condition)) return; } } while (0)
+
+/**
+ * Ends the body of a coroutine; a finished coroutine stays at its end and returns immediately when resumed.
+ */
+#define CO_END(frame) (frame).line = UINT32_MAX; return; case UINT32_MAX: ; }
+
+/**
+ * @class FramePool
+ * @brief Allocates fixed-size coroutine frames from large chunks and recycles freed ones.
+ *
+ * Frames are carved out of chunks of many frames, so each frame costs its size without any
+ * per-allocation header, and frames allocated together lie next to each other in memory.
+ *
+ * @tparam Frame The frame type; must be default constructible.
+ */
+template <typename Frame>
+class FramePool {
+public:
+
+    /**
+     * @param chunkFrames The number of frames allocated at a time.
+     */
+    explicit FramePool(std::size_t chunkFrames = 4096) : chunkFrames(chunkFrames > 0 ? chunkFrames : 1) {}
+
+    ~FramePool() {
+
+        for (auto &chunk : chunks) {
+            for (std::size_t i = 0; i < chunk.used; ++i) reinterpret_cast<Frame*>(chunk.storage.get())[i].~Frame();
+        }
+
+    }
+
+    FramePool(const FramePool &) = delete;
+    FramePool& operator=(const FramePool &) = delete;
+
+    /**
+     * @return A default-constructed frame.
+     */
+    Frame*
+    allocate() {
+
+        ++live;
+
+        if (!freeList.empty()) {
+
+            Frame *frame = freeList.back();
+            freeList.pop_back();
+            *frame = Frame();
+
+            return frame;
+
+        }
+
+        if (chunks.empty() || chunks.back().used == chunkFrames) {
+
+            chunks.emplace_back();
+            chunks.back().storage.reset(new Storage[chunkFrames]);
+
+        }
+
+        Chunk &chunk = chunks.back();
+
+        return new (reinterpret_cast<Frame*>(chunk.storage.get()) + chunk.used++) Frame();
+
+    }
+
+    /**
+     * Returns a frame to the pool for reuse.
+     * @param frame A frame obtained from allocate().
+     */
+    void
+    release(Frame *frame) {
+
+        --live;
+        freeList.push_back(frame);
+
+    }
+
+    /**
+     * @return The number of frames currently allocated.
+     */
+    std::size_t
+    size() const {
+
+        return live;
+
+    }
+
+    /**
+     * @return The bytes reserved for frames, including free ones.
+     */
+    std::size_t
+    memoryBytes() const {
+
+        return chunks.size() * chunkFrames * sizeof(Frame) + freeList.capacity() * sizeof(Frame*);
+
+    }
+
+private:
+
+    typedef typename std::aligned_storage<sizeof(Frame), alignof(Frame)>::type Storage;
+
+    /**
+     * @struct Chunk
+     * @brief A block of frames; the first `used` of them have been constructed.
+     */
+    struct Chunk {
+        std::unique_ptr<Storage[]> storage;
+        std::size_t used = 0;
+    };
+
+    std::size_t chunkFrames;
+    std::vector<Chunk> chunks;
+    std::vector<Frame*> freeList;
+    std::size_t live = 0;
+};
+
+#endif
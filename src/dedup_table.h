@@ -0,0 +1,160 @@
+/**
+ * @file dedup_table.h
+ * @brief Forwarding tables split into fixed-size blocks that routers with equal blocks share.
+ *
+ * Every router's next hop vector is cut into blocks of consecutive destinations. Each block is
+ * hashed and looked up among the blocks stored so far; an equal block is reused, so routers that
+ * reach the same destinations through the same next hop, such as the stubs behind one uplink,
+ * store those entries once. A router keeps one block number per block, and a lookup reads the
+ * block number and then the entry: O(1) with two memory accesses.
+ */
+
+#ifndef DEDUP_TABLE_H
+#define DEDUP_TABLE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @class DedupNextHopTable
+ * @brief Next hops of n routers toward n destinations, numbered 0 to n - 1, in shared blocks.
+ */
+class DedupNextHopTable {
+public:
+
+    /**
+     * @param nextHops nextHops[r][d]: the next hop of router r toward d, r itself for d == r, or -1 if unreachable.
+     * @param order The destinations in the order the blocks follow, e.g. from reverseCuthillMcKee.
+     * @param blockSize The destinations per block, at least 1.
+     */
+    DedupNextHopTable(const std::vector<std::vector<int>> &nextHops, const std::vector<int> &order, std::size_t blockSize)
+        : blockSize(std::max<std::size_t>(blockSize, 1)), position(order.size()) {
+
+        std::size_t n = order.size();
+        std::unordered_map<uint64_t, std::vector<uint32_t>> byHash;
+        std::vector<int> block(this->blockSize);
+
+        blocksPerRouter = (n + this->blockSize - 1) / this->blockSize;
+
+        for (std::size_t p = 0; p < n; ++p) position[order[p]] = p;
+
+        for (std::size_t r = 0; r < nextHops.size(); ++r) {
+
+            for (std::size_t b = 0; b < blocksPerRouter; ++b) {
+
+                std::size_t self = this->blockSize;
+
+                for (std::size_t i = 0; i < this->blockSize; ++i) {
+
+                    std::size_t p = b * this->blockSize + i;
+
+                    block[i] = (p < n) ? nextHops[r][order[p]] : -1;
+
+                    if (p < n && order[p] == static_cast<int>(r)) self = i;
+
+                }
+
+                // The router's own entry is answered without the blocks, so it takes a neighbouring value
+                // and lets the block match those of routers that differ from it only there
+                if (self < this->blockSize) block[self] = (self > 0) ? block[self - 1] : (this->blockSize > 1 ? block[1] : -1);
+
+                blocks.push_back(intern(block, byHash));
+
+            }
+
+        }
+
+        pool.shrink_to_fit();
+        blocks.shrink_to_fit();
+
+    }
+
+    /**
+     * @return The next hop of a router toward a destination, the router itself for its own entry, or -1 if unreachable.
+     */
+    int
+    nextHop(int router, int destination) const {
+
+        if (router == destination) return router;
+
+        std::size_t p = position[destination];
+
+        return pool[static_cast<std::size_t>(blocks[router * blocksPerRouter + p / blockSize]) * blockSize + p % blockSize];
+
+    }
+
+    /**
+     * @return The number of blocks of all routers.
+     */
+    std::size_t
+    blockCount() const {
+
+        return blocks.size();
+
+    }
+
+    /**
+     * @return The number of distinct blocks stored.
+     */
+    std::size_t
+    uniqueBlocks() const {
+
+        return pool.size() / blockSize;
+
+    }
+
+    /**
+     * @return The bytes of the shared blocks, the per-router block numbers and the destination positions.
+     */
+    std::size_t
+    memoryBytes() const {
+
+        return pool.capacity() * sizeof(int) + (blocks.capacity() + position.capacity()) * sizeof(uint32_t);
+
+    }
+
+private:
+
+    /**
+     * @return The number of the stored block equal to a block, storing it first if there is none.
+     */
+    uint32_t
+    intern(const std::vector<int> &block, std::unordered_map<uint64_t, std::vector<uint32_t>> &byHash) {
+
+        // FNV-1a over the block's bytes
+        uint64_t hash = 14695981039346656037ULL;
+
+        for (int hop : block) {
+            for (int shift = 0; shift < 32; shift += 8) {
+                hash = (hash ^ ((static_cast<uint32_t>(hop) >> shift) & 0xff)) * 1099511628211ULL;
+            }
+        }
+
+        std::vector<uint32_t> &candidates = byHash[hash];
+
+        for (uint32_t candidate : candidates) {
+            if (std::equal(block.begin(), block.end(), pool.begin() + static_cast<std::size_t>(candidate) * blockSize)) {
+                return candidate;
+            }
+        }
+
+        uint32_t number = pool.size() / blockSize;
+
+        pool.insert(pool.end(), block.begin(), block.end());
+        candidates.push_back(number);
+
+        return number;
+
+    }
+
+    std::size_t blockSize;
+    std::size_t blocksPerRouter = 0;
+    std::vector<uint32_t> position;     ///< The place of every destination in the order.
+    std::vector<uint32_t> blocks;       ///< The block number of every block of every router, router by router.
+    std::vector<int> pool;              ///< The distinct blocks, back to back.
+};
+
+#endif
@@ -14,9 +14,40 @@
 #include <vector>
 #include <utility>
 #include <climits>
+#include <limits>
+#include <cstdlib>
 #include <set>
 #include <map>
 #include <ios>
+#include <memory>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <cerrno>
+#include <cstring>
+#include <atomic>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "concurrent_queue.h"
+#include "coroutine.h"
+#include "dedup_table.h"
+#include "flap_damping.h"
+#include "graph_partition.h"
+#include "latency_histogram.h"
+#include "lpm.h"
+#include "interval_table.h"
+#include "memory_footprint.h"
+#include "packed_table.h"
+#include "packet_sim.h"
+#include "thread_pool.h"
+#include "versioned_table.h"
+#include "work_stealing_pool.h"
 
 /**
  * @struct Link
@@ -31,6 +62,35 @@ struct Link {
     int pathCost;
 };
 
+/**
+ * Kinds of change records.
+ */
+enum ChangeKind {
+    LinkChange,     ///< Adds a link, changes its cost or, with cost -999, removes it.
+    RouterDown,     ///< Takes a router down with all its links.
+    RouterUp        ///< Brings a router back up with the links it had.
+};
+
+/**
+ * @struct Change
+ * @brief One record of a changes file. A router record names the router as both nodes and has no path cost.
+ */
+struct Change {
+    ChangeKind kind;
+    int node1;
+    int node2;
+    int pathCost;
+};
+
+/**
+ * @struct FailedRouters
+ * @brief Routers taken down by change records and the links that went down with them.
+ */
+struct FailedRouters {
+    std::set<int> down;
+    std::vector<Link> links;    ///< Links with a down end; restored once both ends are up again.
+};
+
 /**
  * @struct Message
  * @brief Represents a message to be routed through the network.
@@ -45,6 +105,61 @@ struct Message {
     std::string message;
 };
 
+/**
+ * @struct Options
+ * @brief Optional features selected on the command line.
+ */
+struct Options {
+    bool keepHistory = false;   ///< Record the routing tables of every epoch in a VersionedTable.
+    int queryEpoch = -1;        ///< Epoch whose recorded tables are printed after the run, or -1 for none.
+    std::string journalFile;    ///< Change journal to write, or to read from when seeking; empty for none.
+    int snapshotEvery = 16;     ///< Number of epochs between two full snapshots in the journal.
+    int seekEpoch = -1;         ///< Epoch to restore from the journal instead of running the changes, or -1.
+    std::string regionsFile;    ///< Router to region map; enables hierarchical distance vector mode.
+    std::string prefixesFile;   ///< Prefixes announced by each router; messages are then addressed to IPv4 destinations.
+    long long lpmBenchmark = 0; ///< Number of lookups for the forwarding lookup-rate benchmark, or 0.
+    std::string trafficFile;    ///< Traffic to simulate packet by packet on the tables of every epoch; empty for none.
+    PacketSimConfig packetSim;  ///< Link and packet parameters of the packet simulation.
+    std::vector<unsigned> pdesThreads;  ///< Thread counts of the parallel event-driven protocol simulation; empty for none.
+    uint64_t pdesSeed = 1;      ///< Seed of the link delay jitter in the event-driven protocol simulation.
+    int workers = 0;            ///< Worker processes computing the routing tables on graph partitions, or 0 for in-process.
+    unsigned actorThreads = 0;  ///< Threads of the actor runtime benchmarked against doBellmanFordAlg every epoch, or 0.
+    unsigned coroutineShards = 0;   ///< Scheduler shards of the coroutine mode, which replaces the table computation, or 0.
+    int holdDownTicks = 1;      ///< Ticks a router waits after a change before it advertises in the coroutine mode.
+    bool flapDamping = false;   ///< Hold down flapping links instead of recomputing on each of their changes.
+    FlapDampingConfig damping;  ///< Half-life and thresholds of the flap damping.
+    std::vector<int> criticalDestinations;  ///< Destinations whose routes are computed and published before the full tables.
+    bool criticalFromMessages = false;      ///< Add the destinations of the messages to the critical destinations.
+    bool sticky = false;        ///< Keep the previous next hop while it remains optimal.
+    bool fibUpdates = false;    ///< Report the next hops that changed in every epoch.
+    std::string manifestFile;   ///< Batch manifest whose scenarios are run instead of a single simulation; empty for none.
+    unsigned batchThreads = 0;  ///< Threads running the scenarios of a batch, or 0 for the number of hardware threads.
+    bool resident = false;      ///< After the changes file, serve changes and commands from standard input.
+    bool memoryReport = false;  ///< Report the bytes of every data structure after the initial convergence.
+    double estimateNodes = -1;  ///< Node count of the footprint estimate printed instead of a run, or -1.
+    double estimateLinks = 0;   ///< Link count of the footprint estimate.
+    bool packedTables = false;  ///< Pack the tables of every epoch into neighbour-index form and report their size.
+    bool intervalTables = false;  ///< Forward the messages on interval-compressed tables and report their size.
+    int dedupBlock = 0;         ///< Destinations per block of the deduplicated tables reported every epoch, or 0.
+};
+
+/**
+ * @struct HistoryRow
+ * @brief One routing table entry as recorded in the epoch history.
+ *
+ * Rows are keyed by (router ID, destination ID), so they are ordered exactly as writeFT prints them.
+ */
+struct HistoryRow {
+    int nextHopID;
+    int pathCost;
+
+    bool operator==(const HistoryRow &other) const {
+        return nextHopID == other.nextHopID && pathCost == other.pathCost;
+    }
+};
+
+typedef VersionedTable<std::pair<int, int>, HistoryRow> History;
+
 /**
  * @class RoutingTable
  * @brief Manages routing information for a router.
@@ -326,19 +441,109 @@ initTopology (const std::string &topologyFile, std::vector<Link> &links, std::se
 
 }
 
+/**
+ * Converts a whole word to an int.
+ *
+ * @param word The word to convert.
+ * @param value Receives the value.
+ * @return False if the word is not a decimal integer in the range of int.
+ */
+bool
+parseInteger (const std::string &word, int &value) {
+
+    char *end = nullptr;
+
+    errno = 0;
+    long parsed = std::strtol(word.c_str(), &end, 10);
+
+    if (word.empty() || *end != '\0' || errno == ERANGE || parsed < INT_MIN || parsed > INT_MAX) return false;
+
+    value = parsed;
+
+    return true;
+
+}
+
+/**
+ * Parses one record of a changes file: "node1 node2 cost", "down <id>" or "up <id>", optionally preceded by its time.
+ *
+ * @param line The line to parse.
+ * @param change Receives the change.
+ * @param time The time of the previous record; receives the time of this one, a second later if it has none.
+ * @return False if the line is not a well-formed record; a negative cost other than -999 is rejected.
+ */
+bool
+parseChangeLine (const std::string &line, Change &change, double &time) {
+
+    std::istringstream iss(line);
+    std::vector<std::string> words;
+    std::string word;
+
+    while (iss >> word) words.push_back(word);
+
+    bool routerRecord = words.size() >= 2 && (words[words.size() - 2] == "down" || words[words.size() - 2] == "up");
+    std::size_t fields = routerRecord ? 2 : 3;
+
+    if (words.size() < fields || words.size() > fields + 1) return false;
+
+    if (words.size() > fields) {
+
+        char *end = nullptr;
+        double parsed = std::strtod(words[0].c_str(), &end);
+
+        if (*end != '\0') return false;
+
+        time = parsed;
+
+    } else {
+
+        time = time + 1;
+
+    }
+
+    const std::string *record = &words[words.size() - fields];
+
+    if (routerRecord) {
+
+        int id;
+
+        if (!parseInteger(record[1], id)) return false;
+
+        change = {record[0] == "down" ? RouterDown : RouterUp, id, id, 0};
+
+    } else {
+
+        int node1, node2, pathCost;
+
+        if (!parseInteger(record[0], node1) || !parseInteger(record[1], node2) || !parseInteger(record[2], pathCost)) return false;
+
+        if (pathCost < 0 && pathCost != -999) return false;
+
+        change = {LinkChange, node1, node2, pathCost};
+
+    }
+
+    return true;
+
+}
+
 /**
  * Reads network topology changes from a given file.
  * 
  * This function processes a file specifying changes to the network topology, which may include
- * adding or removing links, as well as changing path costs. Each change is stored in the provided
- * vector for later application.
+ * adding or removing links, as well as changing path costs. A record "down <id>" or "up <id>"
+ * takes a router down with all its links or brings it back up. A record may start with an extra
+ * column holding its time in seconds; a record without one happens a second after the previous
+ * record. Each change is stored in the provided vector for later application. A malformed record, or
+ * a router record naming a router that neither the topology nor an earlier record has, stops the program.
  *
  * @param changesFile The path to the file containing topology changes.
  * @param changes A reference to a vector where the topology changes will be stored.
- * @param nodes A reference to a set of node IDs; this set may be updated with new node IDs found in the changes file.
+ * @param nodes A constant reference to the set of node IDs of the topology.
+ * @param times A reference to a vector where the time of every change will be stored.
  */
 void
-readChangesFile (const std::string &changesFile, std::vector<Link> &changes, std::set<int> &nodes) {
+readChangesFile (const std::string &changesFile, std::vector<Change> &changes, const std::set<int> &nodes, std::vector<double> &times) {
 
     std::ifstream file(changesFile);
 
@@ -347,11 +552,31 @@ readChangesFile (const std::string &changesFile, std::vector<Link> &changes, std
         exit(EXIT_FAILURE);
     }
 
-    int node1, node2, pathCost;
-    while (file >> node1 >> node2 >> pathCost) {
+    std::string line, word;
+    std::set<int> known = nodes;
+    Change change;
+    double time = 0;
+
+    while (std::getline(file, line)) {
+
+        if (!(std::istringstream(line) >> word)) continue;
+
+        if (!parseChangeLine(line, change, time)) {
+            std::cerr << "Invalid change record: " << line << std::endl;
+            exit(EXIT_FAILURE);
+        }
+
+        if (change.kind != LinkChange && !known.count(change.node1)) {
+            std::cerr << "Unknown router in change record: " << line << std::endl;
+            exit(EXIT_FAILURE);
+        }
+
+        known.insert(change.node1);
+        known.insert(change.node2);
+
+        changes.push_back(change);
+        times.push_back(time);
 
-        changes.push_back({node1, node2, pathCost});
-      
     }
 
     file.close();
@@ -359,33 +584,64 @@ readChangesFile (const std::string &changesFile, std::vector<Link> &changes, std
 }
 
 /**
- * Applies a single topology change to the network.
- * 
- * This function applies a change to the network topology, which may involve adding a new link,
- * updating an existing link's path cost, or removing a link. The function updates the list of links,
- * the set of nodes, and re-initializes routers to reflect the change.
+ * Applies a single topology change to the list of links.
  *
- * @param change The change to apply, represented as a Link struct. A pathCost of -999 indicates the link should be removed.
- * @param routers A reference to a vector of Router objects; this vector will be cleared and re-initialized based on the updated topology.
- * @param nodes A reference to a set of node IDs; this set will be updated to include any new nodes introduced by the change.
+ * Taking a router down moves all its links to the failed links at once; bringing it up moves back
+ * the failed links whose other end is up. A link added while one of its ends is down waits with
+ * the failed links.
+ *
+ * @param change The change to apply. A pathCost of -999 removes the link; RouterDown and RouterUp take node1 down or up.
  * @param links A reference to a vector of existing links; this vector will be updated to reflect the applied change.
+ * @param failed A reference to the down routers and their links.
  */
 void
-applyChange(const Link &change, std::vector<Router> &routers, std::set<int> &nodes, std::vector<Link> &links) {
+applyLinkChange (const Change &change, std::vector<Link> &links, FailedRouters &failed) {
 
-    nodes.insert(change.node1);
-    nodes.insert(change.node2);
+    auto isDown = [&failed](const Link &link) { return failed.down.count(link.node1) || failed.down.count(link.node2); };
+
+    Link link = {change.node1, change.node2, change.pathCost};
+
+    if (change.kind == RouterDown) {
+
+        if (!failed.down.insert(change.node1).second) return;
+
+        auto it = std::stable_partition(links.begin(), links.end(), [&isDown](const Link &link) { return !isDown(link); });
+
+        failed.links.insert(failed.links.end(), it, links.end());
+        links.erase(it, links.end());
 
-    if (change.pathCost == -999) {
+    } else if (change.kind == RouterUp) {
 
-        removeLink(links, change);
+        if (failed.down.erase(change.node1) == 0) return;
+
+        auto it = std::stable_partition(failed.links.begin(), failed.links.end(), isDown);
+
+        links.insert(links.end(), it, failed.links.end());
+        failed.links.erase(it, failed.links.end());
+
+    } else if (change.pathCost == -999) {
+
+        removeLink(links, link);
+        removeLink(failed.links, link);
 
     } else {
 
-        links.push_back({change.node1, change.node2, change.pathCost});
+        (isDown(link) ? failed.links : links).push_back(link);
 
     }
 
+}
+
+/**
+ * Re-initializes the routers to a cold start: every router knows only its direct links.
+ *
+ * @param routers A reference to a vector of Router objects; this vector will be cleared and re-initialized.
+ * @param nodes A constant reference to a set of all node IDs in the network.
+ * @param links A constant reference to a vector of Link objects representing the topology.
+ */
+void
+resetRouters (std::vector<Router> &routers, const std::set<int> &nodes, const std::vector<Link> &links) {
+
     routers.clear();
 
     for (const int &id : nodes) {
@@ -403,6 +659,121 @@ applyChange(const Link &change, std::vector<Router> &routers, std::set<int> &nod
 
 }
 
+/**
+ * Applies a single topology change to the network.
+ * 
+ * This function applies a change to the network topology, which may involve adding a new link,
+ * updating an existing link's path cost, removing a link, or taking a router down or up with all
+ * its links. The function updates the list of links, the set of nodes, and re-initializes routers
+ * to reflect the change, so a router going down costs a single recomputation.
+ *
+ * @param change The change to apply. A link change with a pathCost of -999 indicates the link should be removed.
+ * @param routers A reference to a vector of Router objects; this vector will be cleared and re-initialized based on the updated topology.
+ * @param nodes A reference to a set of node IDs; this set will be updated to include any new nodes introduced by the change.
+ * @param links A reference to a vector of existing links; this vector will be updated to reflect the applied change.
+ * @param failed A reference to the down routers and their links.
+ */
+void
+applyChange(const Change &change, std::vector<Router> &routers, std::set<int> &nodes, std::vector<Link> &links, FailedRouters &failed) {
+
+    nodes.insert(change.node1);
+    nodes.insert(change.node2);
+
+    applyLinkChange(change, links, failed);
+
+    resetRouters(routers, nodes, links);
+
+}
+
+/**
+ * Releases the held-down links whose penalty has decayed to the reuse threshold and reports them to standard error.
+ *
+ * @param damper The flap damping state.
+ * @param time The current time in seconds.
+ * @param epoch The epoch the releases belong to.
+ */
+void
+releaseDampedLinks (FlapDamper<int> &damper, double time, int epoch) {
+
+    for (const auto &link : damper.release(time)) {
+        std::cerr << "damping: epoch " << epoch << ": link " << link.first << "-" << link.second << " released" << std::endl;
+    }
+
+}
+
+/**
+ * Selects the links in use under flap damping: the actual links minus the held-down ones.
+ *
+ * @param damper The flap damping state.
+ * @param actualLinks A constant reference to the links as the changes left them.
+ * @param links A reference to the links in use; it receives the actual links that are not held down.
+ * @return True if the links in use changed, i.e. the routing tables have to be recomputed.
+ */
+bool
+selectDampedLinks (const FlapDamper<int> &damper, const std::vector<Link> &actualLinks, std::vector<Link> &links) {
+
+    std::vector<Link> inUse;
+
+    for (const auto &link : actualLinks) {
+        if (!damper.isSuppressed(link.node1, link.node2)) inUse.push_back(link);
+    }
+
+    bool changed = inUse.size() != links.size() ||
+                   !std::equal(inUse.begin(), inUse.end(), links.begin(), [](const Link &a, const Link &b) {
+                       return a.node1 == b.node1 && a.node2 == b.node2 && a.pathCost == b.pathCost;
+                   });
+
+    links.swap(inUse);
+
+    return changed;
+
+}
+
+/**
+ * Applies a single topology change under flap damping.
+ *
+ * The change is applied to the links as the changes file describes them, and a changed link is charged a
+ * flap. The links in use are those links minus the held-down ones; links whose penalty has decayed are
+ * released first. Suppressions and releases are reported to standard error. A release that falls between
+ * two changes is an epoch of its own; see releaseDampedLinks.
+ *
+ * @param change The change to apply.
+ * @param time The time of the change in seconds.
+ * @param epoch The epoch the change produces.
+ * @param damper The flap damping state.
+ * @param nodes A reference to a set of node IDs; this set will be updated to include any new nodes introduced by the change.
+ * @param actualLinks A reference to the links as the changes left them.
+ * @param failed A reference to the down routers and their links.
+ * @param links A reference to the links in use; it receives the actual links that are not held down.
+ * @return True if the links in use changed, i.e. the routing tables have to be recomputed.
+ */
+bool
+applyDampedChange (const Change &change, double time, int epoch, FlapDamper<int> &damper, std::set<int> &nodes,
+                   std::vector<Link> &actualLinks, FailedRouters &failed, std::vector<Link> &links) {
+
+    nodes.insert(change.node1);
+    nodes.insert(change.node2);
+
+    applyLinkChange(change, actualLinks, failed);
+
+    releaseDampedLinks(damper, time, epoch);
+
+    if (change.kind == LinkChange) {
+
+        bool suppressed = damper.isSuppressed(change.node1, change.node2);
+
+        if (damper.flap(change.node1, change.node2, time) && !suppressed) {
+            std::cerr << "damping: epoch " << epoch << ": link " << std::min(change.node1, change.node2) << "-"
+                      << std::max(change.node1, change.node2) << " suppressed (penalty "
+                      << damper.getPenalty(change.node1, change.node2, time) << ")" << std::endl;
+        }
+
+    }
+
+    return selectDampedLinks(damper, actualLinks, links);
+
+}
+
 /**
  * Executes the Bellman-Ford algorithm to compute the shortest paths in the network.
  *
@@ -411,23 +782,39 @@ applyChange(const Link &change, std::vector<Router> &routers, std::set<int> &nod
  * path to every other router by minimizing the path cost. The algorithm runs until no more
  * updates are made to the routing tables.
  *
+ * Routers without links, e.g. those that are down, keep their initial tables and are skipped
+ * both as routers and as destinations; nothing can change for them.
+ *
  * @param routers A reference to a vector of Router objects representing all routers in the network.
  * @param nodes A constant reference to a set containing the IDs of all nodes in the network.
  * @param links A constant reference to a vector of Link objects representing all the links between nodes.
+ * @return The number of sweeps over all routers until no table changed.
  */
-void
+int
 doBellmanFordAlg (std::vector<Router> &routers, const std::set<int> &nodes, const std::vector<Link> &links) {
 
+    int sweeps = 0;
     bool updated = true;
+    std::set<int> linked;
+
+    for (const auto &link : links) {
+        linked.insert(link.node1);
+        linked.insert(link.node2);
+    }
 
     while (updated) {
 
         updated = false;
+        ++sweeps;
 
         for (auto &router : routers) {
 
+            if (!linked.count(router.getID())) continue;
+
             for (const int &destinationID : nodes) {
 
+                if (!linked.count(destinationID)) continue;
+
                 int curPathCost = router.getPathCost(destinationID);
 
                 int newNextHop = -1;
@@ -461,148 +848,4104 @@ doBellmanFordAlg (std::vector<Router> &routers, const std::set<int> &nodes, cons
 
     }
 
+    return sweeps;
+
 }
 
 /**
- * Writes the routing tables of all routers to an output file.
- *
- * This function iterates over each router in the network and writes its routing table
- * to the specified output file. Each entry in the routing table is written in the format:
- * destination nextHop pathCost, where each value is separated by a space.
+ * Counts the routes whose cost differs from what undamped routing would give over a given topology, which
+ * measures what flap damping costs in routing accuracy. The reference tables come from doBellmanFordAlg on
+ * the given links, so the count is 0 whenever no link is held down.
  *
- * @param outputFile The path to the file where the routing tables will be written.
- * @param routers A constant reference to a vector of Router objects representing all routers in the network.
+ * @param routers A constant reference to a vector of Router objects with the tables in use.
+ * @param nodes A constant reference to a set of all node IDs in the network.
+ * @param links A constant reference to the links as the changes left them.
+ * @return The number of (router, destination) pairs whose cost is wrong.
  */
-void
-writeFT (const std::string outputFile, const std::vector<Router> &routers) {
+long long
+countStaleRoutes (const std::vector<Router> &routers, const std::set<int> &nodes, const std::vector<Link> &links) {
 
-    std::ofstream outFile(outputFile, std::ios::app);
-    
-    if (!outFile.is_open()) {
-        std::cerr << "Cannot open output file: " << outputFile << std::endl;
-        exit(EXIT_FAILURE);
-    }
+    std::vector<Router> reference;
+
+    resetRouters(reference, nodes, links);
+    doBellmanFordAlg(reference, nodes, links);
+
+    long long stale = 0;
 
     for (const auto &router : routers) {
-        
-        for (const auto &entry : router.getRoutingTable()) {
 
-            int destination = entry.first;
-            int nextHop = entry.second.first;
-            int pathCost = (entry.second.second == 9999) ? -999 : entry.second.second;
+        const Router &exact = getRouterByID(reference, router.getID());
 
-            outFile << destination << " " << nextHop << " " << pathCost << "\n";
+        for (const int &destinationID : nodes) {
+            if (std::min(9999, router.getPathCost(destinationID)) != std::min(9999, exact.getPathCost(destinationID))) ++stale;
         }
 
-        outFile << "\n";
-
     }
 
-    outFile.close();
+    return stale;
 
 }
 
 /**
- * Reads messages to be routed from a specified file.
+ * @struct HierarchicalRouter
+ * @brief A router in hierarchical distance vector mode.
  *
- * This function opens a file containing messages, where each message is specified with
- * a source ID, destination ID, and the message content. It reads these messages and stores
- * them in a vector for later processing. Each message is represented by a Message struct.
+ * The router keeps full entries only for the routers of its own region and one summarized
+ * entry per remote region. Both tables reuse RoutingTable; the summary table is keyed by
+ * region ID instead of router ID.
+ */
+struct HierarchicalRouter {
+    int ID;                     ///< The unique identifier of the router.
+    int region;                 ///< The region the router belongs to.
+    RoutingTable local;         ///< One entry per router of the own region.
+    RoutingTable summaries;     ///< One entry per remote region: next hop and cost to its nearest border router.
+};
+
+/**
+ * Reads the region of every router from a file.
  *
- * @param messageFile The path to the file containing the messages.
- * @param messages A reference to a vector of Message structs where the read messages will be stored.
+ * Each line of the file holds a router ID and a region ID. Routers that are not listed
+ * belong to region 0.
+ *
+ * @param regionsFile The path to the file containing the region map.
+ * @param regionOf A reference to a map where the region of each listed router will be stored.
  */
 void
-readMessagesFile (const std::string messageFile, std::vector<Message> &messages) {
+readRegionsFile (const std::string &regionsFile, std::map<int, int> &regionOf) {
 
-    std::ifstream file(messageFile);
+    std::ifstream file(regionsFile);
 
     if (!file.is_open()) {
-        std::cerr << "Cannot open messages file: " << messageFile << std::endl;
+        std::cerr << "Cannot open regions file: " << regionsFile << std::endl;
         exit(EXIT_FAILURE);
     }
 
-    std::string line;
-    while (std::getline(file, line)) {
+    int routerID, regionID;
+    while (file >> routerID >> regionID) {
 
-        std::istringstream iss(line);
-        int sourceID, destinationID;
-        std::string original, message;
+        regionOf[routerID] = regionID;
 
-        iss >> sourceID >> destinationID;
-        std::getline(iss, original);
+    }
 
-        message = original.substr(original.find_first_not_of(" "));
+    file.close();
 
-        messages.push_back({sourceID, destinationID, message});
+}
 
-    }
+/**
+ * Returns the region of a router.
+ * @param regionOf The region map read from the regions file.
+ * @param ID The ID of the router.
+ * @return The region of the router, 0 if it is not listed.
+ */
+int
+getRegion (const std::map<int, int> &regionOf, int ID) {
 
-    file.close();
+    auto it = regionOf.find(ID);
+
+    return (it == regionOf.end()) ? 0 : it->second;
 
 }
 
 /**
- * Forwards messages based on the computed routing tables and writes the results to an output file.
+ * Initializes the hierarchical routers for the current topology.
  *
- * This function iterates over a list of messages, each containing a source and destination ID,
- * and routes them according to the shortest path determined by the routing tables of the routers.
- * The path and total cost are written to the specified output file. If a path cannot be found,
- * an "unreachable" message is recorded.
+ * Every router gets a local table over the routers of its region and a summary table over
+ * all other regions. Direct links are added to the local table when both ends share a region,
+ * and to the summary entry of the neighbour's region otherwise.
  *
- * @param outputFile The path to the file where the message routes will be written.
- * @param routers A reference to a vector of Router objects representing all routers in the network.
- * @param messages A constant reference to a vector of Message structs representing all messages to be sent.
+ * @param nodes A constant reference to a set containing the IDs of all nodes in the network.
+ * @param links A constant reference to a vector of Link objects representing all the links between nodes.
+ * @param regionOf The region map read from the regions file.
+ * @param routers A reference to a vector that receives the hierarchical routers, ordered by ID.
  */
 void
-sendMessages (const std::string outputFile, std::vector<Router> &routers, const std::vector<Message> &messages) {
+initHierarchicalRouters (const std::set<int> &nodes, const std::vector<Link> &links, const std::map<int, int> &regionOf,
+                         std::vector<HierarchicalRouter> &routers) {
 
-    std::ofstream outFile(outputFile, std::ios::app);
-    
-    if (!outFile.is_open()) {
-        std::cerr << "Cannot open output file: " << outputFile << std::endl;
-        exit(EXIT_FAILURE);
-    }
+    std::map<int, std::set<int>> members;
 
-    for (const auto &message : messages) {
+    for (const int &id : nodes) members[getRegion(regionOf, id)].insert(id);
 
-        std::string outMessage;
+    routers.clear();
 
-        int pathCost = getRouterByID(routers, message.sourceID).getPathCost(message.destinationID);
+    for (const int &id : nodes) {
 
-        if (pathCost == 9999) {
+        int region = getRegion(regionOf, id);
+        std::set<int> remoteRegions;
 
-            outMessage = "from " + std::to_string(message.sourceID) + " to " + std::to_string(message.destinationID) +
-                         " cost infinite hops unreachable message " + message.message;
+        for (const auto &entry : members) {
 
-            outFile << outMessage << "\n";
-            outFile << "\n";
+            if (entry.first != region) remoteRegions.insert(entry.first);
 
-            continue;
+        }
+
+        routers.push_back({id, region, RoutingTable(id, members[region]), RoutingTable(region, remoteRegions)});
+
+    }
+
+    std::map<int, std::size_t> index;
+
+    for (std::size_t i = 0; i < routers.size(); ++i) index[routers[i].ID] = i;
+
+    for (const auto &link : links) {
+
+        HierarchicalRouter &a = routers[index[link.node1]];
+        HierarchicalRouter &b = routers[index[link.node2]];
+
+        if (a.region == b.region) {
+
+            a.local.addRoute(b.ID, b.ID, link.pathCost);
+            b.local.addRoute(a.ID, a.ID, link.pathCost);
+
+        } else {
+
+            if (link.pathCost < a.summaries.getPathCost(b.region)) a.summaries.addRoute(b.region, b.ID, link.pathCost);
+            if (link.pathCost < b.summaries.getPathCost(a.region)) b.summaries.addRoute(a.region, a.ID, link.pathCost);
+
+        }
+
+    }
+
+}
+
+/**
+ * Executes the Bellman-Ford algorithm in hierarchical distance vector mode.
+ *
+ * Neighbours in the same region exchange their local tables. Every neighbour advertises its
+ * region summaries, and a border router advertises its own region at cost 0, which is how the
+ * summaries of a region enter the neighbouring regions. As in doBellmanFordAlg, a neighbour
+ * whose route goes back through the router is not used (poisoned reverse).
+ *
+ * @param routers A reference to the hierarchical routers, ordered by ID.
+ * @param links A constant reference to a vector of Link objects representing all the links between nodes.
+ * @return The number of sweeps over all routers until no table changed.
+ */
+int
+doHierarchicalBellmanFordAlg (std::vector<HierarchicalRouter> &routers, const std::vector<Link> &links) {
+
+    std::map<int, std::size_t> index;
+
+    for (std::size_t i = 0; i < routers.size(); ++i) index[routers[i].ID] = i;
+
+    std::vector<std::vector<std::pair<std::size_t, int>>> neighbours(routers.size());
+
+    for (const auto &link : links) {
+
+        neighbours[index[link.node1]].push_back(std::make_pair(index[link.node2], link.pathCost));
+        neighbours[index[link.node2]].push_back(std::make_pair(index[link.node1], link.pathCost));
+
+    }
+
+    int sweeps = 0;
+    bool updated = true;
+
+    while (updated) {
+
+        updated = false;
+        ++sweeps;
+
+        for (std::size_t r = 0; r < routers.size(); ++r) {
+
+            HierarchicalRouter &router = routers[r];
+
+            for (const auto &neighbour : neighbours[r]) {
+
+                const HierarchicalRouter &other = routers[neighbour.first];
+
+                if (other.region == router.region) {
+
+                    for (const auto &entry : other.local.getRoutingTable()) {
+
+                        if (entry.first == router.ID || entry.second.first == router.ID) continue;
+
+                        int pathCost = neighbour.second + entry.second.second;
+                        int curPathCost = router.local.getPathCost(entry.first);
+
+                        if (pathCost < curPathCost || (pathCost == curPathCost && other.ID < router.local.getNextHop(entry.first))) {
+
+                            router.local.addRoute(entry.first, other.ID, pathCost);
+                            updated = true;
+
+                        }
+
+                    }
+
+                }
+
+                for (const auto &entry : router.summaries.getRoutingTable()) {
+
+                    int advertised;
+
+                    if (other.region == entry.first) {
+
+                        advertised = 0;
+
+                    } else if (other.summaries.contains(entry.first) && other.summaries.getNextHop(entry.first) != router.ID) {
+
+                        advertised = other.summaries.getPathCost(entry.first);
+
+                    } else {
+
+                        continue;
+
+                    }
+
+                    int pathCost = neighbour.second + advertised;
+                    int curPathCost = entry.second.second;
+
+                    if (pathCost < curPathCost || (pathCost == curPathCost && other.ID < entry.second.first)) {
+
+                        router.summaries.addRoute(entry.first, other.ID, pathCost);
+                        updated = true;
+
+                    }
+
+                }
+
+            }
+
+        }
+
+    }
+
+    return sweeps;
+
+}
+
+/**
+ * Returns the cost of the link between two routers. Of parallel links the last one listed counts, as in the routing tables.
+ * @param links A constant reference to a vector of Link objects representing all the links between nodes.
+ * @param node1 One end of the link.
+ * @param node2 The other end of the link.
+ * @return The cost of the last link between the two routers, or -1 if they are not linked.
+ */
+int
+getLinkCost (const std::vector<Link> &links, int node1, int node2) {
+
+    int pathCost = -1;
+
+    for (const auto &link : links) {
+
+        if ((link.node1 == node1 && link.node2 == node2) || (link.node1 == node2 && link.node2 == node1)) {
+
+            pathCost = link.pathCost;
+
+        }
+
+    }
+
+    return pathCost;
+
+}
+
+/**
+ * Writes the hierarchical routing tables of all routers to an output file.
+ *
+ * Each router's block lists its local entries as "destination nextHop pathCost", followed by
+ * one "r<region> nextHop pathCost" line per remote region.
+ *
+ * @param outputFile The path to the file where the routing tables will be written.
+ * @param routers A constant reference to the hierarchical routers.
+ */
+void
+writeHierarchicalFT (const std::string outputFile, const std::vector<HierarchicalRouter> &routers) {
+
+    std::ofstream outFile(outputFile, std::ios::app);
+
+    if (!outFile.is_open()) {
+        std::cerr << "Cannot open output file: " << outputFile << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    for (const auto &router : routers) {
+
+        for (const auto &entry : router.local.getRoutingTable()) {
+
+            int pathCost = (entry.second.second == 9999) ? -999 : entry.second.second;
+
+            outFile << entry.first << " " << entry.second.first << " " << pathCost << "\n";
 
         }
 
+        for (const auto &entry : router.summaries.getRoutingTable()) {
+
+            int pathCost = (entry.second.second == 9999) ? -999 : entry.second.second;
+
+            outFile << "r" << entry.first << " " << entry.second.first << " " << pathCost << "\n";
+
+        }
+
+        outFile << "\n";
+
+    }
+
+    outFile.close();
+
+}
+
+/**
+ * Forwards messages hop by hop on the hierarchical routing tables and writes the results to an output file.
+ *
+ * A router uses its summary entry while the destination is in a remote region and its local
+ * entry once the message has entered the destination's region. The reported cost is the sum
+ * of the link costs along the path actually taken.
+ *
+ * @param outputFile The path to the file where the message routes will be written.
+ * @param routers A constant reference to the hierarchical routers, ordered by ID.
+ * @param links A constant reference to a vector of Link objects representing all the links between nodes.
+ * @param messages A constant reference to a vector of Message structs representing all messages to be sent.
+ */
+void
+sendHierarchicalMessages (const std::string outputFile, const std::vector<HierarchicalRouter> &routers,
+                          const std::vector<Link> &links, const std::vector<Message> &messages) {
+
+    std::ofstream outFile(outputFile, std::ios::app);
+
+    if (!outFile.is_open()) {
+        std::cerr << "Cannot open output file: " << outputFile << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    std::map<int, std::size_t> index;
+
+    for (std::size_t i = 0; i < routers.size(); ++i) index[routers[i].ID] = i;
+
+    for (const auto &message : messages) {
+
+        std::string hops;
+        int pathCost = 0;
+        std::size_t hopCount = 0;
         int currentID = message.sourceID;
+        bool reachable = index.count(message.sourceID) && index.count(message.destinationID);
+
+        while (reachable && currentID != message.destinationID) {
+
+            const HierarchicalRouter &current = routers[index[currentID]];
+            int destinationRegion = routers[index[message.destinationID]].region;
+            int nextHop = (current.region == destinationRegion) ? current.local.getNextHop(message.destinationID)
+                                                                : current.summaries.getNextHop(destinationRegion);
+
+            // A loop-free path visits every router at most once
+            if (nextHop == -1 || hopCount == routers.size()) {
+
+                reachable = false;
+                break;
+
+            }
+
+            hops += std::to_string(currentID) + " ";
+            pathCost += getLinkCost(links, currentID, nextHop);
+            currentID = nextHop;
+            ++hopCount;
+
+        }
+
+        std::string outMessage = "from " + std::to_string(message.sourceID) + " to " + std::to_string(message.destinationID);
+
+        if (reachable) {
+
+            outMessage += " cost " + std::to_string(pathCost) + " hops " + hops + "message " + message.message;
+
+        } else {
+
+            outMessage += " cost infinite hops unreachable message " + message.message;
+
+        }
+
+        outFile << outMessage << "\n";
+        outFile << "\n";
+
+    }
+
+    outFile.close();
+
+}
+
+/**
+ * Compares hierarchical distance vector with flat distance vector on standard error.
+ * @param routers A constant reference to the hierarchical routers.
+ * @param nodes A constant reference to a set containing the IDs of all nodes in the network.
+ * @param hierarchicalSweeps The sweeps the hierarchical Bellman-Ford took to converge.
+ * @param flatSweeps The sweeps the flat Bellman-Ford took to converge.
+ */
+void
+reportHierarchy (const std::vector<HierarchicalRouter> &routers, const std::set<int> &nodes, int hierarchicalSweeps, int flatSweeps) {
+
+    std::size_t entries = 0;
+
+    for (const auto &router : routers) entries += router.local.getRoutingTable().size() + router.summaries.getRoutingTable().size();
+
+    std::size_t flatEntries = nodes.size() * nodes.size();
+
+    std::cerr << "regions: " << entries << " table entries vs " << flatEntries << " flat ("
+              << (flatEntries ? 100 * entries / flatEntries : 0) << "%), "
+              << hierarchicalSweeps << " sweeps to converge vs " << flatSweeps << " flat" << std::endl;
+
+}
+
+/**
+ * Runs hierarchical distance vector on the current topology and writes its tables and messages.
+ *
+ * @param outputFile The path to the file where the results will be written.
+ * @param nodes A constant reference to a set containing the IDs of all nodes in the network.
+ * @param links A constant reference to a vector of Link objects representing all the links between nodes.
+ * @param regionOf The region map read from the regions file.
+ * @param messages A constant reference to a vector of Message structs representing all messages to be sent.
+ * @param flatSweeps The sweeps the flat Bellman-Ford took on the same topology, for the comparison report.
+ */
+void
+publishHierarchical (const std::string outputFile, const std::set<int> &nodes, const std::vector<Link> &links,
+                     const std::map<int, int> &regionOf, const std::vector<Message> &messages, int flatSweeps) {
+
+    std::vector<HierarchicalRouter> routers;
+
+    initHierarchicalRouters(nodes, links, regionOf, routers);
+
+    int sweeps = doHierarchicalBellmanFordAlg(routers, links);
+
+    reportHierarchy(routers, nodes, sweeps, flatSweeps);
+
+    writeHierarchicalFT(outputFile, routers);
+
+    sendHierarchicalMessages(outputFile, routers, links, messages);
+
+}
+
+/**
+ * Writes the routing tables of all routers to an output file.
+ *
+ * This function iterates over each router in the network and writes its routing table
+ * to the specified output file. Each entry in the routing table is written in the format:
+ * destination nextHop pathCost, where each value is separated by a space.
+ *
+ * @param outputFile The path to the file where the routing tables will be written.
+ * @param routers A constant reference to a vector of Router objects representing all routers in the network.
+ */
+void
+writeFT (const std::string outputFile, const std::vector<Router> &routers) {
+
+    std::ofstream outFile(outputFile, std::ios::app);
+    
+    if (!outFile.is_open()) {
+        std::cerr << "Cannot open output file: " << outputFile << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    for (const auto &router : routers) {
+        
+        for (const auto &entry : router.getRoutingTable()) {
+
+            int destination = entry.first;
+            int nextHop = entry.second.first;
+            int pathCost = (entry.second.second == 9999) ? -999 : entry.second.second;
+
+            outFile << destination << " " << nextHop << " " << pathCost << "\n";
+        }
+
+        outFile << "\n";
+
+    }
+
+    outFile.close();
+
+}
+
+/**
+ * Reads messages to be routed from a specified file.
+ *
+ * This function opens a file containing messages, where each message is specified with
+ * a source ID, destination ID, and the message content. It reads these messages and stores
+ * them in a vector for later processing. Each message is represented by a Message struct.
+ *
+ * @param messageFile The path to the file containing the messages.
+ * @param messages A reference to a vector of Message structs where the read messages will be stored.
+ */
+void
+readMessagesFile (const std::string messageFile, std::vector<Message> &messages) {
+
+    std::ifstream file(messageFile);
+
+    if (!file.is_open()) {
+        std::cerr << "Cannot open messages file: " << messageFile << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    std::string line;
+    while (std::getline(file, line)) {
+
+        std::istringstream iss(line);
+        int sourceID, destinationID;
+        std::string original, message;
+
+        iss >> sourceID >> destinationID;
+        std::getline(iss, original);
+
+        message = original.substr(original.find_first_not_of(" "));
+
+        messages.push_back({sourceID, destinationID, message});
+
+    }
+
+    file.close();
+
+}
+
+/**
+ * Forwards messages based on the computed routing tables and writes the results to an output file.
+ *
+ * This function iterates over a list of messages, each containing a source and destination ID,
+ * and routes them according to the shortest path determined by the routing tables of the routers.
+ * The path and total cost are written to the specified output file. If a path cannot be found,
+ * an "unreachable" message is recorded.
+ *
+ * @param outputFile The path to the file where the message routes will be written.
+ * @param routers A reference to a vector of Router objects representing all routers in the network.
+ * @param messages A constant reference to a vector of Message structs representing all messages to be sent.
+ */
+void
+sendMessages (const std::string outputFile, std::vector<Router> &routers, const std::vector<Message> &messages) {
+
+    std::ofstream outFile(outputFile, std::ios::app);
+    
+    if (!outFile.is_open()) {
+        std::cerr << "Cannot open output file: " << outputFile << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    for (const auto &message : messages) {
+
+        std::string outMessage;
+
+        int pathCost = getRouterByID(routers, message.sourceID).getPathCost(message.destinationID);
+
+        if (pathCost == 9999) {
+
+            outMessage = "from " + std::to_string(message.sourceID) + " to " + std::to_string(message.destinationID) +
+                         " cost infinite hops unreachable message " + message.message;
+
+            outFile << outMessage << "\n";
+            outFile << "\n";
+
+            continue;
+
+        }
+
+        int currentID = message.sourceID;
+
+        outMessage = "from " + std::to_string(message.sourceID) + " to " + std::to_string(message.destinationID) +
+                     " cost " + std::to_string(pathCost) + " hops ";
+
+        while (currentID != message.destinationID) {
+
+            outMessage += std::to_string(currentID) + " ";
+
+            currentID = getRouterByID(routers, currentID).getNextHop(message.destinationID);
+
+        }
+
+        outMessage += "message " + message.message;
+
+        outFile << outMessage << "\n";
+        outFile << "\n";
+
+    }
+
+    outFile.close();
+
+}
+
+/**
+ * @struct Prefix
+ * @brief An IPv4 prefix announced by a router.
+ */
+struct Prefix {
+    int routerID;           ///< The router announcing the prefix.
+    uint32_t address;       ///< The prefix address in host byte order.
+    int length;             ///< The prefix length.
+    std::string text;       ///< The prefix as written in the prefixes file, e.g. "10.1.0.0/16".
+};
+
+/**
+ * @struct AddressedMessage
+ * @brief A message addressed to an IPv4 destination instead of a router ID.
+ */
+struct AddressedMessage {
+    int sourceID;
+    uint32_t address;
+    std::string addressText;
+    std::string message;
+};
+
+/**
+ * Reads the prefixes announced by each router from a file.
+ *
+ * Each line holds a router ID followed by one or more prefixes in "a.b.c.d/len" notation.
+ *
+ * @param prefixesFile The path to the file containing the prefix announcements.
+ * @param prefixes A reference to a vector where the announced prefixes will be stored.
+ */
+void
+readPrefixesFile (const std::string &prefixesFile, std::vector<Prefix> &prefixes) {
+
+    std::ifstream file(prefixesFile);
+
+    if (!file.is_open()) {
+        std::cerr << "Cannot open prefixes file: " << prefixesFile << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    std::string line;
+    while (std::getline(file, line)) {
+
+        std::istringstream iss(line);
+        int routerID;
+        std::string text;
+
+        if (!(iss >> routerID)) continue;
+
+        while (iss >> text) {
+
+            std::size_t slash = text.find('/');
+            std::string length = (slash == std::string::npos) ? "" : text.substr(slash + 1);
+            uint32_t address;
+
+            // The length must be 0 to 32; it is used as a shift count of the mask
+            if (slash == std::string::npos || !parseIPv4(text.substr(0, slash), address) || length.empty() || length.size() > 2 ||
+                length.find_first_not_of("0123456789") != std::string::npos || std::atoi(length.c_str()) > 32) {
+                std::cerr << "Invalid prefix in prefixes file: " << text << std::endl;
+                exit(EXIT_FAILURE);
+            }
+
+            prefixes.push_back({routerID, address, std::atoi(length.c_str()), text});
+
+        }
+
+    }
+
+    file.close();
+
+}
+
+/**
+ * Reads messages addressed to IPv4 destinations from a file.
+ *
+ * Each line holds a source router ID, a destination address and the message content.
+ *
+ * @param messageFile The path to the file containing the messages.
+ * @param messages A reference to a vector where the read messages will be stored.
+ */
+void
+readAddressedMessagesFile (const std::string messageFile, std::vector<AddressedMessage> &messages) {
+
+    std::ifstream file(messageFile);
+
+    if (!file.is_open()) {
+        std::cerr << "Cannot open messages file: " << messageFile << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    std::string line;
+    while (std::getline(file, line)) {
+
+        std::istringstream iss(line);
+        AddressedMessage message;
+        std::string content;
+
+        if (!(iss >> message.sourceID >> message.addressText) || !parseIPv4(message.addressText, message.address)) continue;
+
+        std::getline(iss, content);
+
+        std::size_t start = content.find_first_not_of(" ");
+        message.message = (start == std::string::npos) ? "" : content.substr(start);
+
+        messages.push_back(message);
+
+    }
+
+    file.close();
+
+}
+
+/**
+ * @class ForwardingPlane
+ * @brief Forwarding tables compiled from the routing tables and the prefix announcements.
+ *
+ * A single Dir24_8 table maps an address to the longest announced prefix. Per router, a vector
+ * indexed by that prefix holds the next hop towards the nearest router announcing it, so a
+ * forwarding decision is one LPM lookup plus one array access. Only the per-router vectors
+ * have to be recompiled when the routing tables change.
+ */
+class ForwardingPlane {
+public:
+
+    /**
+     * Builds the longest-prefix-match table for the announced prefixes.
+     * @param prefixes The prefix announcements; a prefix announced by several routers is stored once.
+     */
+    explicit ForwardingPlane(const std::vector<Prefix> &prefixes) {
+
+        std::map<std::pair<uint32_t, int>, int> ids;
+        std::vector<Dir24_8::Route> routes;
+
+        for (const auto &prefix : prefixes) {
+
+            uint32_t mask = prefix.length == 0 ? 0 : ~uint32_t(0) << (32 - prefix.length);
+            std::pair<uint32_t, int> key(prefix.address & mask, prefix.length);
+
+            if (!ids.count(key)) {
+
+                ids[key] = prefixText.size();
+                prefixText.push_back(prefix.text);
+                announcers.emplace_back();
+                routes.push_back({key.first, key.second, static_cast<uint32_t>(ids[key])});
+
+            }
+
+            announcers[ids[key]].push_back(prefix.routerID);
+
+        }
+
+        lpm.build(routes);
+
+    }
+
+    /**
+     * Compiles the per-router next hops from the converged routing tables.
+     * @param routers A constant reference to a vector of Router objects representing all routers in the network.
+     */
+    void
+    compile(const std::vector<Router> &routers) {
+
+        routerIndex.clear();
+        nextHop.assign(routers.size(), std::vector<int>(prefixText.size(), -1));
+        pathCost.assign(routers.size(), std::vector<int>(prefixText.size(), 9999));
+
+        for (std::size_t r = 0; r < routers.size(); ++r) {
+
+            routerIndex[routers[r].getID()] = r;
+
+            for (std::size_t p = 0; p < prefixText.size(); ++p) {
+
+                for (int announcer : announcers[p]) {
+
+                    int cost = routers[r].getPathCost(announcer);
+
+                    if (cost == -1 || cost >= pathCost[r][p]) continue;
+
+                    pathCost[r][p] = cost;
+                    nextHop[r][p] = (announcer == routers[r].getID()) ? announcer : routers[r].getNextHop(announcer);
+
+                }
+
+            }
+
+        }
+
+    }
+
+    /**
+     * Looks up the longest announced prefix matching an address.
+     * @param address The destination address.
+     * @return The prefix index, or -1 if no announced prefix matches.
+     */
+    int
+    lookup(uint32_t address) const {
+
+        return lpm.lookup(address);
+
+    }
+
+    /**
+     * @param routerID The forwarding router.
+     * @param prefix A prefix index returned by lookup.
+     * @return The next hop towards the prefix, the router itself if it announces the prefix, or -1.
+     */
+    int
+    getNextHop(int routerID, int prefix) const {
+
+        auto it = routerIndex.find(routerID);
+
+        return (it == routerIndex.end()) ? -1 : nextHop[it->second][prefix];
+
+    }
+
+    /**
+     * @param routerID The forwarding router.
+     * @param prefix A prefix index returned by lookup.
+     * @return The path cost to the nearest router announcing the prefix, 9999 if unreachable.
+     */
+    int
+    getPathCost(int routerID, int prefix) const {
+
+        auto it = routerIndex.find(routerID);
+
+        return (it == routerIndex.end()) ? 9999 : pathCost[it->second][prefix];
+
+    }
+
+    /**
+     * @return The number of routers with forwarding tables.
+     */
+    std::size_t
+    routerCount() const {
+
+        return routerIndex.size();
+
+    }
+
+    /**
+     * @param prefix A prefix index returned by lookup.
+     * @return The prefix as written in the prefixes file.
+     */
+    const std::string&
+    getPrefixText(int prefix) const {
+
+        return prefixText[prefix];
+
+    }
+
+    /**
+     * @return The bytes used by the longest-prefix-match table.
+     */
+    std::size_t
+    lpmBytes() const {
+
+        return lpm.memoryBytes();
+
+    }
+
+private:
+    Dir24_8 lpm;                                ///< Address to prefix index.
+    std::vector<std::string> prefixText;        ///< Prefix index to its text.
+    std::vector<std::vector<int>> announcers;   ///< Prefix index to the routers announcing it.
+    std::map<int, std::size_t> routerIndex;     ///< Router ID to its row in nextHop and pathCost.
+    std::vector<std::vector<int>> nextHop;      ///< Router row x prefix index to next hop.
+    std::vector<std::vector<int>> pathCost;     ///< Router row x prefix index to path cost.
+};
+
+/**
+ * Forwards addressed messages hop by hop with one LPM lookup per hop and writes the results to an output file.
+ *
+ * Each line has the form "from <source> to <address> via <prefix> at <router> cost <cost> hops <path> message <content>",
+ * where the path lists the routers up to, but not including, the router announcing the matched prefix. A message
+ * that meets a router without a route, or that loops, is reported as "cost infinite hops <path> unreachable at
+ * <router>", naming the router where forwarding failed.
+ *
+ * @param outputFile The path to the file where the message routes will be written.
+ * @param plane The compiled forwarding plane.
+ * @param messages A constant reference to the addressed messages.
+ */
+void
+sendAddressedMessages (const std::string outputFile, const ForwardingPlane &plane, const std::vector<AddressedMessage> &messages) {
+
+    std::ofstream outFile(outputFile, std::ios::app);
+
+    if (!outFile.is_open()) {
+        std::cerr << "Cannot open output file: " << outputFile << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    for (const auto &message : messages) {
+
+        std::string outMessage = "from " + std::to_string(message.sourceID) + " to " + message.addressText;
+        int prefix = plane.lookup(message.address);
+
+        if (prefix == -1 || plane.getPathCost(message.sourceID, prefix) == 9999) {
+
+            outFile << outMessage << " cost infinite hops unreachable message " << message.message << "\n\n";
+            continue;
+
+        }
+
+        std::string hops;
+        int currentID = message.sourceID;
+        int nextHop = plane.getNextHop(currentID, prefix);
+        std::size_t hopCount = 0;
+
+        // A loop-free path visits every router at most once
+        while (nextHop != currentID && nextHop != -1 && hopCount < plane.routerCount()) {
+
+            hops += std::to_string(currentID) + " ";
+            currentID = nextHop;
+            nextHop = plane.getNextHop(currentID, plane.lookup(message.address));
+            ++hopCount;
+
+        }
+
+        if (nextHop != currentID) {
+
+            outFile << outMessage << " via " << plane.getPrefixText(prefix) << " cost infinite hops " << hops
+                    << "unreachable at " << currentID << " message " << message.message << "\n\n";
+            continue;
+
+        }
+
+        outFile << outMessage << " via " << plane.getPrefixText(prefix) << " at " << currentID
+                << " cost " << plane.getPathCost(message.sourceID, prefix) << " hops " << hops
+                << "message " << message.message << "\n\n";
+
+    }
+
+    outFile.close();
+
+}
+
+/**
+ * Measures the lookup rate of the forwarding plane on one core and prints it to standard error.
+ *
+ * Half of the addresses fall inside announced prefixes, the other half are uniformly random.
+ * Each lookup is a full forwarding decision: an LPM lookup followed by the next-hop access.
+ *
+ * @param plane The compiled forwarding plane.
+ * @param prefixes The announced prefixes.
+ * @param routerID The router whose forwarding table is used.
+ * @param lookups The number of lookups to perform.
+ */
+void
+benchmarkLookups (const ForwardingPlane &plane, const std::vector<Prefix> &prefixes, int routerID, long long lookups) {
+
+    const std::size_t batch = 1 << 20;
+    std::vector<uint32_t> addresses(batch);
+    uint64_t state = 88172645463325252ULL;
+
+    for (std::size_t i = 0; i < batch; ++i) {
+
+        state ^= state << 13; state ^= state >> 7; state ^= state << 17;
+
+        uint32_t random = static_cast<uint32_t>(state);
+
+        if (i % 2 == 0 && !prefixes.empty()) {
+
+            const Prefix &prefix = prefixes[(state >> 32) % prefixes.size()];
+            uint32_t host = prefix.length == 0 ? ~uint32_t(0) : (prefix.length == 32 ? 0 : ~uint32_t(0) >> prefix.length);
+
+            random = (prefix.address & ~host) | (random & host);
+
+        }
+
+        addresses[i] = random;
+
+    }
+
+    long long checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+
+    for (long long i = 0; i < lookups; ++i) {
+
+        int prefix = plane.lookup(addresses[i & (batch - 1)]);
+
+        checksum += (prefix == -1) ? -1 : plane.getNextHop(routerID, prefix);
+
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cerr << "lpm: " << lookups << " lookups in " << seconds << " s, "
+              << (seconds > 0 ? lookups / seconds / 1e6 : 0) << " million lookups per second on one core, "
+              << plane.lpmBytes() << " bytes of LPM table (checksum " << checksum << ")" << std::endl;
+
+}
+
+/**
+ * Simulates the traffic file packet by packet on the current routing tables and reports
+ * the per-message latency, the drops and the link utilization to standard error.
+ *
+ * @param epoch The current epoch.
+ * @param nodes A constant reference to a set of all node IDs in the network.
+ * @param links A constant reference to a vector of Link objects representing the current topology.
+ * @param routers A constant reference to a vector of Router objects with converged routing tables.
+ * @param traffic The messages to inject, read from the traffic file.
+ * @param config The link and packet parameters.
+ */
+void
+simulatePackets (int epoch, const std::set<int> &nodes, const std::vector<Link> &links, const std::vector<Router> &routers,
+                 const std::vector<TrafficLine> &traffic, const PacketSimConfig &config) {
+
+    std::vector<std::string> names;
+    std::vector<int> ids;
+    std::map<int, int> index;
+
+    for (const int &id : nodes) {
+        index[id] = names.size();
+        names.push_back(std::to_string(id));
+        ids.push_back(id);
+    }
+
+    std::vector<const Router*> byIndex(names.size(), nullptr);
+
+    for (const auto &router : routers) {
+        if (index.count(router.getID())) byIndex[index[router.getID()]] = &router;
+    }
+
+    // Next hops are read from the routers' own tables when the simulator first needs them
+    PacketSimulator simulator(names.size(), config, [&](int node, int destination) {
+
+        auto hop = byIndex[node] ? index.find(byIndex[node]->getNextHop(ids[destination])) : index.end();
+
+        return (hop == index.end()) ? -1 : hop->second;
+
+    });
+
+    for (const auto &link : links) simulator.addLink(index[link.node1], index[link.node2], link.pathCost);
+
+    for (const auto &line : traffic) {
+
+        int sourceID = std::atoi(line.source.c_str());
+        int destinationID = std::atoi(line.destination.c_str());
+
+        if (!index.count(sourceID) || !index.count(destinationID)) continue;
+
+        simulator.addFlow(index[sourceID], index[destinationID], line.start, line.packets);
+
+    }
+
+    simulator.run();
+
+    simulator.report(std::cerr, epoch, names);
+
+}
+
+/**
+ * Writes a whole buffer to a file descriptor, retrying after interruptions and partial writes.
+ * @param fd The descriptor to write to.
+ * @param data The words to write.
+ * @return False if the peer is gone.
+ */
+bool
+writeWords (int fd, const std::vector<int32_t> &data) {
+
+    uint64_t length = data.size();
+    const char *parts[2] = {reinterpret_cast<const char*>(&length), reinterpret_cast<const char*>(data.data())};
+    std::size_t sizes[2] = {sizeof(length), data.size() * sizeof(int32_t)};
+
+    for (int part = 0; part < 2; ++part) {
+
+        for (std::size_t done = 0; done < sizes[part]; ) {
+
+            ssize_t written = send(fd, parts[part] + done, sizes[part] - done, MSG_NOSIGNAL);
+
+            if (written < 0 && errno == EINTR) continue;
+            if (written <= 0) return false;
+
+            done += written;
+
+        }
+
+    }
+
+    return true;
+
+}
+
+/**
+ * Reads one buffer written by writeWords.
+ * @param fd The descriptor to read from.
+ * @param data Receives the words.
+ * @return False if the peer is gone.
+ */
+bool
+readWords (int fd, std::vector<int32_t> &data) {
+
+    uint64_t length = 0;
+    char *parts[2] = {reinterpret_cast<char*>(&length), nullptr};
+    std::size_t sizes[2] = {sizeof(length), 0};
+
+    for (int part = 0; part < 2; ++part) {
+
+        if (part == 1) {
+            data.resize(length);
+            parts[1] = reinterpret_cast<char*>(data.data());
+            sizes[1] = length * sizeof(int32_t);
+        }
+
+        for (std::size_t done = 0; done < sizes[part]; ) {
+
+            ssize_t got = recv(fd, parts[part] + done, sizes[part] - done, 0);
+
+            if (got < 0 && errno == EINTR) continue;
+            if (got <= 0) return false;
+
+            done += got;
+
+        }
+
+    }
+
+    return true;
+
+}
+
+/**
+ * Queues one buffer in the format of writeWords.
+ * @param buffer The bytes waiting to be sent.
+ * @param data The words to queue.
+ */
+void
+queueWords (std::string &buffer, const std::vector<int32_t> &data) {
+
+    uint64_t length = data.size();
+
+    buffer.append(reinterpret_cast<const char*>(&length), sizeof(length));
+    buffer.append(reinterpret_cast<const char*>(data.data()), data.size() * sizeof(int32_t));
+
+}
+
+/**
+ * Runs one worker process of the partitioned distance vector computation.
+ *
+ * The worker owns the routers of its part and runs the sweeps of doBellmanFordAlg on them: in every
+ * sweep it updates its routers in ID order, in place, trying their neighbors in link order. A router
+ * thereby sees the vectors of lower-numbered neighbors from the current sweep and those of
+ * higher-numbered neighbors from the previous one. Vectors of neighbors owned by other workers (ghosts)
+ * arrive from the coordinator, tagged with their sweep, and the worker waits for the one it needs, so
+ * every router takes exactly the steps it takes in doBellmanFordAlg and ties resolve the same way.
+ * Workers only wait on each other where a link crosses parts.
+ *
+ * The worker holds the tables of its own routers and of their ghosts only, and builds their cold start
+ * from the links itself, so no process ever holds the tables of the whole network.
+ *
+ * Messages to the coordinator are a router's vector after a sweep {0, router, sweep, changed, costs, hops},
+ * with costs and hops only if it changed, the end of a sweep {1, sweep, updated}, and finally one
+ * {2, router, costs, hops} per owned router. The coordinator relays vectors and answers the end of every
+ * sweep with {1, proceed}.
+ *
+ * @param fd The socket connected to the coordinator.
+ * @param sequence The neighbor indices of every router, one per link, in link order.
+ * @param links The links with router indices for IDs, in the order of the topology.
+ * @param linked Whether each router has a link; doBellmanFordAlg skips the others.
+ * @param part The part of every router.
+ * @param self The part owned by this worker.
+ */
+void
+runPartitionWorker (int fd, const std::vector<std::vector<int>> &sequence, const std::vector<Link> &links,
+                    const std::vector<bool> &linked, const std::vector<int> &part, int self) {
+
+    const int n = sequence.size();
+    std::vector<int> owned, held, slot(n, -1);
+    std::vector<std::vector<int>> ghosts;
+
+    for (int r = 0; r < n; ++r) {
+        if (part[r] == self) {
+            slot[r] = held.size();
+            held.push_back(r);
+            owned.push_back(r);
+        }
+    }
+
+    for (int r : owned) {
+
+        std::vector<int> list;
+
+        for (int neighbor : sequence[r]) {
+
+            if (part[neighbor] == self) continue;
+
+            list.push_back(neighbor);
+
+            if (slot[neighbor] < 0) {
+                slot[neighbor] = held.size();
+                held.push_back(neighbor);
+            }
+
+        }
+
+        std::sort(list.begin(), list.end());
+        list.erase(std::unique(list.begin(), list.end()), list.end());
+        ghosts.push_back(list);
+
+    }
+
+    // The cold start of resetRouters, for the held routers only
+    std::vector<std::vector<int32_t>> costs(held.size(), std::vector<int32_t>(n, 9999)), hops(held.size(), std::vector<int32_t>(n, -1));
+    std::vector<int> version(held.size(), 0);
+
+    for (std::size_t s = 0; s < held.size(); ++s) {
+        costs[s][held[s]] = 0;
+        hops[s][held[s]] = held[s];
+    }
+
+    for (const auto &link : links) {
+
+        if (slot[link.node1] >= 0) {
+            costs[slot[link.node1]][link.node2] = link.pathCost;
+            hops[slot[link.node1]][link.node2] = link.node2;
+        }
+
+        if (slot[link.node2] >= 0) {
+            costs[slot[link.node2]][link.node1] = link.pathCost;
+            hops[slot[link.node2]][link.node1] = link.node1;
+        }
+
+    }
+
+    std::vector<int32_t> message;
+
+    // Reads one message from the coordinator, installing a ghost vector; returns the proceed flag of an end of sweep, else -1
+    auto receive = [&]() -> int {
+
+        if (!readWords(fd, message)) _exit(1);
+
+        if (message[0] == 1) return message[1];
+
+        int s = slot[message[1]];
+
+        version[s] = message[2];
+
+        if (message[3]) {
+            costs[s].assign(message.begin() + 4, message.begin() + 4 + n);
+            hops[s].assign(message.begin() + 4 + n, message.begin() + 4 + 2 * n);
+        }
+
+        return -1;
+
+    };
+
+    for (int sweep = 1; ; ++sweep) {
+
+        bool updated = false;
+
+        for (std::size_t o = 0; o < owned.size(); ++o) {
+
+            int r = owned[o], sr = slot[r];
+
+            if (!linked[r]) continue;
+
+            for (int ghost : ghosts[o]) {
+                while (version[slot[ghost]] < (ghost < r ? sweep : sweep - 1)) receive();
+            }
+
+            bool changed = false;
+
+            for (int d = 0; d < n; ++d) {
+
+                if (!linked[d]) continue;
+
+                int cost = costs[sr][d], hop = -1;
+
+                for (int neighbor : sequence[r]) {
+
+                    int sn = slot[neighbor];
+
+                    if (neighbor == d || hops[sn][d] == r) continue;
+
+                    int through = costs[sr][neighbor] + costs[sn][d];
+
+                    if (through < cost || (through == cost && neighbor < hop)) {
+                        cost = through;
+                        hop = neighbor;
+                        costs[sr][d] = cost;
+                        hops[sr][d] = hop;
+                        changed = true;
+                    }
+
+                }
+
+            }
+
+            updated = updated || changed;
+
+            if (ghosts[o].empty()) continue;
+
+            message.assign({0, r, sweep, changed ? 1 : 0});
+
+            if (changed) {
+                message.insert(message.end(), costs[sr].begin(), costs[sr].end());
+                message.insert(message.end(), hops[sr].begin(), hops[sr].end());
+            }
+
+            if (!writeWords(fd, message)) return;
+
+        }
+
+        int proceed = -1;
+
+        if (!writeWords(fd, std::vector<int32_t>{1, sweep, updated ? 1 : 0})) return;
+
+        while (proceed < 0) proceed = receive();
+
+        if (!proceed) break;
+
+    }
+
+    for (int r : owned) {
+
+        message.assign({2, r});
+        message.insert(message.end(), costs[slot[r]].begin(), costs[slot[r]].end());
+        message.insert(message.end(), hops[slot[r]].begin(), hops[slot[r]].end());
+
+        if (!writeWords(fd, message)) return;
+
+    }
+
+}
+
+/**
+ * Computes the routing tables with the routers partitioned across several worker processes.
+ *
+ * The router graph is split with the multilevel min-cut partitioner, and one process is forked per
+ * part, connected to this coordinator by a UNIX socket pair. The workers run the sweeps of doBellmanFordAlg
+ * on their routers, and the coordinator relays the vector of every boundary router to the workers owning
+ * one of its neighbors as soon as it arrives. After every sweep the coordinator has the workers go on while
+ * any router changed, and then copies their tables into the routers, which end up exactly as
+ * doBellmanFordAlg leaves them. The coordinator keeps only the topology and the part of every router; the
+ * routers' tables are dropped before the workers start and rebuilt from the workers' results. The workers
+ * are local processes, but they share nothing except the sockets, so the same protocol would run across machines.
+ *
+ * @param routers A reference to a vector of Router objects initialized to a cold start, in ID order; their
+ *                tables are replaced by the merged result.
+ * @param nodes A constant reference to a set of all node IDs in the network.
+ * @param links A constant reference to a vector of Link objects representing the topology.
+ * @param workers The number of worker processes.
+ * @return The number of sweeps, as doBellmanFordAlg counts them.
+ */
+int
+doPartitionedBellmanFord (std::vector<Router> &routers, const std::set<int> &nodes, const std::vector<Link> &links, int workers) {
+
+    auto begin = std::chrono::steady_clock::now();
+
+    std::vector<int> ids(nodes.begin(), nodes.end());
+    std::map<int, int> index;
+    const std::size_t n = ids.size();
+
+    for (std::size_t i = 0; i < n; ++i) index[ids[i]] = i;
+
+    std::vector<std::vector<int>> sequence(n);
+    std::vector<std::set<int>> neighbors(n);
+    std::vector<bool> linked(n, false);
+    std::vector<Link> indexed;
+
+    for (const auto &link : links) {
+
+        int a = index[link.node1], b = index[link.node2];
+
+        indexed.push_back({a, b, link.pathCost});
+
+        sequence[a].push_back(b);
+        if (a != b) sequence[b].push_back(a);
+
+        linked[a] = linked[b] = true;
+
+        if (a == b) continue;
+
+        neighbors[a].insert(b);
+        neighbors[b].insert(a);
+
+    }
+
+    // The workers rebuild the cold start from the links, so neither they nor the coordinator hold every table
+    routers.clear();
+    routers.shrink_to_fit();
+
+    GraphPartitioner::Adjacency graph(n);
+
+    for (std::size_t r = 0; r < n; ++r) {
+        for (int neighbor : neighbors[r]) graph[r].push_back(std::make_pair(neighbor, 1));
+    }
+
+    workers = std::max(1, std::min<int>(workers, n));
+
+    std::vector<int> part = GraphPartitioner::partition(graph, workers);
+    std::vector<int> sockets(workers);
+    std::vector<pid_t> children(workers);
+
+    std::cout.flush();
+    std::cerr.flush();
+
+    for (int w = 0; w < workers; ++w) {
+
+        int pair[2];
+
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) != 0) {
+            std::cerr << "Cannot create worker socket: " << std::strerror(errno) << std::endl;
+            exit(EXIT_FAILURE);
+        }
+
+        children[w] = fork();
+
+        if (children[w] < 0) {
+            std::cerr << "Cannot start worker process: " << std::strerror(errno) << std::endl;
+            exit(EXIT_FAILURE);
+        }
+
+        if (children[w] == 0) {
+
+            for (int previous = 0; previous < w; ++previous) close(sockets[previous]);
+
+            close(pair[0]);
+            runPartitionWorker(pair[1], sequence, indexed, linked, part, w);
+            _exit(0);
+
+        }
+
+        close(pair[1]);
+        sockets[w] = pair[0];
+
+    }
+
+    // Workers owning a neighbor of each router, i.e. the recipients of its vector
+    std::vector<std::vector<int>> recipients(n);
+
+    for (std::size_t r = 0; r < n; ++r) {
+        for (int neighbor : neighbors[r]) {
+            if (part[neighbor] != part[r]) recipients[r].push_back(part[neighbor]);
+        }
+        std::sort(recipients[r].begin(), recipients[r].end());
+        recipients[r].erase(std::unique(recipients[r].begin(), recipients[r].end()), recipients[r].end());
+    }
+
+    // Vectors are relayed without blocking, so a worker blocked on a full socket can never stall the others
+    std::vector<std::string> pending(workers);
+    std::vector<pollfd> polls(workers);
+    int sweeps = 0, finished = 0;
+    bool updated = false, failed = false;
+    uint64_t bytes = 0;
+    std::vector<int32_t> message;
+
+    for (;;) {
+
+        for (int w = 0; w < workers; ++w) {
+            polls[w].fd = sockets[w];
+            polls[w].events = POLLIN | (pending[w].empty() ? 0 : POLLOUT);
+            polls[w].revents = 0;
+        }
+
+        if (poll(polls.data(), workers, -1) < 0) {
+            if (errno == EINTR) continue;
+            failed = true;
+            break;
+        }
+
+        for (int w = 0; w < workers && !failed; ++w) {
+
+            if ((polls[w].revents & POLLOUT) && !pending[w].empty()) {
+
+                ssize_t sent = send(sockets[w], pending[w].data(), pending[w].size(), MSG_DONTWAIT | MSG_NOSIGNAL);
+
+                if (sent > 0) pending[w].erase(0, sent);
+                else if (sent < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) failed = true;
+
+            }
+
+            if (!(polls[w].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+
+            if (!readWords(sockets[w], message)) {
+                failed = true;
+                break;
+            }
+
+            bytes += message.size() * sizeof(int32_t);
+
+            if (message[0] == 0) {
+
+                for (int recipient : recipients[message[1]]) {
+                    queueWords(pending[recipient], message);
+                    bytes += message.size() * sizeof(int32_t);
+                }
+
+            } else {
+
+                updated = updated || message[2] != 0;
+                ++finished;
+
+            }
+
+        }
+
+        if (failed || finished < workers) continue;
+
+        // Every worker ended the sweep and waits for the verdict, so the rest of the queue can be sent blocking
+        ++sweeps;
+
+        std::vector<int32_t> verdict{1, updated ? 1 : 0};
+
+        for (int w = 0; w < workers; ++w) {
+
+            queueWords(pending[w], verdict);
+            bytes += verdict.size() * sizeof(int32_t);
+
+            for (std::size_t done = 0; done < pending[w].size() && !failed; ) {
+
+                ssize_t sent = send(sockets[w], pending[w].data() + done, pending[w].size() - done, MSG_NOSIGNAL);
+
+                if (sent < 0 && errno == EINTR) continue;
+                if (sent <= 0) failed = true;
+                else done += sent;
+
+            }
+
+            pending[w].clear();
+
+        }
+
+        if (!updated || failed) break;
+
+        finished = 0;
+        updated = false;
+
+    }
+
+    // Copy the workers' tables into the routers, one router at a time
+    for (const int &id : nodes) routers.emplace_back(id, nodes);
+
+    for (int w = 0; w < workers && !failed; ++w) {
+
+        for (long owned = std::count(part.begin(), part.end(), w); owned > 0; --owned) {
+
+            if (!readWords(sockets[w], message) || message[0] != 2) {
+                failed = true;
+                break;
+            }
+
+            bytes += message.size() * sizeof(int32_t);
+
+            Router &router = routers[message[1]];
+
+            for (std::size_t d = 0; d < n; ++d) {
+                int hop = message[2 + n + d];
+                router.addRoute(ids[d], hop < 0 ? -1 : ids[hop], message[2 + d]);
+            }
+
+        }
+
+    }
+
+    for (int w = 0; w < workers; ++w) {
+        close(sockets[w]);
+        waitpid(children[w], nullptr, 0);
+    }
+
+    if (failed) {
+        std::cerr << "A worker process exited before the computation finished." << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    std::size_t linkCount = 0;
+
+    for (const auto &list : neighbors) linkCount += list.size();
+
+    std::cerr << "workers: " << workers << " processes, " << GraphPartitioner::cutWeight(graph, part) << " of "
+              << linkCount / 2 << " links cut, " << sweeps
+              << " sweeps, " << bytes << " bytes exchanged, " << seconds << " s" << std::endl;
+
+    return sweeps;
+
+}
+
+/**
+ * Computes the routes of all routers toward one destination with distance vector rounds restricted to that
+ * destination. In every round each router takes the cheapest link cost plus neighbor cost from the previous
+ * round, ties going to the lowest neighbor ID, until no cost changes.
+ *
+ * @param destinationID The destination.
+ * @param adjacency Router ID -> (neighbor ID, link cost), sorted by neighbor ID.
+ * @return Router ID -> (next hop ID, path cost) for every router that reaches the destination.
+ */
+std::map<int, std::pair<int, int>>
+doDestinationBellmanFord (int destinationID, const std::map<int, std::vector<std::pair<int, int>>> &adjacency) {
+
+    std::map<int, std::pair<int, int>> routes;
+
+    routes[destinationID] = std::make_pair(destinationID, 0);
+
+    for (bool changed = true; changed; ) {
+
+        changed = false;
+
+        std::map<int, std::pair<int, int>> next = routes;
+
+        for (const auto &router : adjacency) {
+
+            if (router.first == destinationID) continue;
+
+            std::pair<int, int> best(-1, 9999);
+
+            for (const auto &edge : router.second) {
+
+                auto it = routes.find(edge.first);
+
+                if (it != routes.end() && edge.second + it->second.second < best.second) best = std::make_pair(edge.first, edge.second + it->second.second);
+
+            }
+
+            if (best.first < 0) continue;
+
+            auto it = routes.find(router.first);
+
+            if (it == routes.end() || it->second != best) {
+                next[router.first] = best;
+                changed = true;
+            }
+
+        }
+
+        routes.swap(next);
+
+    }
+
+    return routes;
+
+}
+
+/**
+ * Recomputes the routing tables. With critical destinations, the routes toward them are computed first with
+ * doDestinationBellmanFord and written to standard output as "critical: epoch E destination D: router nextHop cost"
+ * lines, one per router that reaches D; then the full tables are computed as usual. Standard error reports the
+ * time to the critical routes, the time to full convergence, and how many critical routes the full run changed.
+ *
+ * @param epoch The current epoch.
+ * @param routers A reference to a vector of Router objects initialized to a cold start.
+ * @param nodes A constant reference to a set of all node IDs in the network.
+ * @param links A constant reference to a vector of Link objects representing the topology.
+ * @param critical The critical destination IDs; empty for a single full computation.
+ * @param workers Worker processes for doPartitionedBellmanFord, or 0 for doBellmanFordAlg.
+ * @return The number of sweeps of the full computation.
+ */
+int
+recomputeRoutes (int epoch, std::vector<Router> &routers, const std::set<int> &nodes, const std::vector<Link> &links,
+                 const std::vector<int> &critical, int workers) {
+
+    auto begin = std::chrono::steady_clock::now();
+    std::map<int, std::map<int, std::pair<int, int>>> published;
+
+    if (!critical.empty()) {
+
+        std::map<std::pair<int, int>, int> linkCost;
+        std::map<int, std::vector<std::pair<int, int>>> adjacency;
+
+        // As in resetRouters, the last of parallel links between two routers sets their cost
+        for (const auto &link : links) {
+            if (link.node1 != link.node2) linkCost[std::minmax(link.node1, link.node2)] = link.pathCost;
+        }
+
+        for (const auto &link : linkCost) {
+            adjacency[link.first.first].push_back(std::make_pair(link.first.second, link.second));
+            adjacency[link.first.second].push_back(std::make_pair(link.first.first, link.second));
+        }
+
+        for (auto &entry : adjacency) std::sort(entry.second.begin(), entry.second.end());
+
+        for (int destinationID : critical) {
+            if (nodes.count(destinationID)) published[destinationID] = doDestinationBellmanFord(destinationID, adjacency);
+        }
+
+        // The critical routes are out before the full computation starts
+        for (const auto &destination : published) {
+            for (const auto &route : destination.second) {
+                std::cout << "critical: epoch " << epoch << " destination " << destination.first << ": " << route.first << " "
+                          << route.second.first << " " << route.second.second << "\n";
+            }
+        }
+
+        std::cout.flush();
+
+    }
+
+    double criticalSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    int sweeps = (workers > 0) ? doPartitionedBellmanFord(routers, nodes, links, workers) : doBellmanFordAlg(routers, nodes, links);
+
+    if (critical.empty()) return sweeps;
+
+    double fullSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    int costChanges = 0, hopChanges = 0;
+
+    for (const auto &destination : published) {
+
+        for (const auto &router : routers) {
+
+            auto it = destination.second.find(router.getID());
+            int cost = (it == destination.second.end()) ? 9999 : it->second.second;
+
+            if (std::min(9999, router.getPathCost(destination.first)) != cost) ++costChanges;
+            else if (cost < 9999 && router.getID() != destination.first && router.getNextHop(destination.first) != it->second.first) ++hopChanges;
+
+        }
+
+    }
+
+    std::cerr << "priority: epoch " << epoch << ": " << published.size() << " critical destinations published after "
+              << criticalSeconds << " s, full convergence after " << fullSeconds << " s; the full run changed "
+              << costChanges << " critical route costs and " << hopChanges << " equal-cost next hops" << std::endl;
+
+    return sweeps;
+
+}
+
+/**
+ * Sticky tie-breaking: keeps each router's previous next hop toward a destination while it remains optimal, that is
+ * while the link to it plus its cost to the destination still equals the router's cost. Of parallel links the last
+ * one listed counts, as in the routing tables. Only hops over links of positive cost are kept, so the kept hops
+ * cannot form a loop.
+ *
+ * @param routers A reference to a vector of Router objects with the newly converged tables.
+ * @param previous A constant reference to a vector of Router objects with the tables of the previous epoch.
+ * @param links A constant reference to a vector of Link objects representing the current topology.
+ * @return The number of entries whose previous next hop was restored.
+ */
+int
+keepPreviousNextHops (std::vector<Router> &routers, const std::vector<Router> &previous, const std::vector<Link> &links) {
+
+    std::map<std::pair<int, int>, int> linkCost;
+
+    for (const auto &link : links) {
+
+        // A later link between the same routers replaces the earlier ones, as when the tables are built
+        for (const auto &key : {std::make_pair(link.node1, link.node2), std::make_pair(link.node2, link.node1)}) {
+            linkCost[key] = link.pathCost;
+        }
+
+    }
+
+    std::map<int, const Router*> before;
+    std::map<int, Router*> after;
+
+    for (const auto &router : previous) before[router.getID()] = &router;
+    for (auto &router : routers) after[router.getID()] = &router;
+
+    int restored = 0;
+
+    for (auto &router : routers) {
+
+        auto old = before.find(router.getID());
+
+        if (old == before.end()) continue;
+
+        for (const auto &entry : old->second->getRoutingTable()) {
+
+            int destinationID = entry.first, hop = entry.second.first;
+            auto current = router.getRoutingTable().find(destinationID);
+
+            if (hop < 0 || destinationID == router.getID() || current == router.getRoutingTable().end() ||
+                current->second.first == hop || current->second.second >= 9999) continue;
+
+            auto link = linkCost.find(std::make_pair(router.getID(), hop));
+            auto neighbor = after.find(hop);
+
+            if (link == linkCost.end() || link->second <= 0 || neighbor == after.end()) continue;
+
+            if (link->second + neighbor->second->getPathCost(destinationID) == current->second.second) {
+                router.addRoute(destinationID, hop, current->second.second);
+                ++restored;
+            }
+
+        }
+
+    }
+
+    return restored;
+
+}
+
+/**
+ * Counts the FIB updates between two epochs: the entries whose next hop changed, including routes that appeared
+ * or disappeared. A router's entry for itself is not part of its FIB.
+ *
+ * @param previous A constant reference to a vector of Router objects with the tables of the previous epoch; may be empty.
+ * @param routers A constant reference to a vector of Router objects with the current tables.
+ * @param entries Receives the number of FIB entries of the current tables.
+ * @return The number of FIB updates.
+ */
+long long
+countFibUpdates (const std::vector<Router> &previous, const std::vector<Router> &routers, long long &entries) {
+
+    std::map<int, const Router*> before;
+
+    for (const auto &router : previous) before[router.getID()] = &router;
+
+    auto fibHop = [](const Router *router, int destinationID) {
+
+        if (router == nullptr) return -1;
+
+        auto it = router->getRoutingTable().find(destinationID);
+
+        return (it == router->getRoutingTable().end() || it->second.second >= 9999) ? -1 : it->second.first;
+
+    };
+
+    long long updates = 0;
+
+    entries = 0;
+
+    for (const auto &router : routers) {
+
+        auto old = before.find(router.getID());
+        const Router *oldRouter = (old == before.end()) ? nullptr : old->second;
+        std::set<int> destinations;
+
+        for (const auto &entry : router.getRoutingTable()) destinations.insert(entry.first);
+        if (oldRouter != nullptr) for (const auto &entry : oldRouter->getRoutingTable()) destinations.insert(entry.first);
+
+        for (const int &destinationID : destinations) {
+
+            if (destinationID == router.getID()) continue;
+
+            int hop = fibHop(&router, destinationID);
+
+            if (hop >= 0) ++entries;
+            if (hop != fibHop(oldRouter, destinationID)) ++updates;
+
+        }
+
+    }
+
+    return updates;
+
+}
+
+/**
+ * @class ActorDvRuntime
+ * @brief Distance vector protocol with every router as an actor on a work-stealing scheduler.
+ *
+ * Each router owns a lock-free MPSC mailbox. Neighbors post their distance vectors into it. When
+ * mail arrives for an idle router, the sender schedules the router on the work-stealing pool. A
+ * running router drains a batch of its mail, recomputes its table from the latest vector of every
+ * neighbor, and posts its new vector to all neighbors if anything changed.
+ *
+ * Quiescence is detected with a count of posted but unprocessed messages. A router decrements the
+ * count only after posting the messages caused by its batch, so the count reaches zero only once no
+ * message is in flight and no router is running. At that point the tables have converged.
+ */
+class ActorDvRuntime {
+public:
+
+    /**
+     * @struct Result
+     * @brief Counters and timing of one run.
+     */
+    struct Result {
+        uint64_t messages = 0;      ///< Vectors delivered.
+        uint64_t activations = 0;   ///< Times a router was scheduled.
+        uint64_t steals = 0;        ///< Activations taken from another worker's deque.
+        double seconds = 0;         ///< Wall-clock time until quiescence.
+    };
+
+    /**
+     * Sets up one actor per router.
+     * @param nodes A constant reference to a set of all node IDs in the network.
+     * @param links A constant reference to a vector of Link objects representing the topology.
+     */
+    ActorDvRuntime(const std::set<int> &nodes, const std::vector<Link> &links) : ids(nodes.begin(), nodes.end()) {
+
+        std::map<int, int> index;
+
+        for (std::size_t i = 0; i < ids.size(); ++i) {
+            index[ids[i]] = i;
+            actors.emplace_back(new Actor());
+        }
+
+        // As in resetRouters, the last of parallel links between two routers sets their cost; a cost change appends a link
+        std::vector<std::map<int, int>> linkCost(ids.size());
+
+        for (const auto &link : links) {
+
+            int a = index[link.node1], b = index[link.node2];
+
+            if (a == b) continue;
+
+            linkCost[a][b] = link.pathCost;
+            linkCost[b][a] = link.pathCost;
+
+        }
+
+        for (std::size_t r = 0; r < ids.size(); ++r) {
+            actors[r]->neighbors.assign(linkCost[r].begin(), linkCost[r].end());
+            actors[r]->heard.resize(actors[r]->neighbors.size());
+        }
+
+    }
+
+    /**
+     * Runs the protocol from a cold start until quiescence and stores the converged tables.
+     * @param threads The number of worker threads.
+     * @param routers A reference to a vector of Router objects; it is replaced by the converged routers.
+     * @return The counters and timing of the run.
+     */
+    Result
+    run(unsigned threads, std::vector<Router> &routers) {
+
+        WorkStealingPool scheduler(threads);
+        const std::size_t n = ids.size();
+
+        pool = &scheduler;
+        inFlight = 0;
+        delivered = 0;
+        activations = 0;
+
+        auto begin = std::chrono::steady_clock::now();
+
+        for (std::size_t r = 0; r < n; ++r) {
+
+            actors[r]->distance.assign(n, 9999);
+            actors[r]->nextHop.assign(n, -1);
+            actors[r]->distance[r] = 0;
+            actors[r]->nextHop[r] = r;
+
+        }
+
+        for (std::size_t r = 0; r < n; ++r) announce(r);
+
+        scheduler.run([this](int r) { activate(r); }, [this]() { return inFlight.load() == 0; });
+
+        Result result;
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+        result.messages = delivered.load();
+        result.activations = activations.load();
+        result.steals = scheduler.getSteals();
+
+        std::set<int> nodes(ids.begin(), ids.end());
+
+        routers.clear();
+
+        for (std::size_t r = 0; r < n; ++r) {
+
+            routers.emplace_back(ids[r], nodes);
+
+            for (std::size_t d = 0; d < n; ++d) {
+                if (d != r && actors[r]->nextHop[d] >= 0) routers.back().addRoute(ids[d], ids[actors[r]->nextHop[d]], actors[r]->distance[d]);
+            }
+
+        }
+
+        pool = nullptr;
+
+        return result;
+
+    }
+
+private:
+
+    /**
+     * @struct Mail
+     * @brief A distance vector posted by a neighbor.
+     */
+    struct Mail {
+        int from = -1;
+        std::shared_ptr<const std::vector<int>> vector;
+    };
+
+    /**
+     * @struct Actor
+     * @brief A router's protocol state and mailbox.
+     */
+    struct Actor {
+        std::vector<std::pair<int, int>> neighbors;                     ///< (neighbor index, link cost), sorted by neighbor.
+        std::vector<std::shared_ptr<const std::vector<int>>> heard;     ///< Latest vector of every neighbor.
+        std::vector<int> distance;
+        std::vector<int> nextHop;
+        MpscQueue<Mail> mailbox;
+        std::atomic<bool> scheduled{false};                             ///< Set while the actor is queued or running.
+    };
+
+    /**
+     * Posts a router's current vector to all of its neighbors.
+     * @param r The sending router.
+     */
+    void
+    announce(int r) {
+
+        Actor &actor = *actors[r];
+        std::shared_ptr<const std::vector<int>> snapshot = std::make_shared<std::vector<int>>(actor.distance);
+
+        for (const auto &neighbor : actor.neighbors) {
+
+            Mail mail;
+            mail.from = r;
+            mail.vector = snapshot;
+
+            inFlight.fetch_add(1);
+            actors[neighbor.first]->mailbox.push(mail);
+
+            if (!actors[neighbor.first]->scheduled.exchange(true)) pool->schedule(neighbor.first);
+
+        }
+
+    }
+
+    /**
+     * Processes a batch of a router's mail.
+     * @param r The router.
+     */
+    void
+    activate(int r) {
+
+        static const int Batch = 64;
+
+        Actor &actor = *actors[r];
+        Mail mail;
+        int processed = 0;
+
+        ++activations;
+
+        while (processed < Batch && actor.mailbox.pop(mail)) {
+
+            auto slot = std::lower_bound(actor.neighbors.begin(), actor.neighbors.end(), std::make_pair(mail.from, INT_MIN));
+
+            actor.heard[slot - actor.neighbors.begin()] = mail.vector;
+            ++processed;
+
+        }
+
+        bool changed = false;
+
+        for (std::size_t d = 0; d < ids.size() && processed > 0; ++d) {
+
+            if (static_cast<int>(d) == r) continue;
+
+            int best = 9999, hop = -1;
+
+            for (std::size_t i = 0; i < actor.neighbors.size(); ++i) {
+
+                if (!actor.heard[i]) continue;
+
+                int cost = std::min(9999, actor.neighbors[i].second + (*actor.heard[i])[d]);
+
+                if (cost < best) {
+                    best = cost;
+                    hop = actor.neighbors[i].first;
+                }
+
+            }
+
+            if (best != actor.distance[d]) changed = true;
+
+            actor.distance[d] = best;
+            actor.nextHop[d] = hop;
+
+        }
+
+        if (changed) announce(r);
+
+        delivered.fetch_add(processed);
+
+        actor.scheduled.store(false);
+
+        // Mail that arrived after the last pop would otherwise wait for the next sender
+        if (!actor.mailbox.empty() && !actor.scheduled.exchange(true)) pool->schedule(r);
+
+        inFlight.fetch_sub(processed);
+
+    }
+
+    std::vector<int> ids;                           ///< Router index to router ID, in ID order.
+    std::vector<std::unique_ptr<Actor>> actors;
+    WorkStealingPool *pool = nullptr;               ///< The scheduler of the current run.
+    std::atomic<long long> inFlight{0};             ///< Messages posted but not yet processed.
+    std::atomic<uint64_t> delivered{0};
+    std::atomic<uint64_t> activations{0};
+};
+
+/**
+ * Runs the actor runtime on the current topology and compares its throughput, convergence time and
+ * results with the sequential doBellmanFordAlg; the report goes to standard error.
+ *
+ * @param epoch The current epoch.
+ * @param nodes A constant reference to a set of all node IDs in the network.
+ * @param links A constant reference to a vector of Link objects representing the current topology.
+ * @param routers A constant reference to a vector of Router objects with the converged sequential tables.
+ * @param threads The number of worker threads.
+ */
+void
+reportActorRuntime (int epoch, const std::set<int> &nodes, const std::vector<Link> &links, const std::vector<Router> &routers, unsigned threads) {
+
+    // Time the sequential algorithm from the same cold start
+    std::vector<Router> sequential;
+
+    for (const int &id : nodes) sequential.emplace_back(id, nodes);
+
+    for (const auto &link : links) {
+        getRouterByID(sequential, link.node1).addRoute(link.node2, link.node2, link.pathCost);
+        getRouterByID(sequential, link.node2).addRoute(link.node1, link.node1, link.pathCost);
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    doBellmanFordAlg(sequential, nodes, links);
+    double sequentialSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    ActorDvRuntime runtime(nodes, links);
+    std::vector<Router> converged;
+    ActorDvRuntime::Result result = runtime.run(threads, converged);
+
+    int mismatches = 0;
+
+    for (std::size_t r = 0; r < routers.size(); ++r) {
+        for (const int &destinationID : nodes) {
+            if (routers[r].getPathCost(destinationID) != converged[r].getPathCost(destinationID)) ++mismatches;
+        }
+    }
+
+    std::cerr << "actors: epoch " << epoch << ": " << threads << " threads, " << result.messages << " messages, "
+              << result.activations << " activations, " << result.steals << " steals, converged in " << result.seconds << " s ("
+              << (result.seconds > 0 ? result.messages / result.seconds : 0) << " messages/s); doBellmanFordAlg "
+              << sequentialSeconds << " s (speedup " << (result.seconds > 0 ? sequentialSeconds / result.seconds : 0) << "); "
+              << mismatches << " routes differ" << std::endl;
+
+}
+
+/**
+ * @class DvEventSimulation
+ * @brief Event-driven simulation of the distance vector protocol, run sequentially or as a conservative parallel
+ * discrete-event simulation (PDES) across worker threads.
+ *
+ * Every router starts with only its own route and sends its distance vector to its neighbors. A vector takes the
+ * link's delay to arrive: 1000 ticks per unit of cost plus a jitter below 1000 ticks drawn per link from the seed,
+ * and at least one tick, so that a vector never arrives at the time it was sent.
+ * On receipt a router recomputes its table from the latest vector of every neighbor. If anything changed, it sends
+ * its new vector to all neighbors. The simulation ends when no vector is in flight.
+ *
+ * For the parallel run the routers are split into contiguous blocks of a breadth-first order, one per thread. Each
+ * partition has its own event queue, and vectors crossing partitions go through a lock-free single-producer,
+ * single-consumer channel per ordered pair of partitions. Synchronization uses lookahead windows. No cross-partition
+ * vector arrives sooner than the smallest delay L of a cut link, so all partitions can process [T, T + L) in parallel,
+ * where T is the earliest pending event anywhere.
+ *
+ * Events are ordered by (time, receiver, sender, sender's send counter). This order does not depend on the
+ * partitioning, so every router sees exactly the same event sequence as in the sequential run. The final tables,
+ * event counts and convergence time are bit-identical for any thread count.
+ */
+class DvEventSimulation {
+public:
+
+    /**
+     * Sets up the routers and link delays of a topology.
+     * @param nodes A constant reference to a set of all node IDs in the network.
+     * @param links A constant reference to a vector of Link objects representing the topology.
+     * @param seed The seed of the per-link delay jitter.
+     */
+    DvEventSimulation(const std::set<int> &nodes, const std::vector<Link> &links, uint64_t seed) {
+
+        for (const int &id : nodes) {
+            index[id] = ids.size();
+            ids.push_back(id);
+        }
+
+        std::vector<std::map<int, std::pair<int, uint64_t>>> adjacency(ids.size());
+
+        for (const auto &link : links) {
+
+            int a = index[link.node1], b = index[link.node2];
+
+            if (a == b) continue;
+
+            uint64_t delay = uint64_t(std::max(0, link.pathCost)) * 1000 + mix(seed ^ mix(uint64_t(std::min(a, b)) << 32 | std::max(a, b))) % 1000;
+
+            // A zero-cost link whose jitter is 0 would deliver within the sender's own window and break the lookahead
+            delay = std::max<uint64_t>(1, delay);
+
+            adjacency[a][b] = std::make_pair(link.pathCost, delay);
+            adjacency[b][a] = std::make_pair(link.pathCost, delay);
+
+        }
+
+        routers.resize(ids.size());
+
+        for (std::size_t r = 0; r < ids.size(); ++r) {
+
+            for (const auto &neighbor : adjacency[r]) {
+                routers[r].neighbors.push_back({neighbor.first, neighbor.second.first, neighbor.second.second});
+            }
+
+            routers[r].heard.resize(routers[r].neighbors.size());
+
+        }
+
+    }
+
+    /**
+     * @struct Result
+     * @brief Outcome of one run.
+     */
+    struct Result {
+        uint64_t events = 0;        ///< Vectors received.
+        uint64_t finishTime = 0;    ///< Time of the last event, in ticks.
+        uint64_t digest = 0;        ///< Hash of every router's final distances and next hops.
+        uint64_t lookahead = 0;     ///< Lookahead of the parallel run, in ticks.
+        uint64_t windows = 0;       ///< Synchronization windows of the parallel run.
+        double seconds = 0;         ///< Wall-clock time of the run.
+    };
+
+    /**
+     * Runs the protocol to convergence from a cold start.
+     * @param threads The number of partitions and worker threads; 1 runs the plain sequential simulation.
+     * @return The events, convergence time, digest of the final tables and timing of the run.
+     */
+    Result
+    run(unsigned threads) {
+
+        auto begin = std::chrono::steady_clock::now();
+
+        threads = std::max(1u, std::min<unsigned>(threads, std::max<std::size_t>(1, ids.size())));
+
+        partitionRouters(threads);
+
+        for (auto &router : routers) {
+
+            router.distance.assign(ids.size(), Infinity);
+            router.nextHop.assign(ids.size(), -1);
+            router.sent = 0;
+            std::fill(router.heard.begin(), router.heard.end(), nullptr);
+
+        }
+
+        Result result;
+        std::vector<Partition> partitions(threads);
+
+        channels.clear();
+        for (unsigned i = 0; i < threads * threads; ++i) channels.emplace_back(new SpscQueue<Event>());
+
+        // Every router boots at time 0 with its own route and announces it
+        for (std::size_t r = 0; r < routers.size(); ++r) {
+
+            routers[r].distance[r] = 0;
+            routers[r].nextHop[r] = r;
+            announce(partitions[partitionOf[r]], r, 0);
+
+        }
+
+        if (threads == 1) {
+
+            process(partitions[0], 0, UINT64_MAX);
+
+        } else {
+
+            result.lookahead = lookahead();
+
+            ThreadPool pool(threads);
+            uint64_t now = nextTime(partitions);
+
+            while (now != UINT64_MAX) {
+
+                uint64_t windowEnd = (UINT64_MAX - now > result.lookahead) ? now + result.lookahead : UINT64_MAX;
+
+                for (unsigned p = 0; p < threads; ++p) {
+                    pool.submit([this, &partitions, p, windowEnd]() { process(partitions[p], p, windowEnd); });
+                }
+
+                pool.wait();
+
+                ++result.windows;
+                now = nextTime(partitions);
+
+            }
+
+        }
+
+        for (const auto &partition : partitions) {
+            result.events += partition.events;
+            result.finishTime = std::max(result.finishTime, partition.lastTime);
+        }
+
+        result.digest = 14695981039346656037ULL;
+
+        for (const auto &router : routers) {
+            for (std::size_t d = 0; d < ids.size(); ++d) {
+                result.digest = (result.digest ^ uint64_t(router.distance[d])) * 1099511628211ULL;
+                result.digest = (result.digest ^ uint64_t(router.nextHop[d] + 1)) * 1099511628211ULL;
+            }
+        }
+
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+        return result;
+
+    }
+
+    /**
+     * Counts the routes whose converged cost differs from the cost in the Bellman-Ford tables.
+     * @param reference A constant reference to a vector of Router objects with converged routing tables.
+     * @return The number of differing routes.
+     */
+    int
+    countMismatches(const std::vector<Router> &reference) const {
+
+        int mismatches = 0;
+
+        for (const auto &router : reference) {
+
+            const std::vector<int> &distance = routers[index.at(router.getID())].distance;
+
+            for (std::size_t d = 0; d < ids.size(); ++d) {
+
+                int cost = router.getPathCost(ids[d]);
+
+                if ((cost == -1 ? Infinity : cost) != distance[d]) ++mismatches;
+
+            }
+
+        }
+
+        return mismatches;
+
+    }
+
+    /**
+     * @return The number of routers.
+     */
+    std::size_t
+    size() const {
+
+        return ids.size();
+
+    }
+
+private:
+
+    static const int Infinity = 9999;
+
+    /**
+     * @struct Event
+     * @brief A distance vector arriving at a router.
+     */
+    struct Event {
+        uint64_t time;
+        int to;
+        int from;
+        uint32_t seq;                                   ///< The sender's send counter.
+        std::shared_ptr<const std::vector<int>> vector; ///< Snapshot of the sender's distances.
+
+        bool operator>(const Event &other) const {
+            if (time != other.time) return time > other.time;
+            if (to != other.to) return to > other.to;
+            if (from != other.from) return from > other.from;
+            return seq > other.seq;
+        }
+    };
+
+    /**
+     * @struct Neighbor
+     * @brief A link as seen from one of its ends.
+     */
+    struct Neighbor {
+        int index;
+        int cost;
+        uint64_t delay;     ///< Propagation delay in ticks.
+    };
+
+    /**
+     * @struct SimRouter
+     * @brief Protocol state of one router.
+     */
+    struct SimRouter {
+        std::vector<Neighbor> neighbors;                                ///< Sorted by neighbor index.
+        std::vector<std::shared_ptr<const std::vector<int>>> heard;     ///< Latest vector of every neighbor.
+        std::vector<int> distance;
+        std::vector<int> nextHop;
+        uint32_t sent = 0;
+    };
+
+    /**
+     * @struct Partition
+     * @brief Event queue and counters of one worker's block of routers.
+     */
+    struct Partition {
+        std::priority_queue<Event, std::vector<Event>, std::greater<Event>> queue;
+        uint64_t events = 0;
+        uint64_t lastTime = 0;
+        uint64_t sentMin = UINT64_MAX;      ///< Earliest vector sent to another partition in the current window.
+    };
+
+    static uint64_t
+    mix(uint64_t x) {
+
+        x += 0x9e3779b97f4a7c15ULL;
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+
+        return x ^ (x >> 31);
+
+    }
+
+    /**
+     * Splits the routers into contiguous blocks of a breadth-first order, so that most links stay inside a partition.
+     * @param partitions The number of blocks.
+     */
+    void
+    partitionRouters(unsigned partitions) {
+
+        std::vector<int> order;
+        std::vector<bool> seen(routers.size(), false);
+
+        for (std::size_t start = 0; start < routers.size(); ++start) {
+
+            if (seen[start]) continue;
+
+            seen[start] = true;
+            order.push_back(start);
+
+            for (std::size_t head = order.size() - 1; head < order.size(); ++head) {
+                for (const auto &neighbor : routers[order[head]].neighbors) {
+                    if (!seen[neighbor.index]) {
+                        seen[neighbor.index] = true;
+                        order.push_back(neighbor.index);
+                    }
+                }
+            }
+
+        }
+
+        partitionCount = partitions;
+        partitionOf.assign(routers.size(), 0);
+
+        for (std::size_t i = 0; i < order.size(); ++i) partitionOf[order[i]] = i * partitions / order.size();
+
+    }
+
+    /**
+     * @return The smallest delay of a link between two partitions; every link takes at least one tick.
+     */
+    uint64_t
+    lookahead() const {
+
+        uint64_t result = UINT64_MAX;
+
+        for (std::size_t r = 0; r < routers.size(); ++r) {
+            for (const auto &neighbor : routers[r].neighbors) {
+                if (partitionOf[r] != partitionOf[neighbor.index]) result = std::min(result, neighbor.delay);
+            }
+        }
+
+        return result;
+
+    }
+
+    /**
+     * Sends a router's current distance vector to all of its neighbors.
+     * @param partition The sender's partition.
+     * @param r The sending router.
+     * @param now The current time.
+     */
+    void
+    announce(Partition &partition, int r, uint64_t now) {
+
+        SimRouter &router = routers[r];
+        std::shared_ptr<const std::vector<int>> snapshot = std::make_shared<std::vector<int>>(router.distance);
+
+        for (const auto &neighbor : router.neighbors) {
+
+            Event event{now + neighbor.delay, neighbor.index, r, router.sent++, snapshot};
+
+            if (partitionOf[neighbor.index] == partitionOf[r]) {
+
+                partition.queue.push(event);
+
+            } else {
+
+                partition.sentMin = std::min(partition.sentMin, event.time);
+                channels[partitionOf[r] * partitionCount + partitionOf[neighbor.index]]->push(event);
+
+            }
+
+        }
+
+    }
+
+    /**
+     * Drains the partition's incoming channels, then processes its events earlier than the window end.
+     * @param partition The partition to run.
+     * @param p Its index.
+     * @param windowEnd The exclusive end of the window.
+     */
+    void
+    process(Partition &partition, unsigned p, uint64_t windowEnd) {
+
+        Event event;
+
+        for (unsigned q = 0; q < partitionCount; ++q) {
+            while (channels[q * partitionCount + p]->pop(event)) partition.queue.push(event);
+        }
+
+        partition.sentMin = UINT64_MAX;
+
+        while (!partition.queue.empty() && partition.queue.top().time < windowEnd) {
+
+            event = partition.queue.top();
+            partition.queue.pop();
+
+            ++partition.events;
+            partition.lastTime = event.time;
+
+            if (receive(event)) announce(partition, event.to, event.time);
+
+        }
+
+    }
+
+    /**
+     * Stores a neighbor's vector and recomputes the receiving router's table from all neighbors' latest vectors.
+     * @param event The arriving vector.
+     * @return True if the router's distances changed.
+     */
+    bool
+    receive(const Event &event) {
+
+        SimRouter &router = routers[event.to];
+
+        auto slot = std::lower_bound(router.neighbors.begin(), router.neighbors.end(), event.from,
+                                     [](const Neighbor &neighbor, int from) { return neighbor.index < from; });
+
+        router.heard[slot - router.neighbors.begin()] = event.vector;
+
+        bool changed = false;
+
+        for (std::size_t d = 0; d < ids.size(); ++d) {
+
+            if (static_cast<int>(d) == event.to) continue;
+
+            int best = Infinity, hop = -1;
+
+            for (std::size_t n = 0; n < router.neighbors.size(); ++n) {
+
+                if (!router.heard[n]) continue;
+
+                int cost = std::min(Infinity, router.neighbors[n].cost + (*router.heard[n])[d]);
+
+                if (cost < best) {
+                    best = cost;
+                    hop = router.neighbors[n].index;
+                }
+
+            }
+
+            if (best != router.distance[d]) changed = true;
+
+            router.distance[d] = best;
+            router.nextHop[d] = hop;
+
+        }
+
+        return changed;
+
+    }
+
+    /**
+     * @param partitions The partitions after a window.
+     * @return The earliest pending event, including vectors still in the channels, or UINT64_MAX.
+     */
+    uint64_t
+    nextTime(const std::vector<Partition> &partitions) const {
+
+        uint64_t next = UINT64_MAX;
+
+        for (const auto &partition : partitions) {
+            if (!partition.queue.empty()) next = std::min(next, partition.queue.top().time);
+            next = std::min(next, partition.sentMin);
+        }
+
+        return next;
+
+    }
+
+    std::vector<int> ids;                                       ///< Router index to router ID, in ID order.
+    std::map<int, int> index;                                   ///< Router ID to router index.
+    std::vector<SimRouter> routers;
+    std::vector<unsigned> partitionOf;                          ///< Router index to partition.
+    unsigned partitionCount = 1;
+    std::vector<std::unique_ptr<SpscQueue<Event>>> channels;    ///< from * partitions + to.
+};
+
+const int DvEventSimulation::Infinity;
+
+/**
+ * Runs the event-driven distance vector protocol sequentially and with every requested thread count,
+ * and reports the speedups and whether every parallel run matched the sequential one bit for bit.
+ *
+ * @param epoch The current epoch.
+ * @param nodes A constant reference to a set of all node IDs in the network.
+ * @param links A constant reference to a vector of Link objects representing the current topology.
+ * @param routers A constant reference to a vector of Router objects with converged Bellman-Ford tables.
+ * @param threadCounts The thread counts to run in parallel.
+ * @param seed The seed of the link delay jitter.
+ */
+void
+reportParallelSimulation (int epoch, const std::set<int> &nodes, const std::vector<Link> &links, const std::vector<Router> &routers,
+                          const std::vector<unsigned> &threadCounts, uint64_t seed) {
+
+    DvEventSimulation simulation(nodes, links, seed);
+    DvEventSimulation::Result sequential = simulation.run(1);
+
+    std::cerr << "pdes: epoch " << epoch << ": " << simulation.size() << " routers, " << sequential.events
+              << " events, converged at t=" << sequential.finishTime << ", " << simulation.countMismatches(routers)
+              << " routes differ from Bellman-Ford, sequential " << sequential.seconds << " s" << std::endl;
+
+    for (unsigned threads : threadCounts) {
+
+        DvEventSimulation::Result parallel = simulation.run(threads);
+        bool identical = parallel.digest == sequential.digest && parallel.events == sequential.events &&
+                         parallel.finishTime == sequential.finishTime;
+
+        std::cerr << "pdes:   " << threads << " threads: " << parallel.seconds << " s, speedup "
+                  << (parallel.seconds > 0 ? sequential.seconds / parallel.seconds : 0) << ", lookahead " << parallel.lookahead
+                  << ", " << parallel.windows << " windows, " << (identical ? "identical" : "DIFFERENT") << std::endl;
+
+    }
+
+}
+
+/**
+ * @class CoroutineDvSimulation
+ * @brief Distance vector protocol with every router's protocol loop as a stackless coroutine, sized for millions of routers.
+ *
+ * Routes are computed toward a given set of destinations only, e.g. those of the messages. A router then holds a few
+ * integers per destination and per link instead of a table over the whole network. Its coroutine waits for updates
+ * from its neighbors. Once its routes change it arms a hold-down timer and keeps absorbing updates until the timer
+ * fires, then advertises the changed routes to its neighbors once. Time advances in ticks, and an update sent in
+ * one tick arrives in the next.
+ *
+ * The routers are split into contiguous shards. Each shard allocates the frames of its routers from its own pool
+ * and has its own scheduler: the updates arriving this tick, sorted by receiver, and a timer wheel. Within a tick
+ * a shard resumes its routers in index order, and shards run a tick in parallel and exchange their outgoing
+ * updates between ticks. The result therefore does not depend on the number of shards.
+ */
+class CoroutineDvSimulation {
+public:
+
+    static const int Infinity = 9999;
+
+    /**
+     * @struct Result
+     * @brief Counters, timing and memory use of one run.
+     */
+    struct Result {
+        uint64_t ticks = 0;             ///< Ticks until no update was in flight and no timer armed.
+        uint64_t resumptions = 0;       ///< Times a coroutine was resumed.
+        uint64_t updates = 0;           ///< Route updates sent.
+        uint64_t peakInFlight = 0;      ///< Most updates in flight between two ticks.
+        std::size_t stateBytes = 0;     ///< Topology, routes and coroutine frames.
+        double seconds = 0;
+    };
+
+    /**
+     * Builds the link arrays; as in resetRouters, the last of parallel links between two routers sets their cost.
+     * @param ids The IDs of all routers, sorted and unique.
+     * @param links A constant reference to a vector of Link objects representing the topology.
+     * @param destinations The router indices routes are computed to.
+     * @param holdDown Ticks a router waits after a change before it advertises.
+     */
+    CoroutineDvSimulation(const std::vector<int> &ids, const std::vector<Link> &links, const std::vector<int> &destinations, int holdDown)
+        : ids(ids), destinations(destinations), holdDown(std::max(0, holdDown)) {
+
+        std::vector<std::pair<std::pair<int, int>, int>> arcs;
+
+        arcs.reserve(links.size() * 2);
+
+        for (const auto &link : links) {
+
+            int a = indexOf(link.node1), b = indexOf(link.node2);
+
+            if (a == b) continue;
+
+            arcs.push_back(std::make_pair(std::make_pair(a, b), link.pathCost));
+            arcs.push_back(std::make_pair(std::make_pair(b, a), link.pathCost));
+
+        }
+
+        std::stable_sort(arcs.begin(), arcs.end(), [](const std::pair<std::pair<int, int>, int> &x, const std::pair<std::pair<int, int>, int> &y) {
+            return x.first < y.first;
+        });
+
+        offset.assign(ids.size() + 1, 0);
+
+        for (std::size_t i = 0; i < arcs.size(); ++i) {
+
+            if (i + 1 < arcs.size() && arcs[i].first == arcs[i + 1].first) continue;
+
+            neighbor.push_back(arcs[i].first.second);
+            cost.push_back(arcs[i].second);
+            ++offset[arcs[i].first.first + 1];
+
+        }
+
+        for (std::size_t r = 0; r < ids.size(); ++r) offset[r + 1] += offset[r];
+
+    }
+
+    /**
+     * Runs the protocol from a cold start until no update is in flight.
+     * @param shardCount The number of shards, each run on its own thread.
+     * @return The counters, timing and memory use of the run.
+     */
+    Result
+    run(unsigned shardCount) {
+
+        const int n = ids.size();
+        const std::size_t k = destinations.size();
+
+        shardCount = std::max(1u, std::min<unsigned>(shardCount, std::max(1, n)));
+
+        auto begin = std::chrono::steady_clock::now();
+
+        distance.assign(static_cast<std::size_t>(n) * k, Infinity);
+        nextHop.assign(static_cast<std::size_t>(n) * k, -1);
+        advertised.assign(static_cast<std::size_t>(n) * k, Infinity);
+        heard.assign(neighbor.size() * k, Infinity);
+
+        for (std::size_t slot = 0; slot < k; ++slot) {
+            distance[static_cast<std::size_t>(destinations[slot]) * k + slot] = 0;
+            nextHop[static_cast<std::size_t>(destinations[slot]) * k + slot] = destinations[slot];
+        }
+
+        shards.clear();
+        shardBegin.clear();
+        frames.assign(n, nullptr);
+
+        for (unsigned s = 0; s < shardCount; ++s) {
+
+            shards.emplace_back(new Shard());
+            shards.back()->begin = static_cast<long long>(n) * s / shardCount;
+            shards.back()->end = static_cast<long long>(n) * (s + 1) / shardCount;
+            shards.back()->outbox.resize(shardCount);
+            shards.back()->wheel.resize(holdDown + 1);
+            shardBegin.push_back(shards.back()->begin);
+
+            for (int r = shards.back()->begin; r < shards.back()->end; ++r) frames[r] = shards.back()->pool.allocate();
+
+        }
+
+        std::unique_ptr<ThreadPool> pool;
+
+        if (shardCount > 1) pool.reset(new ThreadPool(shardCount));
+
+        Result result;
+
+        for (now = 0;; ++now) {
+
+            if (pool) {
+                for (auto &shard : shards) pool->submit([this, &shard]() { runTick(*shard); });
+                pool->wait();
+            } else {
+                runTick(*shards.front());
+            }
+
+            // Deliver the updates sent in this tick to the shards of their receivers
+            uint64_t pending = 0;
+
+            for (unsigned target = 0; target < shardCount; ++target) {
+
+                Shard &receiver = *shards[target];
+
+                for (auto &sender : shards) {
+                    receiver.inbox.insert(receiver.inbox.end(), sender->outbox[target].begin(), sender->outbox[target].end());
+                    sender->outbox[target].clear();
+                }
+
+                pending += receiver.inbox.size();
+
+            }
+
+            result.peakInFlight = std::max(result.peakInFlight, pending);
+
+            bool armed = false;
+
+            for (auto &shard : shards) {
+                for (const auto &slot : shard->wheel) armed = armed || !slot.empty();
+            }
+
+            if (pending == 0 && !armed) break;
+
+        }
+
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+        result.ticks = now + 1;
+
+        result.stateBytes = (offset.capacity() + neighbor.capacity() + cost.capacity() + heard.capacity() + distance.capacity() +
+                             nextHop.capacity() + advertised.capacity()) * sizeof(int) + frames.capacity() * sizeof(RouterFrame*);
+
+        for (auto &shard : shards) {
+
+            result.resumptions += shard->resumptions;
+            result.updates += shard->sent;
+            result.stateBytes += shard->pool.memoryBytes();
+
+        }
+
+        return result;
+
+    }
+
+    /**
+     * @param id A router ID.
+     * @return The router's index, or -1 if there is no such router.
+     */
+    int
+    indexOf(int id) const {
+
+        auto it = std::lower_bound(ids.begin(), ids.end(), id);
+
+        return (it != ids.end() && *it == id) ? static_cast<int>(it - ids.begin()) : -1;
+
+    }
+
+    /**
+     * @param r A router index.
+     * @param slot A destination slot, i.e. a position in the destinations given to the constructor.
+     * @return The cost of the route, or Infinity if there is none.
+     */
+    int
+    getPathCost(int r, int slot) const {
+
+        return distance[static_cast<std::size_t>(r) * destinations.size() + slot];
+
+    }
+
+    /**
+     * @param r A router index.
+     * @param slot A destination slot.
+     * @return The router index of the next hop, or -1 if there is no route.
+     */
+    int
+    getNextHop(int r, int slot) const {
+
+        return nextHop[static_cast<std::size_t>(r) * destinations.size() + slot];
+
+    }
+
+    /**
+     * @return The number of routers.
+     */
+    std::size_t
+    size() const {
+
+        return ids.size();
+
+    }
+
+    /**
+     * @return The size of a coroutine frame in bytes.
+     */
+    static std::size_t
+    frameBytes() {
+
+        return sizeof(RouterFrame);
+
+    }
+
+private:
+
+    /**
+     * @struct RouterFrame
+     * @brief The state of a router's coroutine that survives a suspension.
+     */
+    struct RouterFrame {
+        uint32_t line = 0;      ///< Resume point.
+        uint32_t wakeAt = 0;    ///< Tick the hold-down timer fires at.
+    };
+
+    /**
+     * @struct Update
+     * @brief A neighbor's new cost to one destination.
+     */
+    struct Update {
+        int to;
+        int from;
+        int slot;
+        int cost;
+
+        bool operator<(const Update &other) const {
+            return to != other.to ? to < other.to : (from != other.from ? from < other.from : slot < other.slot);
+        }
+    };
+
+    /**
+     * @struct Shard
+     * @brief A contiguous range of routers with its own frame pool and scheduler.
+     */
+    struct Shard {
+        int begin = 0;
+        int end = 0;
+        FramePool<RouterFrame> pool;
+        std::vector<Update> inbox;                  ///< Updates arriving in the current tick.
+        std::vector<std::vector<Update>> outbox;    ///< Updates sent in the current tick, per receiving shard.
+        std::vector<std::vector<int>> wheel;        ///< Routers whose timer fires at a tick, indexed by tick modulo its size.
+        std::vector<int> touched;                   ///< Destination slots updated in the current absorb().
+        const Update *mail = nullptr;               ///< Unread updates of the router being resumed.
+        const Update *mailEnd = nullptr;
+        uint64_t resumptions = 0;
+        uint64_t sent = 0;
+    };
+
+    /**
+     * Resumes every router of a shard that has updates or a firing timer in the current tick; in the first tick all of them.
+     */
+    void
+    runTick(Shard &shard) {
+
+        std::sort(shard.inbox.begin(), shard.inbox.end());
+
+        std::vector<int> timers;
+
+        timers.swap(shard.wheel[now % shard.wheel.size()]);
+
+        std::size_t i = 0, j = 0;
+        int next = shard.begin;
+
+        for (;;) {
+
+            int r = INT_MAX;
+
+            if (now == 0 && next < shard.end) r = next++;
+            if (i < shard.inbox.size()) r = std::min(r, shard.inbox[i].to);
+            if (j < timers.size()) r = std::min(r, timers[j]);
+
+            if (r == INT_MAX) break;
+
+            std::size_t last = i;
+
+            while (last < shard.inbox.size() && shard.inbox[last].to == r) ++last;
+            while (j < timers.size() && timers[j] == r) ++j;
+
+            shard.mail = shard.inbox.data() + i;
+            shard.mailEnd = shard.inbox.data() + last;
+            i = last;
+
+            resume(shard, r);
+            ++shard.resumptions;
+
+        }
+
+        shard.inbox.clear();
+
+    }
+
+    /**
+     * The protocol loop of router r. It advertises its initial routes, then waits for updates. After a change it
+     * waits for the hold-down timer, absorbing the updates that arrive meanwhile, and advertises once.
+     */
+    void
+    resume(Shard &shard, int r) {
+
+        RouterFrame &frame = *frames[r];
+
+        CO_BEGIN(frame);
+
+        advertise(shard, r);
+
+        for (;;) {
+
+            CO_AWAIT(frame, shard.mail != shard.mailEnd);
+
+            if (!absorb(shard, r)) continue;
+
+            frame.wakeAt = now + holdDown;
+
+            if (holdDown > 0) shard.wheel[frame.wakeAt % shard.wheel.size()].push_back(r);
+
+            do {
+
+                CO_AWAIT(frame, shard.mail != shard.mailEnd || now >= frame.wakeAt);
+
+                absorb(shard, r);
+
+            } while (now < frame.wakeAt);
+
+            advertise(shard, r);
+
+        }
+
+        CO_END(frame);
+
+    }
+
+    /**
+     * Reads the router's unread updates and recomputes the routes they touched.
+     * @return True if the cost of a route changed.
+     */
+    bool
+    absorb(Shard &shard, int r) {
+
+        const std::size_t k = destinations.size();
+
+        shard.touched.clear();
+
+        for (; shard.mail != shard.mailEnd; ++shard.mail) {
+
+            std::size_t e = std::lower_bound(neighbor.begin() + offset[r], neighbor.begin() + offset[r + 1], shard.mail->from) - neighbor.begin();
+
+            heard[e * k + shard.mail->slot] = shard.mail->cost;
+            shard.touched.push_back(shard.mail->slot);
+
+        }
+
+        std::sort(shard.touched.begin(), shard.touched.end());
+        shard.touched.erase(std::unique(shard.touched.begin(), shard.touched.end()), shard.touched.end());
+
+        bool changed = false;
+
+        for (int slot : shard.touched) {
+
+            if (destinations[slot] == r) continue;
+
+            int best = Infinity, hop = -1;
+
+            for (int e = offset[r]; e < offset[r + 1]; ++e) {
+
+                int candidate = std::min(Infinity, cost[e] + heard[e * k + slot]);
+
+                if (candidate < best) {
+                    best = candidate;
+                    hop = neighbor[e];
+                }
+
+            }
+
+            std::size_t entry = static_cast<std::size_t>(r) * k + slot;
+
+            if (best != distance[entry]) changed = true;
+
+            distance[entry] = best;
+            nextHop[entry] = hop;
+
+        }
+
+        return changed;
+
+    }
+
+    /**
+     * Sends the routes whose cost changed since the last advertisement to all neighbors.
+     */
+    void
+    advertise(Shard &shard, int r) {
+
+        const std::size_t k = destinations.size();
+
+        for (std::size_t slot = 0; slot < k; ++slot) {
+
+            std::size_t entry = static_cast<std::size_t>(r) * k + slot;
+
+            if (distance[entry] == advertised[entry]) continue;
+
+            advertised[entry] = distance[entry];
+
+            for (int e = offset[r]; e < offset[r + 1]; ++e) {
+
+                int receiver = neighbor[e];
+                std::size_t target = std::upper_bound(shardBegin.begin(), shardBegin.end(), receiver) - shardBegin.begin() - 1;
+
+                shard.outbox[target].push_back({receiver, r, static_cast<int>(slot), distance[entry]});
+                ++shard.sent;
+
+            }
+
+        }
+
+    }
+
+    std::vector<int> ids;                   ///< Router index to router ID, in ID order.
+    std::vector<int> destinations;          ///< Destination slot to router index.
+    int holdDown;
+    std::vector<int> offset;                ///< Links of router r are [offset[r], offset[r + 1]).
+    std::vector<int> neighbor;              ///< Per link: the neighbor's index, sorted per router.
+    std::vector<int> cost;                  ///< Per link: the cost.
+    std::vector<int> heard;                 ///< Per link and destination slot: the neighbor's last advertised cost.
+    std::vector<int> distance;              ///< Per router and destination slot.
+    std::vector<int> nextHop;               ///< Per router and destination slot: next hop index, or -1.
+    std::vector<int> advertised;            ///< Per router and destination slot: the cost last sent to the neighbors.
+    std::vector<RouterFrame*> frames;       ///< Per router: its coroutine frame, from its shard's pool.
+    std::vector<std::unique_ptr<Shard>> shards;
+    std::vector<int> shardBegin;            ///< First router index of every shard.
+    uint32_t now = 0;                       ///< The current tick.
+};
+
+const int CoroutineDvSimulation::Infinity;
+
+/**
+ * Runs the simulation in coroutine mode: the routes to the destinations of the messages are computed by
+ * CoroutineDvSimulation from a cold start in every epoch, and only the message routes are written, since
+ * full forwarding tables do not fit at the scale this mode is meant for. The statistics go to standard error.
+ *
+ * @param topologyFile The path to the file containing the initial network topology.
+ * @param messageFile The path to the file containing messages to be routed.
+ * @param changesFile The path to the file containing network topology changes.
+ * @param outputFile The path to the file where the message routes will be written.
+ * @param shards The number of scheduler shards.
+ * @param holdDown Ticks a router waits after a change before it advertises.
+ */
+void
+runCoroutineSimulation (const std::string &topologyFile, const std::string &messageFile, const std::string &changesFile,
+                        const std::string &outputFile, unsigned shards, int holdDown) {
+
+    std::ifstream file(topologyFile);
+
+    if (!file.is_open()) {
+        std::cerr << "Cannot open topology file: " << topologyFile << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    std::vector<Link> links;
+    std::vector<int> ids;
+    int node1, node2, pathCost;
+
+    while (file >> node1 >> node2 >> pathCost) {
+        links.push_back({node1, node2, pathCost});
+        ids.push_back(node1);
+        ids.push_back(node2);
+    }
+
+    file.close();
+
+    std::vector<Message> messages;
+    std::vector<Change> changes;
+    std::vector<double> times;
+    FailedRouters failed;
+
+    readMessagesFile(messageFile, messages);
+    readChangesFile(changesFile, changes, std::set<int>(ids.begin(), ids.end()), times);
+
+    std::ofstream outFile(outputFile, std::ios::app);
+
+    if (!outFile.is_open()) {
+        std::cerr << "Cannot open output file: " << outputFile << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    for (std::size_t epoch = 0; epoch <= changes.size(); ++epoch) {
+
+        if (epoch > 0) {
+
+            const Change &change = changes[epoch - 1];
+
+            ids.push_back(change.node1);
+            ids.push_back(change.node2);
+
+            applyLinkChange(change, links, failed);
+
+        }
+
+        std::sort(ids.begin(), ids.end());
+        ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+
+        // One destination slot per distinct destination of the messages
+        std::vector<int> destinations;
+
+        for (const auto &message : messages) {
+
+            auto it = std::lower_bound(ids.begin(), ids.end(), message.destinationID);
+
+            if (it != ids.end() && *it == message.destinationID) destinations.push_back(it - ids.begin());
+
+        }
+
+        std::sort(destinations.begin(), destinations.end());
+        destinations.erase(std::unique(destinations.begin(), destinations.end()), destinations.end());
+
+        CoroutineDvSimulation simulation(ids, links, destinations, holdDown);
+        CoroutineDvSimulation::Result result = simulation.run(shards);
+
+        for (const auto &message : messages) {
+
+            int source = simulation.indexOf(message.sourceID);
+            int target = simulation.indexOf(message.destinationID);
+            int slot = (target < 0) ? -1 : std::lower_bound(destinations.begin(), destinations.end(), target) - destinations.begin();
+            int pathCost = (source < 0 || slot < 0) ? CoroutineDvSimulation::Infinity : simulation.getPathCost(source, slot);
+
+            if (pathCost == CoroutineDvSimulation::Infinity) {
+
+                outFile << "from " << message.sourceID << " to " << message.destinationID
+                        << " cost infinite hops unreachable message " << message.message << "\n\n";
+
+                continue;
+
+            }
+
+            outFile << "from " << message.sourceID << " to " << message.destinationID << " cost " << pathCost << " hops ";
+
+            for (int current = source; current != target; current = simulation.getNextHop(current, slot)) outFile << ids[current] << " ";
+
+            outFile << "message " << message.message << "\n\n";
+
+        }
+
+        std::cerr << "coroutines: epoch " << epoch << ": " << simulation.size() << " routers, " << destinations.size()
+                  << " destinations, " << shards << " shards, " << result.ticks << " ticks, " << result.resumptions
+                  << " resumptions, " << result.updates << " updates (peak " << result.peakInFlight << " in flight), "
+                  << CoroutineDvSimulation::frameBytes() << "-byte frames, " << result.stateBytes / (1024.0 * 1024.0)
+                  << " MiB state, " << result.seconds << " s" << std::endl;
+
+    }
+
+    outFile.close();
+
+}
+
+/**
+ * Records the current routing tables of all routers as the next epoch of the history.
+ *
+ * Only the entries that differ from the previous epoch are handed to the history, and only
+ * the pages holding them are copied, so an epoch after a change costs memory proportional
+ * to the entries that change touched.
+ *
+ * @param history The epoch history to append to.
+ * @param routers A constant reference to a vector of Router objects representing all routers in the network.
+ */
+void
+recordEpoch (History &history, const std::vector<Router> &routers) {
+
+    std::vector<History::Row> changed;
+    std::vector<std::pair<int, int>> removed;
+    std::size_t epochs = history.epochCount(), kept = 0;
+
+    for (const auto &router : routers) {
+
+        for (const auto &entry : router.getRoutingTable()) {
+
+            std::pair<int, int> key(router.getID(), entry.first);
+            HistoryRow row = {entry.second.first, entry.second.second};
+            const HistoryRow *previous = epochs ? history.find(epochs - 1, key) : nullptr;
+
+            if (previous) ++kept;
+
+            if (!previous || !(*previous == row)) changed.push_back(History::Row(key, row));
+
+        }
+
+    }
+
+    // Entries of the previous epoch that were not seen again are gone; only look for them if there are any
+    if (epochs && kept < history.rowCount(epochs - 1)) {
+
+        std::map<int, const Router*> byID;
+
+        for (const auto &router : routers) byID[router.getID()] = &router;
+
+        history.forEach(epochs - 1, [&](const std::pair<int, int> &key, const HistoryRow &) {
+
+            auto router = byID.find(key.first);
+
+            if (router == byID.end() || !router->second->getRoutingTable().count(key.second)) removed.push_back(key);
+
+        });
+
+    }
+
+    history.commit(changed, removed);
+
+}
+
+/**
+ * Prints the routing tables of a recorded epoch in the same format as writeFT.
+ * @param out The stream to print to.
+ * @param history The epoch history.
+ * @param epoch The epoch to print.
+ */
+void
+writeEpoch (std::ostream &out, const History &history, std::size_t epoch) {
+
+    std::vector<History::Row> rows = history.rows(epoch);
+
+    for (std::size_t i = 0; i < rows.size(); ++i) {
+
+        int pathCost = (rows[i].second.pathCost == 9999) ? -999 : rows[i].second.pathCost;
+
+        out << rows[i].first.second << " " << rows[i].second.nextHopID << " " << pathCost << "\n";
+
+        if (i + 1 == rows.size() || rows[i + 1].first.first != rows[i].first.first) out << "\n";
+
+    }
+
+}
+
+/**
+ * Prints the memory statistics of the epoch history to standard error.
+ * @param history The epoch history.
+ */
+void
+reportHistory (const History &history) {
+
+    std::size_t epochs = history.epochCount();
+
+    std::cerr << "history: " << epochs << " epochs, "
+              << (epochs ? history.rowCount(epochs - 1) : 0) << " rows in the latest epoch, "
+              << history.livePages() << " live pages, "
+              << history.getRowsWritten() << " rows written, "
+              << history.storedBytes() << " bytes stored vs "
+              << history.fullCopyBytes() << " bytes for full copies" << std::endl;
+
+}
+
+/**
+ * @class ChangeJournal
+ * @brief Append-only journal of topology changes with periodic full snapshots.
+ *
+ * The journal is a text file holding one "change" record per applied change and, every
+ * snapshotEvery epochs, a "snapshot" block with the nodes, links and routing tables of that
+ * epoch. A companion index file (the journal path with ".idx" appended) lists the byte
+ * offset of every snapshot, so restoring epoch N reads one snapshot and replays at most
+ * snapshotEvery - 1 changes.
+ */
+class ChangeJournal {
+public:
+
+    /**
+     * Creates (or truncates) the journal and its index.
+     * @param journalFile The path of the journal file.
+     * @param snapshotEvery The number of epochs between two snapshots.
+     */
+    ChangeJournal(const std::string &journalFile, int snapshotEvery)
+        : journal(journalFile, std::ofstream::out), index(journalFile + ".idx", std::ofstream::out),
+          snapshotEvery(snapshotEvery) {
+
+        if (!journal.is_open() || !index.is_open()) {
+            std::cerr << "Cannot open journal file: " << journalFile << std::endl;
+            exit(EXIT_FAILURE);
+        }
+
+    }
+
+    /**
+     * Appends a change record.
+     * @param epoch The epoch the change produces.
+     * @param change The change as read from the changes file.
+     */
+    void
+    recordChange(int epoch, const Change &change) {
+
+        journal << "change " << epoch << " ";
+
+        if (change.kind == LinkChange) {
+            journal << change.node1 << " " << change.node2 << " " << change.pathCost << "\n";
+        } else {
+            journal << (change.kind == RouterDown ? "down " : "up ") << change.node1 << "\n";
+        }
+
+    }
+
+    /**
+     * Appends a full snapshot of the routing state if the epoch falls on the snapshot cadence.
+     * @param epoch The epoch the state belongs to.
+     * @param nodes A constant reference to the set of node IDs.
+     * @param links A constant reference to the current links.
+     * @param failed A constant reference to the down routers and their links.
+     * @param routers A constant reference to the converged routers.
+     */
+    void
+    recordEpoch(int epoch, const std::set<int> &nodes, const std::vector<Link> &links, const FailedRouters &failed,
+                const std::vector<Router> &routers) {
+
+        if (epoch % snapshotEvery != 0) return;
+
+        journal.flush();
+        index << epoch << " " << journal.tellp() << "\n";
+        index.flush();
+
+        journal << "snapshot " << epoch << "\n";
+
+        for (const int &id : nodes) journal << "node " << id << "\n";
+
+        for (const auto &link : links) journal << "link " << link.node1 << " " << link.node2 << " " << link.pathCost << "\n";
+
+        for (const int &id : failed.down) journal << "down " << id << "\n";
+
+        for (const auto &link : failed.links) journal << "failed " << link.node1 << " " << link.node2 << " " << link.pathCost << "\n";
+
+        for (const auto &router : routers) {
+
+            for (const auto &entry : router.getRoutingTable()) {
+
+                journal << "route " << router.getID() << " " << entry.first << " "
+                        << entry.second.first << " " << entry.second.second << "\n";
+
+            }
+
+        }
+
+        journal << "end\n";
+
+    }
+
+private:
+    std::ofstream journal;      ///< The append-only journal.
+    std::ofstream index;        ///< Snapshot epoch to journal byte offset.
+    int snapshotEvery;          ///< Number of epochs between two snapshots.
+};
+
+/**
+ * Restores the routing state of a given epoch from a change journal.
+ *
+ * The nearest snapshot at or before the epoch is located through the journal index and
+ * loaded, then the journaled changes up to the epoch are replayed with applyChange and
+ * doBellmanFordAlg.
+ *
+ * @param journalFile The path of the journal written by a previous run.
+ * @param epoch The epoch to restore.
+ * @param routers A reference to a vector of Router objects that receives the restored routers.
+ * @param nodes A reference to a set that receives the node IDs of the epoch.
+ * @param links A reference to a vector that receives the links of the epoch.
+ */
+void
+seekToEpoch (const std::string &journalFile, int epoch, std::vector<Router> &routers, std::set<int> &nodes, std::vector<Link> &links) {
+
+    std::ifstream index(journalFile + ".idx");
+
+    if (!index.is_open()) {
+        std::cerr << "Cannot open journal index: " << journalFile << ".idx" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    int snapshotEpoch = -1, indexedEpoch;
+    long long offset = 0, indexedOffset;
+
+    while (index >> indexedEpoch >> indexedOffset) {
+
+        if (indexedEpoch <= epoch && indexedEpoch > snapshotEpoch) {
+            snapshotEpoch = indexedEpoch;
+            offset = indexedOffset;
+        }
+
+    }
+
+    std::ifstream journal(journalFile);
+
+    if (snapshotEpoch < 0 || !journal.is_open()) {
+        std::cerr << "No snapshot at or before epoch " << epoch << " in journal: " << journalFile << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    journal.seekg(offset);
+
+    std::vector<std::vector<int>> routes;
+    std::string line, kind;
+    FailedRouters failed;
+
+    std::getline(journal, line);
+
+    while (std::getline(journal, line) && line != "end") {
+
+        std::istringstream iss(line);
+        int a, b, c, d;
+
+        iss >> kind;
+
+        if (kind == "node" && iss >> a) {
+            nodes.insert(a);
+        } else if (kind == "link" && iss >> a >> b >> c) {
+            links.push_back({a, b, c});
+        } else if (kind == "down" && iss >> a) {
+            failed.down.insert(a);
+        } else if (kind == "failed" && iss >> a >> b >> c) {
+            failed.links.push_back({a, b, c});
+        } else if (kind == "route" && iss >> a >> b >> c >> d) {
+            routes.push_back({a, b, c, d});
+        }
+
+    }
+
+    routers.clear();
+
+    for (const int &id : nodes) routers.emplace_back(id, nodes);
+
+    for (const auto &route : routes) getRouterByID(routers, route[0]).addRoute(route[1], route[2], route[3]);
+
+    int reached = snapshotEpoch;
+
+    while (reached < epoch && std::getline(journal, line)) {
+
+        std::istringstream iss(line);
+        std::string record;
+        int changeEpoch;
+        Change change;
+        double time = 0;
+
+        if (!(iss >> kind >> changeEpoch) || kind != "change" || !std::getline(iss, record) ||
+            !parseChangeLine(record, change, time)) continue;
+
+        applyChange(change, routers, nodes, links, failed);
+
+        doBellmanFordAlg(routers, nodes, links);
+
+        reached = changeEpoch;
+
+    }
+
+    if (reached != epoch) {
+        std::cerr << "Epoch " << epoch << " is beyond the end of the journal: " << journalFile << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    std::cerr << "seek: loaded snapshot of epoch " << snapshotEpoch << ", replayed "
+              << (epoch - snapshotEpoch) << " changes" << std::endl;
+
+}
+
+/**
+ * @struct Scenario
+ * @brief One run of a batch: a topology with its own messages, changes and output file.
+ */
+struct Scenario {
+    std::string topologyFile;
+    std::string messageFile;
+    std::string changesFile;
+    std::string outputFile;
+};
+
+/**
+ * @struct Baseline
+ * @brief A parsed topology with its converged routing tables, shared read-only by the scenarios of a batch.
+ */
+struct Baseline {
+    std::vector<Link> links;
+    std::set<int> nodes;
+    std::vector<Router> routers;
+};
+
+/**
+ * Reads a batch manifest with one "topologyFile messageFile changesFile outputFile" line per scenario.
+ * Blank lines and lines starting with '#' are skipped.
+ *
+ * @param manifestFile The path to the manifest.
+ * @param scenarios A reference to a vector of Scenario structs where the scenarios will be stored.
+ */
+void
+readManifestFile (const std::string &manifestFile, std::vector<Scenario> &scenarios) {
+
+    std::ifstream file(manifestFile);
+
+    if (!file.is_open()) {
+        std::cerr << "Cannot open manifest file: " << manifestFile << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    std::string line;
+    int lineNumber = 0;
+
+    while (std::getline(file, line)) {
+
+        ++lineNumber;
+
+        std::istringstream iss(line);
+        Scenario scenario;
+
+        if (!(iss >> scenario.topologyFile) || scenario.topologyFile[0] == '#') continue;
+
+        if (!(iss >> scenario.messageFile >> scenario.changesFile >> scenario.outputFile)) {
+            std::cerr << "Invalid manifest line " << lineNumber << ": " << line << std::endl;
+            exit(EXIT_FAILURE);
+        }
+
+        scenarios.push_back(scenario);
+
+    }
+
+}
+
+/**
+ * Runs one scenario of a batch from its topology's converged baseline. The output is the same as that of a
+ * separate run of the program on the scenario's files.
+ *
+ * @param baseline A constant reference to the Baseline of the scenario's topology.
+ * @param scenario A constant reference to the Scenario to run.
+ */
+void
+runScenario (const Baseline &baseline, const Scenario &scenario) {
+
+    std::vector<Link> links = baseline.links;
+    std::set<int> nodes = baseline.nodes;
+    std::vector<Router> routers = baseline.routers;
+    std::vector<Change> changes;
+    std::vector<Message> messages;
+    std::vector<double> times;
+    FailedRouters failed;
+
+    std::ofstream outFile(scenario.outputFile, std::ofstream::out);
+    if (!outFile.is_open()) {
+        std::cerr << "Cannot open output file: " << scenario.outputFile << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    outFile.close();
+
+    readMessagesFile(scenario.messageFile, messages);
+
+    writeFT(scenario.outputFile, routers);
+
+    sendMessages(scenario.outputFile, routers, messages);
+
+    readChangesFile(scenario.changesFile, changes, nodes, times);
+
+    for (const auto &change : changes) {
+
+        applyChange(change, routers, nodes, links, failed);
+
+        doBellmanFordAlg(routers, nodes, links);
+
+        writeFT(scenario.outputFile, routers);
+
+        sendMessages(scenario.outputFile, routers, messages);
+
+    }
+
+}
+
+/**
+ * Runs every scenario of a batch manifest. Each distinct topology is parsed and converged once, and its scenarios
+ * start from copies of that baseline. Baselines and then scenarios run concurrently on one shared thread pool.
+ *
+ * @param manifestFile The path to the manifest.
+ * @param threads The number of threads; 0 selects the number of hardware threads.
+ */
+void
+runBatch (const std::string &manifestFile, unsigned threads) {
+
+    auto begin = std::chrono::steady_clock::now();
+    std::vector<Scenario> scenarios;
+
+    readManifestFile(manifestFile, scenarios);
+
+    std::map<std::string, Baseline> baselines;
+
+    for (const auto &scenario : scenarios) baselines[scenario.topologyFile];
+
+    ThreadPool pool(threads);
+
+    for (auto &entry : baselines) {
+
+        const std::string &topologyFile = entry.first;
+        Baseline *baseline = &entry.second;
+
+        pool.submit([&topologyFile, baseline]() {
+            initTopology(topologyFile, baseline->links, baseline->nodes, baseline->routers);
+            doBellmanFordAlg(baseline->routers, baseline->nodes, baseline->links);
+        });
+
+    }
+
+    pool.wait();
+
+    double baselineSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    for (const auto &scenario : scenarios) {
+
+        const Baseline *baseline = &baselines.at(scenario.topologyFile);
+        const Scenario *task = &scenario;
+
+        pool.submit([baseline, task]() { runScenario(*baseline, *task); });
+
+    }
+
+    pool.wait();
+
+    std::cerr << "batch: " << scenarios.size() << " scenarios over " << baselines.size() << " topologies on "
+              << pool.size() << " threads; baselines converged in " << baselineSeconds << " s, all scenarios done after "
+              << std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count() << " s" << std::endl;
+
+}
+
+/**
+ * @struct DenseTables
+ * @brief The routing tables with routers and destinations numbered 0 to n - 1 in ID order.
+ */
+struct DenseTables {
+    std::vector<int> ids;                           ///< The router ID of every index.
+    std::vector<std::vector<int>> neighbours;       ///< The sorted neighbour indices of every router.
+    std::vector<std::vector<int>> nextHops;         ///< nextHops[r][d]: next hop index, r for d == r, or -1 if unreachable.
+    std::vector<std::vector<int>> costs;            ///< costs[r][d]: cost, or -1 if unreachable.
+};
+
+/**
+ * Converts the routing tables of the routers to dense form.
+ *
+ * @param nodes A constant reference to a set of all node IDs in the network.
+ * @param links A constant reference to a vector of Link objects representing the topology.
+ * @param routers A constant reference to a vector of Router objects with their routing tables.
+ * @return The dense tables.
+ */
+DenseTables
+buildDenseTables (const std::set<int> &nodes, const std::vector<Link> &links, const std::vector<Router> &routers) {
+
+    DenseTables dense;
+    std::map<int, int> index;
+
+    for (const int &id : nodes) {
+        index[id] = dense.ids.size();
+        dense.ids.push_back(id);
+    }
+
+    std::size_t n = dense.ids.size();
+
+    dense.neighbours.resize(n);
+    dense.nextHops.assign(n, std::vector<int>(n, -1));
+    dense.costs.assign(n, std::vector<int>(n, -1));
+
+    for (const auto &link : links) {
+        dense.neighbours[index[link.node1]].push_back(index[link.node2]);
+        dense.neighbours[index[link.node2]].push_back(index[link.node1]);
+    }
+
+    for (auto &list : dense.neighbours) {
+        std::sort(list.begin(), list.end());
+        list.erase(std::unique(list.begin(), list.end()), list.end());
+    }
+
+    for (const auto &router : routers) {
+
+        int r = index[router.getID()];
+
+        for (const auto &entry : router.getRoutingTable()) {
+
+            auto destination = index.find(entry.first);
+            auto hop = index.find(entry.second.first);
+
+            if (destination == index.end() || hop == index.end() || entry.second.second >= 9999) continue;
+
+            dense.nextHops[r][destination->second] = hop->second;
+            dense.costs[r][destination->second] = entry.second.second;
+
+        }
+
+    }
+
+    return dense;
+
+}
+
+/**
+ * Packs the routing tables into a PackedNextHopTable, checks every lookup against the tables, and reports the
+ * size next to that of the routers' maps and of plain int arrays.
+ *
+ * @param epoch The epoch whose tables are packed.
+ * @param nodes A constant reference to a set of all node IDs in the network.
+ * @param links A constant reference to a vector of Link objects representing the topology.
+ * @param routers A constant reference to a vector of Router objects with their routing tables.
+ */
+void
+reportPackedTables (int epoch, const std::set<int> &nodes, const std::vector<Link> &links, const std::vector<Router> &routers) {
+
+    typedef std::map<int, std::pair<int, int>> Table;
+
+    DenseTables dense = buildDenseTables(nodes, links, routers);
+    PackedNextHopTable packed(dense.neighbours, dense.nextHops, dense.costs);
+    std::size_t n = dense.ids.size(), entries = 0, mismatches = 0;
+
+    for (const auto &router : routers) entries += router.getRoutingTable().size();
+
+    for (std::size_t r = 0; r < n; ++r) {
+        for (std::size_t d = 0; d < n; ++d) {
+            if (packed.nextHop(r, d) != dense.nextHops[r][d] || packed.cost(r, d) != dense.costs[r][d]) ++mismatches;
+        }
+    }
+
+    double packedBytes = packed.memoryBytes();
+    double mapBytes = entries * MemoryFootprint::treeNodeBytes<Table::value_type>();
+    double arrayBytes = static_cast<double>(n) * n * 2 * sizeof(int);
+
+    std::cerr << "packed: epoch " << epoch << ": " << n * n << " entries in " << packed.memoryBytes() << " bytes ("
+              << packed.averageHopBits() << " next hop bits and " << packed.averageCostBits() << " cost bits per entry); "
+              << (packedBytes > 0 ? mapBytes / packedBytes : 0) << "x smaller than the maps (" << static_cast<long long>(mapBytes) << " bytes), "
+              << (packedBytes > 0 ? arrayBytes / packedBytes : 0) << "x smaller than int arrays (" << static_cast<long long>(arrayBytes) << " bytes); "
+              << mismatches << " lookups differ" << std::endl;
+
+}
+
+/**
+ * Compresses the next hops into an IntervalNextHopTable, reports its size, and forwards the messages on it
+ * instead of on the routers' tables, writing the same lines as sendMessages.
+ *
+ * The destinations follow a reverse Cuthill-McKee order, or ID order where that gives fewer runs. The cost of
+ * a message is still the source's table entry; only the hops are looked up in the compressed table.
+ *
+ * @param epoch The epoch whose tables are compressed.
+ * @param outputFile The path to the file where the message routes will be written.
+ * @param nodes A constant reference to a set of all node IDs in the network.
+ * @param links A constant reference to a vector of Link objects representing the topology.
+ * @param routers A constant reference to a vector of Router objects with their routing tables.
+ * @param messages A constant reference to a vector of Message structs representing all messages to be sent.
+ */
+void
+sendIntervalMessages (int epoch, const std::string outputFile, const std::set<int> &nodes, const std::vector<Link> &links,
+                      const std::vector<Router> &routers, const std::vector<Message> &messages) {
+
+    DenseTables dense = buildDenseTables(nodes, links, routers);
+    std::size_t n = dense.ids.size(), mismatches = 0;
+    std::vector<int> identity(n);
+
+    for (std::size_t i = 0; i < n; ++i) identity[i] = i;
+
+    IntervalNextHopTable table(dense.nextHops, reverseCuthillMcKee(dense.neighbours));
+    IntervalNextHopTable unordered(dense.nextHops, identity);
+    std::size_t orderedRuns = table.runs();
+
+    if (unordered.runs() < orderedRuns) std::swap(table, unordered);
+
+    for (std::size_t r = 0; r < n; ++r) {
+        for (std::size_t d = 0; d < n; ++d) {
+            if (table.nextHop(r, d) != dense.nextHops[r][d]) ++mismatches;
+        }
+    }
+
+    double denseBytes = static_cast<double>(n) * n * sizeof(int);
+
+    std::cerr << "interval: epoch " << epoch << ": " << n * n << " entries in " << table.runs() << " runs ("
+              << (n > 0 ? static_cast<double>(table.runs()) / n : 0) << " per router), " << table.memoryBytes() << " bytes, "
+              << (table.memoryBytes() > 0 ? denseBytes / table.memoryBytes() : 0) << "x smaller than a next hop array ("
+              << static_cast<long long>(denseBytes) << " bytes); " << orderedRuns << " runs in reverse Cuthill-McKee order, "
+              << (orderedRuns == table.runs() ? unordered.runs() : table.runs()) << " in ID order; "
+              << mismatches << " lookups differ" << std::endl;
+
+    std::ofstream outFile(outputFile, std::ios::app);
+
+    if (!outFile.is_open()) {
+        std::cerr << "Cannot open output file: " << outputFile << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    auto indexOf = [&dense](int ID) {
+        auto it = std::lower_bound(dense.ids.begin(), dense.ids.end(), ID);
+        if (it == dense.ids.end() || *it != ID) throw std::runtime_error("Router with the specified ID not found.");
+        return static_cast<int>(it - dense.ids.begin());
+    };
+
+    for (const auto &message : messages) {
+
+        int current = indexOf(message.sourceID), destination = indexOf(message.destinationID);
+        int pathCost = dense.costs[current][destination];
+        std::string hops;
+
+        while (pathCost >= 0 && current != destination) {
+            hops += std::to_string(dense.ids[current]) + " ";
+            current = table.nextHop(current, destination);
+        }
+
+        if (pathCost < 0) {
+
+            outFile << "from " << message.sourceID << " to " << message.destinationID
+                    << " cost infinite hops unreachable message " << message.message << "\n";
+
+        } else {
+
+            outFile << "from " << message.sourceID << " to " << message.destinationID << " cost " << pathCost
+                    << " hops " << hops << "message " << message.message << "\n";
+
+        }
+
+        outFile << "\n";
+
+    }
+
+    outFile.close();
+
+}
+
+/**
+ * Splits the next hops into blocks shared through a DedupNextHopTable, checks every lookup against the tables,
+ * and reports how many blocks are distinct. The destinations follow a reverse Cuthill-McKee order, or ID order
+ * where that leaves fewer distinct blocks.
+ *
+ * @param epoch The epoch whose tables are split.
+ * @param nodes A constant reference to a set of all node IDs in the network.
+ * @param links A constant reference to a vector of Link objects representing the topology.
+ * @param routers A constant reference to a vector of Router objects with their routing tables.
+ * @param blockSize The destinations per block.
+ */
+void
+reportDedupTables (int epoch, const std::set<int> &nodes, const std::vector<Link> &links, const std::vector<Router> &routers,
+                   std::size_t blockSize) {
+
+    DenseTables dense = buildDenseTables(nodes, links, routers);
+    std::size_t n = dense.ids.size(), mismatches = 0;
+    std::vector<int> identity(n);
+
+    for (std::size_t i = 0; i < n; ++i) identity[i] = i;
+
+    DedupNextHopTable table(dense.nextHops, reverseCuthillMcKee(dense.neighbours), blockSize);
+    DedupNextHopTable unordered(dense.nextHops, identity, blockSize);
+    std::size_t orderedUnique = table.uniqueBlocks();
+
+    if (unordered.uniqueBlocks() < orderedUnique) std::swap(table, unordered);
+
+    for (std::size_t r = 0; r < n; ++r) {
+        for (std::size_t d = 0; d < n; ++d) {
+            if (table.nextHop(r, d) != dense.nextHops[r][d]) ++mismatches;
+        }
+    }
+
+    double denseBytes = static_cast<double>(n) * n * sizeof(int);
+
+    std::cerr << "dedup: epoch " << epoch << ": " << table.blockCount() << " blocks of " << blockSize << " next hops, "
+              << table.uniqueBlocks() << " distinct (" << (table.uniqueBlocks() > 0 ? static_cast<double>(table.blockCount()) / table.uniqueBlocks() : 0)
+              << "x deduplication), " << table.memoryBytes() << " bytes, "
+              << (table.memoryBytes() > 0 ? denseBytes / table.memoryBytes() : 0) << "x smaller than a next hop array ("
+              << static_cast<long long>(denseBytes) << " bytes); " << orderedUnique << " distinct in reverse Cuthill-McKee order, "
+              << (orderedUnique == table.uniqueBlocks() ? unordered.uniqueBlocks() : table.uniqueBlocks()) << " in ID order; "
+              << mismatches << " lookups differ" << std::endl;
+
+}
+
+/**
+ * Reports the bytes held by the simulator's data structures, measured on the live structures, next to the
+ * resident set size of the process. The scratch line is the set of linked routers doBellmanFordAlg builds per run.
+ *
+ * @param nodes A constant reference to a set of all node IDs in the network.
+ * @param links A constant reference to a vector of Link objects representing the topology.
+ * @param routers A constant reference to a vector of Router objects with their routing tables.
+ * @param messages A constant reference to the messages routed every epoch.
+ */
+void
+reportMemory (const std::set<int> &nodes, const std::vector<Link> &links, const std::vector<Router> &routers,
+              const std::vector<Message> &messages) {
+
+    typedef std::map<int, std::pair<int, int>> Table;
+
+    MemoryFootprint footprint(nodes.size(), links.size());
+    std::size_t entries = 0, messageBytes = MemoryFootprint::vectorBytes(messages);
+    std::set<int> linked;
+
+    for (const auto &router : routers) entries += router.getRoutingTable().size();
+
+    for (const auto &message : messages) messageBytes += MemoryFootprint::stringBytes(message.message);
+
+    for (const auto &link : links) {
+        linked.insert(link.node1);
+        linked.insert(link.node2);
+    }
+
+    footprint.add("node IDs", nodes.size() * MemoryFootprint::treeNodeBytes<int>(), nodes.size(), "node");
+    footprint.add("link store", MemoryFootprint::vectorBytes(links), links.size(), "link");
+    footprint.add("routers", MemoryFootprint::vectorBytes(routers), routers.size(), "router");
+    footprint.add("router tables", entries * MemoryFootprint::treeNodeBytes<Table::value_type>(), entries, "entry");
+    footprint.add("messages", messageBytes, messages.size(), "message");
+    footprint.add("scratch", linked.size() * MemoryFootprint::treeNodeBytes<int>(), linked.size(), "node");
+
+    footprint.write(std::cerr, "memory: ");
+
+    std::size_t resident = MemoryFootprint::residentBytes();
+
+    if (resident > 0) std::cerr << "memory: process resident set: " << resident << " bytes (" << resident / 1048576.0 << " MiB)" << std::endl;
+
+}
+
+/**
+ * Predicts the bytes of the data structures from node and link counts alone, with the model reportMemory measures
+ * by: every router holds a table entry for every node. Messages are not included.
+ *
+ * @param nodes The number of routers.
+ * @param links The number of links.
+ */
+void
+estimateMemory (double nodes, double links) {
+
+    typedef std::map<int, std::pair<int, int>> Table;
+
+    MemoryFootprint footprint(nodes, links);
+
+    footprint.add("node IDs", nodes * MemoryFootprint::treeNodeBytes<int>(), nodes, "node");
+    footprint.add("link store", MemoryFootprint::grownVectorBytes(links, sizeof(Link)), links, "link");
+    footprint.add("routers", MemoryFootprint::grownVectorBytes(nodes, sizeof(Router)), nodes, "router");
+    footprint.add("router tables", nodes * nodes * MemoryFootprint::treeNodeBytes<Table::value_type>(), nodes * nodes, "entry");
+    footprint.add("scratch", nodes * MemoryFootprint::treeNodeBytes<int>(), nodes, "node");
+
+    footprint.write(std::cout, "estimate: ");
+
+}
+
+/**
+ * Classifies a change for the change-path latency statistics; must be called before the change is applied.
+ *
+ * @param change The change.
+ * @param links A constant reference to the links in use.
+ * @param failed A constant reference to the down routers and their links.
+ * @return Remove for link removals and routers going down, Add for new links and routers coming up, CostChange otherwise.
+ */
+ChangeLatencyStats::ChangeType
+classifyChange (const Change &change, const std::vector<Link> &links, const FailedRouters &failed) {
+
+    if (change.kind == RouterDown || (change.kind == LinkChange && change.pathCost == -999)) return ChangeLatencyStats::Remove;
+
+    if (change.kind == RouterUp) return ChangeLatencyStats::Add;
+
+    auto sameLink = [&change](const Link &link) {
+        return (link.node1 == change.node1 && link.node2 == change.node2) || (link.node1 == change.node2 && link.node2 == change.node1);
+    };
+
+    bool exists = std::any_of(links.begin(), links.end(), sameLink) || std::any_of(failed.links.begin(), failed.links.end(), sameLink);
+
+    return exists ? ChangeLatencyStats::CostChange : ChangeLatencyStats::Add;
+
+}
+
+/**
+ * Resident mode: keeps the converged state and serves commands from an input stream until "quit" or the end of the input.
+ *
+ * A change record, in the syntax of the changes file, is applied, recomputed and published like an epoch of the changes
+ * file, and then acknowledged with "published <epoch>" on standard output. "stats" writes the latency histograms of the
+ * change path to standard output; they are written to standard error at exit as well.
+ *
+ * @param in The stream of commands.
+ * @param outputFile The path to the file the tables and messages of every epoch are appended to.
+ * @param routers A reference to a vector of Router objects with the converged tables.
+ * @param nodes A reference to a set of all node IDs in the network.
+ * @param links A reference to a vector of Link objects representing the topology.
+ * @param failed A reference to the down routers and their links.
+ * @param messages A constant reference to the messages routed every epoch.
+ * @param epoch The last epoch published so far.
+ * @param critical A constant reference to the destinations whose routes are published first.
+ * @param workers The worker processes computing the routing tables, or 0 for in-process.
+ */
+void
+serveResident (std::istream &in, const std::string &outputFile, std::vector<Router> &routers, std::set<int> &nodes,
+               std::vector<Link> &links, FailedRouters &failed, const std::vector<Message> &messages, int epoch,
+               const std::vector<int> &critical, int workers) {
+
+    typedef std::chrono::steady_clock Clock;
+
+    auto nanoseconds = [](Clock::time_point from, Clock::time_point to) {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(to - from).count());
+    };
+
+    ChangeLatencyStats stats;
+    std::string line;
+    double time = 0;
+
+    while (std::getline(in, line)) {
+
+        auto arrival = Clock::now();
+
+        std::istringstream iss(line);
+        std::string command;
+
+        if (!(iss >> command)) continue;
+
+        if (command == "quit") break;
+
+        if (command == "stats") {
+            stats.write(std::cout);
+            continue;
+        }
+
+        Change change;
+
+        if (!parseChangeLine(line, change, time)) {
+            std::cerr << "Invalid command: " << line << std::endl;
+            continue;
+        }
 
-        outMessage = "from " + std::to_string(message.sourceID) + " to " + std::to_string(message.destinationID) +
-                     " cost " + std::to_string(pathCost) + " hops ";
+        if (change.kind != LinkChange && !nodes.count(change.node1)) {
+            std::cerr << "Unknown router: " << line << std::endl;
+            continue;
+        }
 
-        while (currentID != message.destinationID) {
+        ChangeLatencyStats::ChangeType type = classifyChange(change, links, failed);
+        auto parsed = Clock::now();
 
-            outMessage += std::to_string(currentID) + " ";
+        applyChange(change, routers, nodes, links, failed);
+        auto applied = Clock::now();
 
-            currentID = getRouterByID(routers, currentID).getNextHop(message.destinationID);
+        recomputeRoutes(++epoch, routers, nodes, links, critical, workers);
+        auto recomputed = Clock::now();
 
-        }
+        writeFT(outputFile, routers);
+        sendMessages(outputFile, routers, messages);
+        auto published = Clock::now();
 
-        outMessage += "message " + message.message;
+        stats.record(type, ChangeLatencyStats::Parse, nanoseconds(arrival, parsed));
+        stats.record(type, ChangeLatencyStats::Apply, nanoseconds(parsed, applied));
+        stats.record(type, ChangeLatencyStats::Recompute, nanoseconds(applied, recomputed));
+        stats.record(type, ChangeLatencyStats::Publish, nanoseconds(recomputed, published));
+        stats.record(type, ChangeLatencyStats::Total, nanoseconds(arrival, published));
 
-        outFile << outMessage << "\n";
-        outFile << "\n";
+        std::cout << "published " << epoch << std::endl;
 
     }
 
-    outFile.close();
+    stats.write(std::cerr);
 
 }
 
@@ -619,15 +4962,19 @@ sendMessages (const std::string outputFile, std::vector<Router> &routers, const
  * @param messageFile The path to the file containing messages to be routed.
  * @param changesFile The path to the file containing network topology changes.
  * @param outputFile The path to the file where the simulation results will be written.
+ * @param options Optional features selected on the command line.
  */
 void
-dvr (const std::string topologyFile, const std::string messageFile, const std::string changesFile, const std::string outputFile) {
+dvr (const std::string topologyFile, const std::string messageFile, const std::string changesFile, const std::string outputFile,
+     const Options &options) {
 
     std::vector<Link> links;
-    std::vector<Link> changes;
+    std::vector<Change> changes;
     std::vector<Message> messages;
     std::set<int> nodes;
     std::vector<Router> routers;
+    FailedRouters failed;
+    History history;
 
     std::ofstream outFile(outputFile, std::ofstream::out);
     if (!outFile.is_open()) {
@@ -636,62 +4983,567 @@ dvr (const std::string topologyFile, const std::string messageFile, const std::s
     }
     outFile.close();
 
+    if (options.seekEpoch >= 0) {
+
+        seekToEpoch(options.journalFile, options.seekEpoch, routers, nodes, links);
+
+        writeFT(outputFile, routers);
+
+        readMessagesFile(messageFile, messages);
+
+        sendMessages(outputFile, routers, messages);
+
+        return;
+
+    }
+
+    if (options.coroutineShards > 0) {
+
+        runCoroutineSimulation(topologyFile, messageFile, changesFile, outputFile, options.coroutineShards, options.holdDownTicks);
+
+        return;
+
+    }
+
+    std::unique_ptr<ChangeJournal> journal;
+
+    if (!options.journalFile.empty()) journal.reset(new ChangeJournal(options.journalFile, options.snapshotEvery));
+
+    std::map<int, int> regionOf;
+
+    if (!options.regionsFile.empty()) readRegionsFile(options.regionsFile, regionOf);
+
     initTopology(topologyFile, links, nodes, routers);
 
-    doBellmanFordAlg(routers, nodes, links);
+    std::vector<int> critical = options.criticalDestinations;
 
-    writeFT(outputFile, routers);
+    if (options.criticalFromMessages) {
 
-    readMessagesFile(messageFile, messages);
+        std::vector<Message> criticalMessages;
 
-    sendMessages(outputFile, routers, messages);
+        readMessagesFile(messageFile, criticalMessages);
 
-    readChangesFile(changesFile, changes, nodes);
+        for (const auto &message : criticalMessages) critical.push_back(message.destinationID);
 
-    for (const auto &change : changes) {
+    }
 
-        applyChange(change, routers, nodes, links);
+    std::sort(critical.begin(), critical.end());
+    critical.erase(std::unique(critical.begin(), critical.end()), critical.end());
 
-        doBellmanFordAlg(routers, nodes, links);
+    int sweeps = recomputeRoutes(0, routers, nodes, links, critical, options.workers);
+
+    std::vector<Router> previousRouters;
+    long long fibUpdates = 0, fibEntries = 0;
+
+    if (options.fibUpdates) {
+
+        long long updates = countFibUpdates(previousRouters, routers, fibEntries);
+
+        std::cerr << "fib: epoch 0: " << updates << " entries installed" << std::endl;
+
+    }
+
+    if (options.keepHistory) recordEpoch(history, routers);
+
+    if (journal) journal->recordEpoch(0, nodes, links, failed, routers);
+
+    std::vector<Prefix> prefixes;
+    std::vector<AddressedMessage> addressedMessages;
+    std::unique_ptr<ForwardingPlane> plane;
+
+    if (!options.prefixesFile.empty()) {
+
+        readPrefixesFile(options.prefixesFile, prefixes);
+        readAddressedMessagesFile(messageFile, addressedMessages);
+        plane.reset(new ForwardingPlane(prefixes));
+
+    } else {
+
+        readMessagesFile(messageFile, messages);
+
+    }
+
+    if (plane) {
+
+        plane->compile(routers);
 
         writeFT(outputFile, routers);
 
-        sendMessages(outputFile, routers, messages);
+        sendAddressedMessages(outputFile, *plane, addressedMessages);
+
+        if (options.lpmBenchmark > 0) benchmarkLookups(*plane, prefixes, routers.front().getID(), options.lpmBenchmark);
+
+    } else if (options.regionsFile.empty()) {
+
+        writeFT(outputFile, routers);
+
+        if (options.intervalTables) sendIntervalMessages(0, outputFile, nodes, links, routers, messages);
+        else sendMessages(outputFile, routers, messages);
+
+    } else {
+
+        publishHierarchical(outputFile, nodes, links, regionOf, messages, sweeps);
+
+    }
+
+    if (options.memoryReport) reportMemory(nodes, links, routers, messages);
+
+    std::vector<TrafficLine> traffic;
+
+    if (!options.trafficFile.empty()) {
+
+        if (!readTrafficFile(options.trafficFile, traffic)) {
+            std::cerr << "Cannot open traffic file: " << options.trafficFile << std::endl;
+            exit(EXIT_FAILURE);
+        }
+
+        simulatePackets(0, nodes, links, routers, traffic, options.packetSim);
+
+    }
+
+    if (options.packedTables) reportPackedTables(0, nodes, links, routers);
+
+    if (options.dedupBlock > 0) reportDedupTables(0, nodes, links, routers, options.dedupBlock);
+
+    if (!options.pdesThreads.empty()) reportParallelSimulation(0, nodes, links, routers, options.pdesThreads, options.pdesSeed);
+
+    if (options.actorThreads > 0) reportActorRuntime(0, nodes, links, routers, options.actorThreads);
+
+    std::vector<double> times;
+
+    readChangesFile(changesFile, changes, nodes, times);
+
+    std::unique_ptr<FlapDamper<int>> damper;
+    std::vector<Link> actualLinks;
+    int recomputes = 0, recomputesAvoided = 0;
+    long long staleRoutes = 0, routeCount = 0;
+
+    if (options.flapDamping) {
+        damper.reset(new FlapDamper<int>(options.damping));
+        actualLinks = links;
+    }
+
+    int epoch = 0;
+    std::size_t next = 0;
+    const double never = std::numeric_limits<double>::infinity();
+
+    // Every change is an epoch, and so is the release of held-down links before the next change or after the last one
+    while (next < changes.size() || (damper && damper->nextRelease() < never)) {
+
+        double time = (next < changes.size()) ? times[next] : never;
+        bool release = damper && damper->nextRelease() < time;
+
+        ++epoch;
+
+        bool recompute = true;
+
+        if (options.fibUpdates) previousRouters = routers;
+
+        if (release) {
+
+            releaseDampedLinks(*damper, damper->nextRelease(), epoch);
+
+            recompute = selectDampedLinks(*damper, actualLinks, links);
+
+            if (recompute) resetRouters(routers, nodes, links);
+
+        } else {
+
+            const Change &change = changes[next++];
+
+            if (journal) journal->recordChange(epoch, change);
+
+            if (damper) {
+
+                recompute = applyDampedChange(change, time, epoch, *damper, nodes, actualLinks, failed, links) ||
+                            routers.size() != nodes.size();
+
+                if (recompute) resetRouters(routers, nodes, links);
+
+            } else {
+
+                applyChange(change, routers, nodes, links, failed);
+
+            }
+
+        }
+
+        if (recompute) {
+
+            sweeps = recomputeRoutes(epoch, routers, nodes, links, critical, options.workers);
+            ++recomputes;
+
+        } else {
+
+            ++recomputesAvoided;
+
+        }
+
+        if (options.fibUpdates) {
+
+            int restored = options.sticky ? keepPreviousNextHops(routers, previousRouters, links) : 0;
+            long long updates = countFibUpdates(previousRouters, routers, fibEntries);
+
+            fibUpdates += updates;
+
+            std::cerr << "fib: epoch " << epoch << ": " << updates << " of " << fibEntries << " next hops changed";
+            if (options.sticky) std::cerr << ", " << restored << " kept by the sticky tie-break";
+            std::cerr << std::endl;
+
+        }
+
+        if (damper) {
+            staleRoutes += countStaleRoutes(routers, nodes, actualLinks);
+            routeCount += static_cast<long long>(nodes.size()) * nodes.size();
+        }
+
+        if (options.keepHistory) recordEpoch(history, routers);
+
+        if (journal) journal->recordEpoch(epoch, nodes, links, failed, routers);
+
+        if (plane) {
+
+            plane->compile(routers);
+
+            writeFT(outputFile, routers);
+
+            sendAddressedMessages(outputFile, *plane, addressedMessages);
+
+        } else if (options.regionsFile.empty()) {
+
+            writeFT(outputFile, routers);
+
+            if (options.intervalTables) sendIntervalMessages(epoch, outputFile, nodes, links, routers, messages);
+            else sendMessages(outputFile, routers, messages);
+
+        } else {
+
+            publishHierarchical(outputFile, nodes, links, regionOf, messages, sweeps);
+
+        }
+
+        if (!options.trafficFile.empty()) simulatePackets(epoch, nodes, links, routers, traffic, options.packetSim);
+
+        if (options.packedTables) reportPackedTables(epoch, nodes, links, routers);
+
+        if (options.dedupBlock > 0) reportDedupTables(epoch, nodes, links, routers, options.dedupBlock);
+
+        if (!options.pdesThreads.empty()) reportParallelSimulation(epoch, nodes, links, routers, options.pdesThreads, options.pdesSeed);
+
+        if (options.actorThreads > 0) reportActorRuntime(epoch, nodes, links, routers, options.actorThreads);
+
+    }
+
+    if (options.resident) serveResident(std::cin, outputFile, routers, nodes, links, failed, messages, epoch, critical, options.workers);
+
+    if (options.fibUpdates) {
+
+        std::cerr << "fib: " << changes.size() << " changes, " << fibUpdates << " FIB updates" << std::endl;
+
+    }
+
+    if (damper) {
+
+        std::cerr << "damping: " << changes.size() << " changes, " << damper->getFlaps() << " link flaps, "
+                  << damper->getSuppressions() << " suppressions, " << recomputes << " recomputes, " << recomputesAvoided
+                  << " avoided; " << staleRoutes << " of " << routeCount << " routes ("
+                  << (routeCount > 0 ? 100.0 * staleRoutes / routeCount : 0) << "%) differed from undamped routing" << std::endl;
+
+    }
+
+    if (options.keepHistory) {
+
+        reportHistory(history);
+
+        if (options.queryEpoch >= 0) {
+
+            if (static_cast<std::size_t>(options.queryEpoch) >= history.epochCount()) {
+                std::cerr << "Epoch " << options.queryEpoch << " was never recorded." << std::endl;
+                exit(EXIT_FAILURE);
+            }
+
+            writeEpoch(std::cout, history, options.queryEpoch);
+
+        }
 
     }
 
 }
 
+/**
+ * Prints the command line usage of the program.
+ * @param program The name the program was invoked with.
+ */
+void
+printUsage (const char *program) {
+
+    std::cerr << "Usage: " << program << " [options] <topologyFile> <messageFile> <changesFile> [<outputFile>]\n"
+              << "       " << program << " --batch MANIFEST [--batch-threads N]\n"
+              << "       " << program << " --memory-estimate NODES LINKS\n"
+              << "Options:\n"
+              << "  --history          record the routing tables of every epoch and report the history size\n"
+              << "  --query-epoch N    print the recorded routing tables of epoch N (implies --history)\n"
+              << "  --journal FILE     write every change and periodic snapshots to FILE (index in FILE.idx)\n"
+              << "  --snapshot-every K snapshot the routing state every K epochs in the journal (default 16)\n"
+              << "  --seek-epoch N     restore epoch N from the journal given with --journal and output it\n"
+              << "  --regions FILE     hierarchical distance vector with the \"router region\" map in FILE\n"
+              << "  --prefixes FILE    routers announce the IPv4 prefixes in FILE; messages are addressed to IPv4 destinations\n"
+              << "  --lpm-bench N      measure the forwarding lookup rate with N lookups (with --prefixes)\n"
+              << "  --packet-sim FILE  simulate the \"time source destination packets\" traffic in FILE packet by packet every epoch\n"
+              << "  --link-bandwidth B link bandwidth in megabits per second (default 100)\n"
+              << "  --link-delay US    propagation delay in microseconds per unit of link cost (default 100)\n"
+              << "  --queue-limit N    packets a link queues behind the one being transmitted (default 64)\n"
+              << "  --packet-size N    packet size in bytes (default 1500)\n"
+              << "  --pdes T1,T2,...   run the event-driven protocol sequentially and in parallel with each thread count\n"
+              << "  --pdes-seed S      seed of the link delay jitter of --pdes (default 1)\n"
+              << "  --workers N        compute the routing tables in N worker processes on min-cut partitions of the routers\n"
+              << "  --actors N         run the actor runtime on N threads every epoch and compare it with doBellmanFordAlg\n"
+              << "  --coroutines S     route the messages with one coroutine per router on S scheduler shards; writes no tables\n"
+              << "  --hold-down T      ticks a router of --coroutines waits after a change before it advertises (default 1)\n"
+              << "  --flap-damping     hold down flapping links instead of recomputing on every change (not with --journal)\n"
+              << "  --half-life S      half-life of the flap penalty in seconds (default 15; implies --flap-damping)\n"
+              << "  --suppress P       penalty at which a link is held down, 1000 per change (default 2000; implies --flap-damping)\n"
+              << "  --reuse P          penalty below which a held-down link is released (default 750; implies --flap-damping)\n"
+              << "  --critical D1,D2   compute the routes to these destinations first and write them to standard output;\n"
+              << "                     \"messages\" adds the message destinations\n"
+              << "  --fib-updates      report the next hops that changed in every epoch\n"
+              << "  --sticky           keep the previous next hop while it remains optimal (implies --fib-updates; not with --journal)\n"
+              << "  --batch MANIFEST   run the \"topologyFile messageFile changesFile outputFile\" scenarios in MANIFEST concurrently\n"
+              << "  --batch-threads N  threads running the scenarios of --batch (default: hardware threads)\n"
+              << "  --resident         after the changes file, apply changes read from standard input and report latency on \"stats\"\n"
+              << "                     (not with --journal, --regions, --prefixes or --flap-damping)\n"
+              << "  --memory-report    report the bytes of every data structure after the initial convergence\n"
+              << "  --memory-estimate NODES LINKS  predict the bytes of the data structures without running\n"
+              << "  --packed-tables    pack the tables of every epoch into bit-packed neighbour indices and report their size\n"
+              << "  --interval-tables  forward the messages on next hop runs in reverse Cuthill-McKee order and report their size\n"
+              << "                     (not with --regions or --prefixes)\n"
+              << "  --dedup-tables B   share equal blocks of B next hops between routers every epoch and report the savings" << std::endl;
+
+}
+
 /**
  * The entry point of the distance vector routing simulation program.
  *
- * This function parses command-line arguments for the topology, messages, changes files,
+ * This function parses command-line options and arguments for the topology, messages, changes files,
  * and an optional output file. It then initiates the routing simulation.
  *
  * @param argc The number of command-line arguments.
- * @param argv The command-line arguments, including the program name and file paths.
+ * @param argv The command-line arguments, including the program name, options and file paths.
  * @return Returns 0 on successful execution, 1 on incorrect usage.
  */
 int 
 main(int argc, char** argv) {
 
-    if (argc != 4 && argc != 5) {
-        std::cerr << "Usage: " << argv[0] << " <topologyFile> <messageFile> <changesFile> [<outputFile>]" << std::endl;
+    Options options;
+    std::vector<std::string> arguments;
+
+    for (int i = 1; i < argc; ++i) {
+
+        std::string arg = argv[i];
+
+        if (arg == "--history") {
+
+            options.keepHistory = true;
+
+        } else if (arg == "--query-epoch" && i + 1 < argc) {
+
+            options.keepHistory = true;
+            options.queryEpoch = std::atoi(argv[++i]);
+
+        } else if (arg == "--journal" && i + 1 < argc) {
+
+            options.journalFile = argv[++i];
+
+        } else if (arg == "--snapshot-every" && i + 1 < argc) {
+
+            options.snapshotEvery = std::max(1, std::atoi(argv[++i]));
+
+        } else if (arg == "--seek-epoch" && i + 1 < argc) {
+
+            options.seekEpoch = std::atoi(argv[++i]);
+
+        } else if (arg == "--regions" && i + 1 < argc) {
+
+            options.regionsFile = argv[++i];
+
+        } else if (arg == "--prefixes" && i + 1 < argc) {
+
+            options.prefixesFile = argv[++i];
+
+        } else if (arg == "--lpm-bench" && i + 1 < argc) {
+
+            options.lpmBenchmark = std::atoll(argv[++i]);
+
+        } else if (arg == "--packet-sim" && i + 1 < argc) {
+
+            options.trafficFile = argv[++i];
+
+        } else if (arg == "--link-bandwidth" && i + 1 < argc) {
+
+            options.packetSim.bandwidth = std::max(1e-3, std::atof(argv[++i]));
+
+        } else if (arg == "--link-delay" && i + 1 < argc) {
+
+            options.packetSim.delayPerCost = std::max(0.0, std::atof(argv[++i]));
+
+        } else if (arg == "--queue-limit" && i + 1 < argc) {
+
+            options.packetSim.queueLimit = std::max(0, std::atoi(argv[++i]));
+
+        } else if (arg == "--packet-size" && i + 1 < argc) {
+
+            options.packetSim.packetBytes = std::max(1, std::atoi(argv[++i]));
+
+        } else if (arg == "--pdes" && i + 1 < argc) {
+
+            std::istringstream counts(argv[++i]);
+            std::string count;
+
+            while (std::getline(counts, count, ',')) {
+                if (std::atoi(count.c_str()) > 0) options.pdesThreads.push_back(std::atoi(count.c_str()));
+            }
+
+        } else if (arg == "--pdes-seed" && i + 1 < argc) {
+
+            options.pdesSeed = std::strtoull(argv[++i], nullptr, 10);
+
+        } else if (arg == "--workers" && i + 1 < argc) {
+
+            options.workers = std::max(1, std::atoi(argv[++i]));
+
+        } else if (arg == "--actors" && i + 1 < argc) {
+
+            options.actorThreads = std::max(1, std::atoi(argv[++i]));
+
+        } else if (arg == "--coroutines" && i + 1 < argc) {
+
+            options.coroutineShards = std::max(1, std::atoi(argv[++i]));
+
+        } else if (arg == "--hold-down" && i + 1 < argc) {
+
+            options.holdDownTicks = std::max(0, std::atoi(argv[++i]));
+
+        } else if (arg == "--flap-damping") {
+
+            options.flapDamping = true;
+
+        } else if (arg == "--half-life" && i + 1 < argc) {
+
+            options.flapDamping = true;
+            options.damping.halfLife = std::max(1e-3, std::atof(argv[++i]));
+
+        } else if (arg == "--suppress" && i + 1 < argc) {
+
+            options.flapDamping = true;
+            options.damping.suppress = std::atof(argv[++i]);
+
+        } else if (arg == "--reuse" && i + 1 < argc) {
+
+            options.flapDamping = true;
+            options.damping.reuse = std::atof(argv[++i]);
+
+        } else if (arg == "--fib-updates") {
+
+            options.fibUpdates = true;
+
+        } else if (arg == "--sticky") {
+
+            options.sticky = true;
+            options.fibUpdates = true;
+
+        } else if (arg == "--packed-tables") {
+
+            options.packedTables = true;
+
+        } else if (arg == "--interval-tables") {
+
+            options.intervalTables = true;
+
+        } else if (arg == "--dedup-tables" && i + 1 < argc) {
+
+            options.dedupBlock = std::atoi(argv[++i]);
+
+        } else if (arg == "--memory-report") {
+
+            options.memoryReport = true;
+
+        } else if (arg == "--memory-estimate" && i + 2 < argc) {
+
+            options.estimateNodes = std::atof(argv[++i]);
+            options.estimateLinks = std::atof(argv[++i]);
+
+        } else if (arg == "--resident") {
+
+            options.resident = true;
+
+        } else if (arg == "--batch" && i + 1 < argc) {
+
+            options.manifestFile = argv[++i];
+
+        } else if (arg == "--batch-threads" && i + 1 < argc) {
+
+            options.batchThreads = std::atoi(argv[++i]);
+
+        } else if (arg == "--critical" && i + 1 < argc) {
+
+            std::istringstream list(argv[++i]);
+            std::string destination;
+
+            while (std::getline(list, destination, ',')) {
+                if (destination == "messages") options.criticalFromMessages = true;
+                else if (!destination.empty()) options.criticalDestinations.push_back(std::atoi(destination.c_str()));
+            }
+
+        } else if (arg.compare(0, 2, "--") == 0) {
+
+            printUsage(argv[0]);
+            return 1;
+
+        } else {
+
+            arguments.push_back(arg);
+
+        }
+
+    }
+
+    if (options.estimateNodes >= 0 && arguments.empty()) {
+
+        estimateMemory(options.estimateNodes, options.estimateLinks);
+
+        return 0;
+
+    }
+
+    if (!options.manifestFile.empty() && arguments.empty()) {
+
+        runBatch(options.manifestFile, options.batchThreads);
+
+        return 0;
+
+    }
+
+    if ((arguments.size() != 3 && arguments.size() != 4) || (options.seekEpoch >= 0 && options.journalFile.empty()) ||
+        (!options.prefixesFile.empty() && (!options.regionsFile.empty() || options.criticalFromMessages)) ||
+        ((options.flapDamping || options.sticky) && !options.journalFile.empty()) || !options.manifestFile.empty() ||
+        (options.resident && (!options.journalFile.empty() || !options.regionsFile.empty() || !options.prefixesFile.empty() || options.flapDamping)) ||
+        (options.intervalTables && (!options.regionsFile.empty() || !options.prefixesFile.empty()))) {
+        printUsage(argv[0]);
         return 1;
     }
 
-    std::string topologyFile = argv[1];
-    std::string messageFile = argv[2];
-    std::string changesFile = argv[3];
+    std::string topologyFile = arguments[0];
+    std::string messageFile = arguments[1];
+    std::string changesFile = arguments[2];
     std::string outputFile;
 
-    if (argc == 5) {
-        outputFile = argv[4];
+    if (arguments.size() == 4) {
+        outputFile = arguments[3];
     } else {
         outputFile = "output.txt";
     }
 
-    dvr(topologyFile, messageFile, changesFile, outputFile);
+    dvr(topologyFile, messageFile, changesFile, outputFile, options);
 
     return 0;
 
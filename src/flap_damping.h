@@ -0,0 +1,205 @@
+/**
+ * @file flap_damping.h
+ * @brief Penalty-based damping of flapping links.
+ *
+ * Every change of a link adds a fixed penalty, and the penalty decays exponentially with a
+ * configurable half-life. A link whose penalty reaches the suppress threshold is held down: it
+ * is treated as absent, and its further changes do not cause a recomputation. Once its penalty
+ * has decayed to the reuse threshold, the link is released in whatever state it then has.
+ */
+
+#ifndef FLAP_DAMPING_H
+#define FLAP_DAMPING_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <utility>
+#include <vector>
+
+/**
+ * @struct FlapDampingConfig
+ * @brief Damping parameters; penalties are unitless, times in seconds.
+ */
+struct FlapDampingConfig {
+    double halfLife = 15;       ///< Time for a penalty to decay to half.
+    double penalty = 1000;      ///< Penalty added by every change of a link.
+    double suppress = 2000;     ///< Penalty at which a link is held down.
+    double reuse = 750;         ///< Penalty below which a held-down link is released.
+};
+
+/**
+ * @class FlapDamper
+ * @brief Tracks the penalty of every link that changed and decides which links are held down.
+ *
+ * The penalty is capped at 16 times the reuse threshold, so a link is never held down longer than
+ * four half-lives after its last change.
+ *
+ * @tparam Node The node identifier type; links are unordered pairs of nodes.
+ */
+template <typename Node>
+class FlapDamper {
+public:
+
+    typedef std::pair<Node, Node> LinkKey;
+
+    explicit FlapDamper(const FlapDampingConfig &config) : config(config) {}
+
+    /**
+     * Records a change of a link.
+     * @param a One end of the link.
+     * @param b The other end.
+     * @param time The time of the change.
+     * @return True if the link is held down after the change.
+     */
+    bool
+    flap(const Node &a, const Node &b, double time) {
+
+        State &state = links[key(a, b)];
+
+        state.penalty = std::min(decayed(state, time) + config.penalty, config.reuse * 16);
+        state.updated = time;
+        ++flaps;
+
+        if (!state.suppressed && state.penalty >= config.suppress) {
+            state.suppressed = true;
+            ++suppressions;
+        }
+
+        return state.suppressed;
+
+    }
+
+    /**
+     * Releases the held-down links whose penalty has decayed to the reuse threshold.
+     * @param time The current time.
+     * @return The released links.
+     */
+    std::vector<LinkKey>
+    release(double time) {
+
+        std::vector<LinkKey> released;
+
+        for (auto &entry : links) {
+
+            if (entry.second.suppressed && releaseTime(entry.second) <= time) {
+                entry.second.suppressed = false;
+                released.push_back(entry.first);
+            }
+
+        }
+
+        return released;
+
+    }
+
+    /**
+     * @return The earliest time a held-down link's penalty decays to the reuse threshold, or infinity if no link is held down.
+     */
+    double
+    nextRelease() const {
+
+        double next = std::numeric_limits<double>::infinity();
+
+        for (const auto &entry : links) {
+            if (entry.second.suppressed) next = std::min(next, releaseTime(entry.second));
+        }
+
+        return next;
+
+    }
+
+    /**
+     * @param a One end of the link.
+     * @param b The other end.
+     * @return True if the link is held down.
+     */
+    bool
+    isSuppressed(const Node &a, const Node &b) const {
+
+        auto it = links.find(key(a, b));
+
+        return it != links.end() && it->second.suppressed;
+
+    }
+
+    /**
+     * @param a One end of the link.
+     * @param b The other end.
+     * @param time The current time.
+     * @return The link's penalty at the given time.
+     */
+    double
+    getPenalty(const Node &a, const Node &b, double time) const {
+
+        auto it = links.find(key(a, b));
+
+        return it == links.end() ? 0 : decayed(it->second, time);
+
+    }
+
+    /**
+     * @return The number of changes recorded.
+     */
+    uint64_t
+    getFlaps() const {
+
+        return flaps;
+
+    }
+
+    /**
+     * @return The number of times a link was held down.
+     */
+    uint64_t
+    getSuppressions() const {
+
+        return suppressions;
+
+    }
+
+private:
+
+    /**
+     * @struct State
+     * @brief The penalty of a link as of its last change.
+     */
+    struct State {
+        double penalty = 0;
+        double updated = 0;
+        bool suppressed = false;
+    };
+
+    static LinkKey
+    key(const Node &a, const Node &b) {
+
+        return (b < a) ? LinkKey(b, a) : LinkKey(a, b);
+
+    }
+
+    double
+    decayed(const State &state, double time) const {
+
+        return state.penalty * std::exp2(-(time - state.updated) / config.halfLife);
+
+    }
+
+    /**
+     * @return The time the penalty of a link decays to the reuse threshold.
+     */
+    double
+    releaseTime(const State &state) const {
+
+        return state.updated + config.halfLife * std::max(0.0, std::log2(state.penalty / config.reuse));
+
+    }
+
+    FlapDampingConfig config;
+    std::map<LinkKey, State> links;
+    uint64_t flaps = 0;
+    uint64_t suppressions = 0;
+};
+
+#endif
@@ -0,0 +1,378 @@
+/**
+ * @file graph_partition.h
+ * @brief Multilevel min-cut partitioning of a weighted graph into k balanced parts.
+ *
+ * Parts are produced by recursive bisection. Each bisection coarsens the graph by heavy-edge
+ * matching until it is small, splits the coarsest graph by greedy graph growing, and then
+ * projects the split back level by level, refining it with Fiduccia-Mattheyses passes at
+ * every level.
+ */
+
+#ifndef GRAPH_PARTITION_H
+#define GRAPH_PARTITION_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <initializer_list>
+#include <queue>
+#include <utility>
+#include <vector>
+
+/**
+ * @class GraphPartitioner
+ * @brief Splits the vertices of an undirected graph into parts of nearly equal weight with few cut edges.
+ */
+class GraphPartitioner {
+public:
+
+    /**
+     * Adjacency list: vertex -> (neighbor, edge weight). Both directions of every edge must be present.
+     */
+    typedef std::vector<std::vector<std::pair<int, int>>> Adjacency;
+
+    /**
+     * Partitions a graph with unit vertex weights.
+     * @param adjacency The graph.
+     * @param parts The number of parts, at least 1.
+     * @return The part of every vertex, from 0 to parts - 1.
+     */
+    static std::vector<int>
+    partition(const Adjacency &adjacency, int parts) {
+
+        std::vector<int> vertices(adjacency.size());
+        std::vector<int> result(adjacency.size(), 0);
+
+        for (std::size_t v = 0; v < vertices.size(); ++v) vertices[v] = v;
+
+        split(adjacency, vertices, std::max(1, parts), 0, result);
+
+        return result;
+
+    }
+
+    /**
+     * @param adjacency The graph.
+     * @param part The part of every vertex.
+     * @return The total weight of the edges between different parts.
+     */
+    static long long
+    cutWeight(const Adjacency &adjacency, const std::vector<int> &part) {
+
+        long long cut = 0;
+
+        for (std::size_t v = 0; v < adjacency.size(); ++v) {
+            for (const auto &edge : adjacency[v]) {
+                if (part[v] != part[edge.first]) cut += edge.second;
+            }
+        }
+
+        return cut / 2;
+
+    }
+
+private:
+
+    /**
+     * @struct Level
+     * @brief A graph of the multilevel hierarchy with vertex weights.
+     */
+    struct Level {
+        Adjacency adjacency;
+        std::vector<int> weight;
+        std::vector<int> coarse;    ///< Vertex of the next coarser level this vertex was merged into.
+    };
+
+    /**
+     * Recursively bisects the induced subgraph of a vertex set until every part is assigned.
+     */
+    static void
+    split(const Adjacency &adjacency, const std::vector<int> &vertices, int parts, int firstPart, std::vector<int> &result) {
+
+        if (parts == 1 || vertices.size() <= 1) {
+
+            for (int v : vertices) result[v] = firstPart;
+            return;
+
+        }
+
+        // Build the induced subgraph on local vertex numbers
+        std::vector<int> local(adjacency.size(), -1);
+
+        for (std::size_t i = 0; i < vertices.size(); ++i) local[vertices[i]] = i;
+
+        Level level;
+        level.adjacency.resize(vertices.size());
+        level.weight.assign(vertices.size(), 1);
+
+        for (std::size_t i = 0; i < vertices.size(); ++i) {
+            for (const auto &edge : adjacency[vertices[i]]) {
+                if (local[edge.first] >= 0) level.adjacency[i].push_back(std::make_pair(local[edge.first], edge.second));
+            }
+        }
+
+        int leftParts = parts / 2;
+        std::vector<int> side = bisect(level, static_cast<double>(leftParts) / parts);
+        std::vector<int> left, right;
+
+        for (std::size_t i = 0; i < vertices.size(); ++i) (side[i] == 0 ? left : right).push_back(vertices[i]);
+
+        split(adjacency, left, leftParts, firstPart, result);
+        split(adjacency, right, parts - leftParts, firstPart + leftParts, result);
+
+    }
+
+    /**
+     * Bisects a graph so that side 0 holds about the given fraction of the vertex weight.
+     */
+    static std::vector<int>
+    bisect(Level &level, double fraction) {
+
+        std::size_t n = level.adjacency.size();
+
+        if (n <= 64) {
+
+            std::vector<int> side = grow(level, fraction);
+            refine(level, side, fraction);
+            return side;
+
+        }
+
+        Level coarser = coarsen(level);
+
+        // Matching stalled (e.g. a star); split this level directly
+        if (coarser.adjacency.size() * 10 > n * 9) {
+
+            std::vector<int> side = grow(level, fraction);
+            refine(level, side, fraction);
+            return side;
+
+        }
+
+        std::vector<int> coarseSide = bisect(coarser, fraction);
+        std::vector<int> side(n);
+
+        for (std::size_t v = 0; v < n; ++v) side[v] = coarseSide[level.coarse[v]];
+
+        refine(level, side, fraction);
+
+        return side;
+
+    }
+
+    /**
+     * Merges every vertex with its unmatched neighbor over the heaviest edge.
+     */
+    static Level
+    coarsen(Level &level) {
+
+        std::size_t n = level.adjacency.size();
+        std::vector<int> match(n, -1);
+        Level coarser;
+
+        level.coarse.assign(n, -1);
+
+        for (std::size_t v = 0; v < n; ++v) {
+
+            if (match[v] >= 0) continue;
+
+            int best = -1, bestWeight = -1;
+
+            for (const auto &edge : level.adjacency[v]) {
+                if (match[edge.first] < 0 && edge.first != static_cast<int>(v) && edge.second > bestWeight) {
+                    best = edge.first;
+                    bestWeight = edge.second;
+                }
+            }
+
+            match[v] = (best >= 0) ? best : v;
+            if (best >= 0) match[best] = v;
+
+            level.coarse[v] = coarser.weight.size();
+            if (best >= 0) level.coarse[best] = coarser.weight.size();
+
+            coarser.weight.push_back(level.weight[v] + (best >= 0 ? level.weight[best] : 0));
+
+        }
+
+        coarser.adjacency.resize(coarser.weight.size());
+
+        // Sum parallel edges between merged vertices; drop the edges inside a merged pair
+        std::vector<int> slot(coarser.weight.size(), -1);
+
+        for (std::size_t v = 0; v < n; ++v) {
+
+            if (match[v] < static_cast<int>(v)) continue;
+
+            int c = level.coarse[v];
+
+            for (int member : {static_cast<int>(v), match[v]}) {
+
+                for (const auto &edge : level.adjacency[member]) {
+
+                    int target = level.coarse[edge.first];
+
+                    if (target == c) continue;
+
+                    if (slot[target] < 0) {
+                        slot[target] = coarser.adjacency[c].size();
+                        coarser.adjacency[c].push_back(std::make_pair(target, 0));
+                    }
+
+                    coarser.adjacency[c][slot[target]].second += edge.second;
+
+                }
+
+                if (match[v] == static_cast<int>(v)) break;
+
+            }
+
+            for (const auto &edge : coarser.adjacency[c]) slot[edge.first] = -1;
+
+        }
+
+        return coarser;
+
+    }
+
+    /**
+     * Greedy graph growing: starting from a vertex of minimum degree, repeatedly moves the
+     * frontier vertex with the best gain into side 0 until it holds its share of the weight.
+     */
+    static std::vector<int>
+    grow(const Level &level, double fraction) {
+
+        std::size_t n = level.adjacency.size();
+        std::vector<int> side(n, 1);
+        long long total = 0, target, grown = 0;
+
+        for (int w : level.weight) total += w;
+
+        target = static_cast<long long>(total * fraction + 0.5);
+
+        std::vector<long long> gain(n, 0);
+        std::priority_queue<std::pair<long long, int>> frontier;
+
+        for (std::size_t v = 0; v < n; ++v) {
+            for (const auto &edge : level.adjacency[v]) gain[v] -= edge.second;
+        }
+
+        while (grown < target) {
+
+            int v = -1;
+
+            while (!frontier.empty() && v < 0) {
+                if (side[frontier.top().second] == 1 && frontier.top().first == gain[frontier.top().second]) v = frontier.top().second;
+                else frontier.pop();
+            }
+
+            // Start a new region in a component not reached yet
+            if (v < 0) {
+                for (std::size_t u = 0; u < n; ++u) {
+                    if (side[u] == 1 && (v < 0 || level.adjacency[u].size() < level.adjacency[v].size())) v = u;
+                }
+            }
+
+            if (v < 0) break;
+
+            side[v] = 0;
+            grown += level.weight[v];
+
+            for (const auto &edge : level.adjacency[v]) {
+                if (side[edge.first] == 1) {
+                    gain[edge.first] += 2 * edge.second;
+                    frontier.push(std::make_pair(gain[edge.first], edge.first));
+                }
+            }
+
+        }
+
+        return side;
+
+    }
+
+    /**
+     * Fiduccia-Mattheyses refinement: each pass moves every vertex at most once, always the one with
+     * the best gain whose move keeps the balance, and keeps the best prefix of the moves.
+     */
+    static void
+    refine(const Level &level, std::vector<int> &side, double fraction) {
+
+        std::size_t n = level.adjacency.size();
+        long long total = 0, weight0 = 0;
+
+        for (std::size_t v = 0; v < n; ++v) {
+            total += level.weight[v];
+            if (side[v] == 0) weight0 += level.weight[v];
+        }
+
+        long long target = static_cast<long long>(total * fraction + 0.5);
+        long long slack = std::max<long long>(1, total / 50);
+
+        for (int pass = 0; pass < 8; ++pass) {
+
+            std::vector<long long> gain(n, 0);
+            std::vector<bool> locked(n, false);
+            std::priority_queue<std::pair<long long, int>> queue;
+
+            for (std::size_t v = 0; v < n; ++v) {
+                for (const auto &edge : level.adjacency[v]) gain[v] += (side[edge.first] != side[v]) ? edge.second : -edge.second;
+                queue.push(std::make_pair(gain[v], v));
+            }
+
+            std::vector<int> moves;
+            long long cutChange = 0, bestChange = 0;
+            std::size_t bestLength = 0;
+            long long bestImbalance = std::llabs(weight0 - target);
+
+            while (!queue.empty()) {
+
+                int v = queue.top().second;
+                long long g = queue.top().first;
+                queue.pop();
+
+                if (locked[v] || g != gain[v]) continue;
+
+                long long moved = weight0 + (side[v] == 0 ? -level.weight[v] : level.weight[v]);
+
+                if (std::llabs(moved - target) > slack && std::llabs(moved - target) >= std::llabs(weight0 - target)) continue;
+
+                locked[v] = true;
+                side[v] ^= 1;
+                weight0 = moved;
+                cutChange -= g;
+                moves.push_back(v);
+
+                for (const auto &edge : level.adjacency[v]) {
+                    if (locked[edge.first]) continue;
+                    gain[edge.first] += (side[edge.first] == side[v]) ? -2 * edge.second : 2 * edge.second;
+                    queue.push(std::make_pair(gain[edge.first], edge.first));
+                }
+
+                long long imbalance = std::llabs(weight0 - target);
+
+                if ((imbalance <= slack && (cutChange < bestChange || bestImbalance > slack)) ||
+                    (imbalance > slack && imbalance < bestImbalance)) {
+                    bestChange = cutChange;
+                    bestLength = moves.size();
+                    bestImbalance = imbalance;
+                }
+
+            }
+
+            // Undo the moves after the best prefix
+            for (std::size_t i = moves.size(); i > bestLength; --i) {
+                int v = moves[i - 1];
+                side[v] ^= 1;
+                weight0 += (side[v] == 0) ? level.weight[v] : -level.weight[v];
+            }
+
+            if (bestLength == 0) break;
+
+        }
+
+    }
+
+};
+
+#endif
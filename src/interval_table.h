@@ -0,0 +1,182 @@
+/**
+ * @file interval_table.h
+ * @brief Forwarding tables compressed into runs of destinations that share a next hop.
+ *
+ * Destinations are renumbered by a reverse Cuthill-McKee ordering of the topology, which gives
+ * nearby nodes nearby positions. A router tends to reach a whole neighbourhood through the same
+ * neighbour, so its table, read in that order, falls into a few runs of equal next hops. Each run
+ * is kept as its first position and next hop; a lookup is a binary search over the router's runs.
+ */
+
+#ifndef INTERVAL_TABLE_H
+#define INTERVAL_TABLE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <queue>
+#include <vector>
+
+/**
+ * Orders the nodes of a graph by reverse Cuthill-McKee: a breadth-first search from a node of least
+ * degree in every component, visiting neighbours by increasing degree, reversed.
+ *
+ * @param neighbours The neighbours of every node, numbered 0 to n - 1.
+ * @return The nodes in their new order.
+ */
+inline std::vector<int>
+reverseCuthillMcKee(const std::vector<std::vector<int>> &neighbours) {
+
+    std::size_t n = neighbours.size();
+    std::vector<int> byDegree(n), order;
+    std::vector<bool> visited(n, false);
+
+    for (std::size_t node = 0; node < n; ++node) byDegree[node] = node;
+
+    auto lessDegree = [&neighbours](int a, int b) {
+        return neighbours[a].size() != neighbours[b].size() ? neighbours[a].size() < neighbours[b].size() : a < b;
+    };
+
+    std::sort(byDegree.begin(), byDegree.end(), lessDegree);
+    order.reserve(n);
+
+    for (int start : byDegree) {
+
+        if (visited[start]) continue;
+
+        std::queue<int> frontier;
+
+        frontier.push(start);
+        visited[start] = true;
+
+        while (!frontier.empty()) {
+
+            int node = frontier.front();
+            std::vector<int> next;
+
+            frontier.pop();
+            order.push_back(node);
+
+            for (int neighbour : neighbours[node]) {
+                if (!visited[neighbour]) {
+                    visited[neighbour] = true;
+                    next.push_back(neighbour);
+                }
+            }
+
+            std::sort(next.begin(), next.end(), lessDegree);
+
+            for (int neighbour : next) frontier.push(neighbour);
+
+        }
+
+    }
+
+    std::reverse(order.begin(), order.end());
+
+    return order;
+
+}
+
+/**
+ * @class IntervalNextHopTable
+ * @brief Next hops of n routers toward n destinations, numbered 0 to n - 1, as sorted runs per router.
+ */
+class IntervalNextHopTable {
+public:
+
+    /**
+     * @param nextHops nextHops[r][d]: the next hop of router r toward d, r itself for d == r, or -1 if unreachable.
+     * @param order The destinations in the order the runs follow, e.g. from reverseCuthillMcKee.
+     */
+    IntervalNextHopTable(const std::vector<std::vector<int>> &nextHops, const std::vector<int> &order)
+        : position(order.size()), offsets(1, 0) {
+
+        for (std::size_t p = 0; p < order.size(); ++p) position[order[p]] = p;
+
+        for (std::size_t r = 0; r < nextHops.size(); ++r) {
+
+            std::size_t first = starts.size();
+
+            for (std::size_t p = 0; p < order.size(); ++p) {
+
+                int destination = order[p];
+                int hop = nextHops[r][destination];
+
+                // The router's own entry is answered without the runs, so it joins whichever run surrounds it
+                if (destination == static_cast<int>(r)) continue;
+
+                if (starts.size() == first) {
+                    starts.push_back(0);
+                    hops.push_back(hop);
+                } else if (hops.back() != hop) {
+                    starts.push_back(p);
+                    hops.push_back(hop);
+                }
+
+            }
+
+            offsets.push_back(starts.size());
+
+        }
+
+        starts.shrink_to_fit();
+        hops.shrink_to_fit();
+
+    }
+
+    /**
+     * @return The next hop of a router toward a destination, the router itself for its own entry, or -1 if unreachable.
+     */
+    int
+    nextHop(int router, int destination) const {
+
+        if (router == destination) return router;
+
+        auto first = starts.begin() + offsets[router], last = starts.begin() + offsets[router + 1];
+        auto run = std::upper_bound(first, last, static_cast<uint32_t>(position[destination]));
+
+        return (run == first) ? -1 : hops[run - starts.begin() - 1];
+
+    }
+
+    /**
+     * @return The number of routers.
+     */
+    std::size_t
+    size() const {
+
+        return offsets.size() - 1;
+
+    }
+
+    /**
+     * @return The number of runs of all routers.
+     */
+    std::size_t
+    runs() const {
+
+        return starts.size();
+
+    }
+
+    /**
+     * @return The bytes of the runs, the per-router offsets and the destination positions.
+     */
+    std::size_t
+    memoryBytes() const {
+
+        return (starts.capacity() + offsets.capacity() + position.capacity()) * sizeof(uint32_t) +
+               hops.capacity() * sizeof(int);
+
+    }
+
+private:
+
+    std::vector<uint32_t> position;     ///< The place of every destination in the order.
+    std::vector<uint32_t> offsets;      ///< The first run of every router; the last entry ends the final router's runs.
+    std::vector<uint32_t> starts;       ///< The first position of every run.
+    std::vector<int> hops;              ///< The next hop of every run.
+};
+
+#endif
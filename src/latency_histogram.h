@@ -0,0 +1,242 @@
+/**
+ * @file latency_histogram.h
+ * @brief HDR-style latency histograms and the change-path latency statistics built on them.
+ *
+ * A histogram counts values in log-linear buckets: every power of two is split into a fixed
+ * number of equal sub-buckets, so any recorded value is known to within 1/128 of itself over the
+ * whole 64-bit range, while a histogram stays a flat array of a few thousand counters.
+ */
+
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+/**
+ * @class LatencyHistogram
+ * @brief Counts values, e.g. nanoseconds, and answers percentile queries with bounded relative error.
+ */
+class LatencyHistogram {
+public:
+
+    LatencyHistogram() : counts(bucketIndex(UINT64_MAX) + 1, 0) {}
+
+    /**
+     * @param value The value to count.
+     */
+    void
+    record(uint64_t value) {
+
+        ++counts[bucketIndex(value)];
+        ++total;
+        sum += value;
+        maximum = std::max(maximum, value);
+
+    }
+
+    /**
+     * Adds the values counted by another histogram.
+     * @param other The histogram to add.
+     */
+    void
+    merge(const LatencyHistogram &other) {
+
+        for (std::size_t i = 0; i < counts.size(); ++i) counts[i] += other.counts[i];
+
+        total += other.total;
+        sum += other.sum;
+        maximum = std::max(maximum, other.maximum);
+
+    }
+
+    /**
+     * @param quantile The quantile, from 0 to 1, e.g. 0.999.
+     * @return The highest value equivalent to the value at the quantile, never more than the largest value; 0 if empty.
+     */
+    uint64_t
+    percentile(double quantile) const {
+
+        if (total == 0) return 0;
+
+        uint64_t rank = static_cast<uint64_t>(std::ceil(quantile * total));
+        uint64_t seen = 0;
+
+        rank = std::max<uint64_t>(1, std::min(rank, total));
+
+        for (std::size_t i = 0; i < counts.size(); ++i) {
+
+            seen += counts[i];
+
+            if (seen >= rank) return std::min(highestEquivalent(i), maximum);
+
+        }
+
+        return maximum;
+
+    }
+
+    /**
+     * @return The number of values counted.
+     */
+    uint64_t
+    count() const {
+
+        return total;
+
+    }
+
+    /**
+     * @return The mean of the values counted, 0 if empty.
+     */
+    double
+    mean() const {
+
+        return total == 0 ? 0 : static_cast<double>(sum) / total;
+
+    }
+
+    /**
+     * @return The largest value counted, 0 if empty.
+     */
+    uint64_t
+    max() const {
+
+        return maximum;
+
+    }
+
+    /**
+     * Writes the count, mean, p50, p99, p999 and maximum, with values scaled down by a divisor.
+     * @param out The stream to write to.
+     * @param divisor The unit of the printed values, e.g. 1000 to print microseconds of nanosecond values.
+     */
+    void
+    write(std::ostream &out, double divisor) const {
+
+        out << "count " << total << ", mean " << mean() / divisor << ", p50 " << percentile(0.5) / divisor
+            << ", p99 " << percentile(0.99) / divisor << ", p999 " << percentile(0.999) / divisor
+            << ", max " << maximum / divisor;
+
+    }
+
+private:
+
+    static const int SubBucketBits = 8;                         ///< 2^8 sub-buckets below 256, 128 per power of two above.
+    static const uint64_t HalfSubBuckets = 1ULL << (SubBucketBits - 1);
+
+    /**
+     * Values below 2^SubBucketBits have a bucket each. Above, a value with its highest bit at position m
+     * keeps its top SubBucketBits bits; the dropped low bits (shift) select the run of buckets.
+     */
+    static std::size_t
+    bucketIndex(uint64_t value) {
+
+        if (value < (1ULL << SubBucketBits)) return value;
+
+        int msb = 63;
+
+        while (!(value >> msb)) --msb;
+
+        int shift = msb - SubBucketBits + 1;
+
+        return shift * HalfSubBuckets + (value >> shift);
+
+    }
+
+    /**
+     * @return The largest value that falls into a bucket.
+     */
+    static uint64_t
+    highestEquivalent(std::size_t index) {
+
+        if (index < (1ULL << SubBucketBits)) return index;
+
+        uint64_t shift = index / HalfSubBuckets - 1;
+        uint64_t sub = index - shift * HalfSubBuckets;
+
+        return ((sub + 1) << shift) - 1;
+
+    }
+
+    std::vector<uint64_t> counts;
+    uint64_t total = 0;
+    uint64_t sum = 0;
+    uint64_t maximum = 0;
+};
+
+/**
+ * @class ChangeLatencyStats
+ * @brief Latency of the change path from the arrival of a change to its published routes, by phase and change type.
+ */
+class ChangeLatencyStats {
+public:
+
+    /**
+     * The phases of the change path; Total runs from the arrival of the change to the end of Publish.
+     */
+    enum Phase { Parse, Apply, Recompute, Publish, Total, PhaseCount };
+
+    /**
+     * The kinds of change; a router going down counts as a removal and a router coming up as an addition.
+     */
+    enum ChangeType { Add, Remove, CostChange, ChangeTypeCount };
+
+    /**
+     * @param type The kind of change.
+     * @param phase The phase.
+     * @param nanoseconds The time the phase took.
+     */
+    void
+    record(ChangeType type, Phase phase, uint64_t nanoseconds) {
+
+        histograms[type][phase].record(nanoseconds);
+
+    }
+
+    /**
+     * Writes one line per phase for all changes and per change type that occurred, in microseconds.
+     * @param out The stream to write to.
+     */
+    void
+    write(std::ostream &out) const {
+
+        static const char *phaseNames[PhaseCount] = {"parse", "apply", "recompute", "publish", "total"};
+        static const char *typeNames[ChangeTypeCount] = {"add", "remove", "cost"};
+
+        for (int phase = 0; phase < PhaseCount; ++phase) {
+
+            LatencyHistogram all;
+
+            for (int type = 0; type < ChangeTypeCount; ++type) all.merge(histograms[type][phase]);
+
+            out << "latency: " << phaseNames[phase] << " all: ";
+            all.write(out, 1000);
+            out << " us\n";
+
+            for (int type = 0; type < ChangeTypeCount; ++type) {
+
+                if (histograms[type][phase].count() == 0) continue;
+
+                out << "latency: " << phaseNames[phase] << " " << typeNames[type] << ": ";
+                histograms[type][phase].write(out, 1000);
+                out << " us\n";
+
+            }
+
+        }
+
+        out.flush();
+
+    }
+
+private:
+
+    LatencyHistogram histograms[ChangeTypeCount][PhaseCount];
+};
+
+#endif
@@ -0,0 +1,155 @@
+/**
+ * @file lpm.h
+ * @brief DIR-24-8 longest-prefix-match table for IPv4 addresses.
+ *
+ * The table resolves an address with at most two memory accesses: a 2^24-entry first level
+ * indexed by the top 24 bits, and 256-entry second-level groups for the /24 blocks that hold
+ * prefixes longer than 24 bits.
+ */
+
+#ifndef LPM_H
+#define LPM_H
+
+#include <algorithm>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/**
+ * Parses a dotted-quad IPv4 address.
+ * @param text The address, e.g. "10.1.2.3".
+ * @param address Receives the address in host byte order.
+ * @return True if the text is a valid address.
+ */
+inline bool
+parseIPv4 (const std::string &text, uint32_t &address) {
+
+    std::istringstream iss(text);
+    unsigned parts[4];
+    char dots[3];
+
+    if (!(iss >> parts[0] >> dots[0] >> parts[1] >> dots[1] >> parts[2] >> dots[2] >> parts[3])) return false;
+
+    // Nothing may follow the fourth octet
+    if (iss.peek() != std::char_traits<char>::eof()) return false;
+
+    address = 0;
+
+    for (int i = 0; i < 4; ++i) {
+
+        if (parts[i] > 255 || (i < 3 && dots[i] != '.')) return false;
+
+        address = (address << 8) | parts[i];
+
+    }
+
+    return true;
+
+}
+
+/**
+ * @class Dir24_8
+ * @brief Longest-prefix-match table mapping IPv4 addresses to small integer values.
+ *
+ * First-level entries hold either a value or, with the top bit set, the index of a
+ * second-level group. Value 0 is reserved for "no route", so values are stored plus one.
+ */
+class Dir24_8 {
+public:
+
+    /**
+     * @struct Route
+     * @brief A prefix and the value it resolves to.
+     */
+    struct Route {
+        uint32_t prefix;        ///< The prefix address; host bits are ignored.
+        int length;             ///< The prefix length, 0 to 32.
+        uint32_t value;         ///< The value returned for addresses matching the prefix.
+    };
+
+    /**
+     * Builds the table from a set of routes, replacing any previous content.
+     * Routes are installed shortest prefix first so that longer prefixes override them.
+     * @param routes The routes to install.
+     */
+    void
+    build(std::vector<Route> routes) {
+
+        tbl24.assign(size_t(1) << 24, 0);
+        tbl8.clear();
+
+        std::stable_sort(routes.begin(), routes.end(), [](const Route &a, const Route &b) { return a.length < b.length; });
+
+        for (const auto &route : routes) {
+
+            uint32_t mask = route.length == 0 ? 0 : ~uint32_t(0) << (32 - route.length);
+            uint32_t prefix = route.prefix & mask;
+            uint32_t entry = route.value + 1;
+
+            if (route.length <= 24) {
+
+                uint32_t first = prefix >> 8;
+                uint32_t count = uint32_t(1) << (24 - route.length);
+
+                // Routes are sorted by length, so no block has a second-level group yet
+                std::fill(tbl24.begin() + first, tbl24.begin() + first + count, entry);
+
+            } else {
+
+                uint32_t &slot = tbl24[prefix >> 8];
+
+                if (!(slot & Extended)) {
+
+                    uint32_t group = static_cast<uint32_t>(tbl8.size() / 256);
+
+                    tbl8.insert(tbl8.end(), 256, slot);
+                    slot = group | Extended;
+
+                }
+
+                uint32_t base = (slot & ~Extended) * 256 + (prefix & 0xff);
+                uint32_t count = uint32_t(1) << (32 - route.length);
+
+                std::fill(tbl8.begin() + base, tbl8.begin() + base + count, entry);
+
+            }
+
+        }
+
+    }
+
+    /**
+     * Looks up the longest prefix matching an address.
+     * @param address The address in host byte order.
+     * @return The value of the longest matching route, or -1 if no route matches.
+     */
+    int
+    lookup(uint32_t address) const {
+
+        uint32_t entry = tbl24[address >> 8];
+
+        if (entry & Extended) entry = tbl8[(entry & ~Extended) * 256 + (address & 0xff)];
+
+        return static_cast<int>(entry) - 1;
+
+    }
+
+    /**
+     * @return The bytes used by both table levels.
+     */
+    size_t
+    memoryBytes() const {
+
+        return (tbl24.size() + tbl8.size()) * sizeof(uint32_t);
+
+    }
+
+private:
+    static const uint32_t Extended = 0x80000000u;       ///< Marks a first-level entry that points to a group.
+
+    std::vector<uint32_t> tbl24;        ///< First level, indexed by the top 24 address bits.
+    std::vector<uint32_t> tbl8;         ///< Second-level groups of 256 entries.
+};
+
+#endif
@@ -7,8 +7,25 @@
 #include <map>
 #include <limits>
 #include <climits>
+#include <cerrno>
+#include <cstdint>
 #include <set>
 #include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <queue>
+#include <tuple>
+
+#include "dedup_table.h"
+#include "flap_damping.h"
+#include "interval_table.h"
+#include "latency_histogram.h"
+#include "memory_footprint.h"
+#include "packed_table.h"
+#include "packet_sim.h"
+#include "thread_pool.h"
+#include "versioned_table.h"
 
 using namespace std;
 
@@ -18,12 +35,92 @@ struct Link {
     int cost;
 };
 
+// Kinds of change records: a link toggled, or a router taken down or brought back up
+enum ChangeKind { LinkChange, RouterDown, RouterUp };
+
+// One record of a changes file; a router record names the router as both nodes and has no cost
+struct Change {
+    ChangeKind kind;
+    Link link;
+};
+
+// Routers taken down by change records and the links that went down with them
+struct FailedRouters {
+    set<string> down;
+    vector<Link> links; // links with a down end; restored once both ends are up again
+};
+
+// Links added and removed by one change
+struct TopologyDelta {
+    vector<Link> added;
+    vector<Link> removed;
+};
+
 struct Message {
     string source;
     string destination;
     string content;
 };
 
+// Optional features selected on the command line
+struct Options {
+    bool keepHistory = false; // record the routing tables of every epoch
+    int queryEpoch = -1;      // epoch whose recorded tables are printed after the run
+    string journalFile;       // change journal to write, or to read from when seeking
+    int snapshotEvery = 16;   // epochs between two full snapshots in the journal
+    int seekEpoch = -1;       // epoch to restore from the journal instead of running the changes
+    string areasFile;         // router to area map; enables hierarchical area routing
+    bool flood = false;       // simulate LSA flooding for every change
+    bool floodReduction = false; // flood only over the designated flooding links
+    bool lsdbSync = false;    // synchronize the LSDBs across every new adjacency before flooding
+    string groupsFile;        // anycast groups; messages to a group go to its nearest member
+    string trafficFile;       // traffic to simulate packet by packet on the tables of every epoch
+    PacketSimConfig packetSim; // link and packet parameters of the packet simulation
+    bool flapDamping = false; // hold down flapping links instead of recomputing on each of their changes
+    FlapDampingConfig damping; // half-life and thresholds of the flap damping
+    vector<string> criticalDestinations; // destinations whose routes are computed and published before the full tables
+    bool criticalFromMessages = false; // add the destinations of the messages to the critical destinations
+    bool sticky = false; // keep the previous predecessor while it remains on a shortest path
+    bool fibUpdates = false; // report the next hops that changed in every epoch
+    string manifestFile;      // batch manifest whose scenarios are run instead of a single simulation
+    unsigned batchThreads = 0; // threads running the scenarios of a batch, 0 for the hardware threads
+    bool resident = false;    // after the changes file, serve changes and commands from standard input
+    bool memoryReport = false; // report the bytes of every data structure after the initial convergence
+    double estimateNodes = -1; // node count of the footprint estimate printed instead of a run
+    double estimateLinks = 0; // link count of the footprint estimate
+    bool packedTables = false; // pack the tables of every epoch into neighbour-index form and report their size
+    bool intervalTables = false; // write the messages from interval-compressed tables and report their size
+    int dedupBlock = 0; // destinations per block of the deduplicated tables reported every epoch, or 0
+};
+
+// One routing table entry as recorded in the epoch history, keyed by (node, destination) so that it is ordered
+// like the output
+struct HistoryRow {
+    string hop;
+    int cost;
+
+    bool operator==(const HistoryRow& other) const {
+        return cost == other.cost && hop == other.hop;
+    }
+};
+
+typedef VersionedTable<pair<string, string>, HistoryRow> History;
+
+typedef map<string, map<string, pair<string, int>>> RoutingTables;
+
+// FIB: key(node) -> value(destination, next hop)
+typedef map<string, map<string, string>> Fib;
+
+// Route of a node towards the nearest member of an anycast group; next is the following node on the path
+struct AnycastEntry {
+    string member;
+    string next;
+    int cost;
+};
+
+// Anycast routes: key(group) -> value(node, route to the group's nearest member)
+typedef map<string, map<string, AnycastEntry>> AnycastTables;
+
 // Parse the topology file and store links in a vector
 vector<Link> parseTopologyFile(const string& filename) {
     vector<Link> links;
@@ -79,22 +176,110 @@ vector<Message> parseMessageFile(const string& filename) {
     return messages;
 }
 
-// Parse the changes file and store changes in a vector
-vector<Link> parseChangesFile(const string& filename) {
-    vector<Link> changes;
+// Convert a whole word to an int; false if it is not a decimal integer in the range of int
+bool parseInteger(const string& word, int& value) {
+
+    char* end = nullptr;
+    errno = 0;
+    long parsed = strtol(word.c_str(), &end, 10);
+
+    if (word.empty() || *end != '\0' || errno == ERANGE || parsed < INT_MIN || parsed > INT_MAX) {
+        return false;
+    }
+
+    value = parsed;
+    return true;
+
+}
+
+// Parse one record of a changes file: "node1 node2 cost", "down <node>" or "up <node>", optionally preceded by its time.
+// time holds the time of the previous record and receives that of this one. Returns false if the line is not a
+// well-formed record; a negative cost other than -999 is rejected.
+bool parseChangeLine(const string& line, Change& change, double& time) {
+
+    stringstream ss(line);
+    vector<string> words;
+    string word;
+    while (ss >> word) {
+        words.push_back(word);
+    }
+
+    bool routerRecord = words.size() >= 2 && (words[words.size() - 2] == "down" || words[words.size() - 2] == "up");
+    size_t fields = routerRecord ? 2 : 3;
+
+    if (words.size() < fields || words.size() > fields + 1) {
+        return false;
+    }
+
+    if (words.size() > fields) {
+        char* end = nullptr;
+        double parsed = strtod(words[0].c_str(), &end);
+        if (*end != '\0') {
+            return false;
+        }
+        time = parsed;
+    } else {
+        time = time + 1;
+    }
+
+    const string* record = &words[words.size() - fields];
+
+    if (routerRecord) {
+        change = {record[0] == "down" ? RouterDown : RouterUp, {record[1], record[1], 0}};
+        return true;
+    }
+
+    int cost;
+    if (!parseInteger(record[2], cost) || (cost < 0 && cost != -999)) {
+        return false;
+    }
+
+    change = {LinkChange, {record[0], record[1], cost}};
+
+    return true;
+
+}
+
+// Parse the changes file and store changes in a vector; "down <node>" and "up <node>" take a router down or up with all its links.
+// A line may start with an extra column holding the time of the change in seconds; without one a change happens a second
+// after the previous one. The times go to times. A malformed record, or a router record naming a router that neither the
+// topology nor an earlier record has, stops the program.
+vector<Change> parseChangesFile(const string& filename, const vector<Link>& topology, vector<double>& times) {
+    vector<Change> changes;
     ifstream file(filename);
 
     if (file.is_open()) {
 
-        string line;
+        string line, word;
+        set<string> known;
+        Change change;
+        double time = 0;
+
+        for (const auto& link : topology) {
+            known.insert(link.node1);
+            known.insert(link.node2);
+        }
 
         while (getline(file, line)) {
 
-            stringstream ss(line);
-            string node1, node2;
-            int cost;
-            ss >> node1 >> node2 >> cost;
-            changes.push_back({node1, node2, cost});
+            if (!(stringstream(line) >> word)) {
+                continue;
+            }
+
+            if (!parseChangeLine(line, change, time)) {
+                cerr << "Invalid change record: " << line << endl;
+                exit(EXIT_FAILURE);
+            }
+
+            if (change.kind != LinkChange && !known.count(change.link.node1)) {
+                cerr << "Unknown router in change record: " << line << endl;
+                exit(EXIT_FAILURE);
+            }
+
+            known.insert(change.link.node1);
+            known.insert(change.link.node2);
+            changes.push_back(change);
+            times.push_back(time);
 
         }
 
@@ -107,8 +292,20 @@ vector<Link> parseChangesFile(const string& filename) {
     return changes;
 }
 
-// Perform Dijsktra algorithm
-void updateRoutingTables(map<string, map<string, int>>& lsdb, map<string, map<string, pair<string, int>>>& routingTables) {
+// The predecessor of a destination in the previous tables, empty if it had none
+string previousPredecessor(const RoutingTables& previous, const string& source, const string& destination) {
+    auto table = previous.find(source);
+    if (table == previous.end()) {
+        return "";
+    }
+    auto entry = table->second.find(destination);
+    return (entry == table->second.end() || entry->second.second == INT_MAX) ? "" : entry->second.first;
+}
+
+// Perform Dijsktra algorithm; with previous tables, ties keep the previous predecessor so that the next hops only
+// change where the shortest paths do
+void updateRoutingTables(map<string, map<string, int>>& lsdb, map<string, map<string, pair<string, int>>>& routingTables,
+                         const RoutingTables* previous = nullptr) {
 
     for (const auto& entry : lsdb) {
 
@@ -144,6 +341,11 @@ void updateRoutingTables(map<string, map<string, int>>& lsdb, map<string, map<st
 
             }
 
+            // The remaining nodes are unreachable from the source
+            if (min_distance == INT_MAX) {
+                break;
+            }
+
             // Add the current node to visited set
             visited.insert(current_node);
 
@@ -165,6 +367,11 @@ void updateRoutingTables(map<string, map<string, int>>& lsdb, map<string, map<st
 
                         routingTables[source][neighbor_node] = make_pair(current_node, distance[neighbor_node]);
 
+                    } else if (previous && neighbor_distance > 0 && visited.find(neighbor_node) == visited.end() &&
+                               previousPredecessor(*previous, source, neighbor_node) == current_node) {
+
+                        routingTables[source][neighbor_node].first = current_node;
+
                     }
 
                 }
@@ -178,39 +385,87 @@ void updateRoutingTables(map<string, map<string, int>>& lsdb, map<string, map<st
 }
 
 
-// Perform Link State Routing (LSR)
-void lsr(const string& topologyFile, const string& messageFile, const string& changesFile, const string& outputFile) {
+// Record the current routing tables as the next epoch. Only the entries that differ from the previous epoch are
+// handed to the history; unchanged pages are shared with the previous epoch
+void recordEpoch(History& history, const RoutingTables& routingTables) {
 
-    vector<Link> topology = parseTopologyFile(topologyFile);
-    vector<Message> messages = parseMessageFile(messageFile);
-    vector<Link> changes = parseChangesFile(changesFile);
+    vector<History::Row> changed;
+    vector<pair<string, string>> removed;
+    size_t epochs = history.epochCount(), kept = 0;
 
-    /* cout << "Topology File Contents:" << endl;
-    for (const auto& link : topology) {
-        cout << link.node1 << " " << link.node2 << " " << link.cost << endl;
+    for (const auto& routingTable : routingTables) {
+        for (const auto& entry : routingTable.second) {
+            pair<string, string> key(routingTable.first, entry.first);
+            HistoryRow row = {entry.second.first, entry.second.second};
+            const HistoryRow* previous = epochs ? history.find(epochs - 1, key) : nullptr;
+            if (previous) {
+                kept++;
+            }
+            if (!previous || !(*previous == row)) {
+                changed.push_back(History::Row(key, row));
+            }
+        }
     }
-    cout << endl;
 
-    cout << "Message File Contents:" << endl;
-    for (const auto& message : messages) {
-        cout << message.source << " " << message.destination << " " << message.content << endl;
+    // Entries of the previous epoch that were not seen again are gone; only look for them if there are any
+    if (epochs && kept < history.rowCount(epochs - 1)) {
+        history.forEach(epochs - 1, [&](const pair<string, string>& key, const HistoryRow&) {
+            auto table = routingTables.find(key.first);
+            if (table == routingTables.end() || !table->second.count(key.second)) {
+                removed.push_back(key);
+            }
+        });
     }
-    cout << endl;
 
-    cout << "Changes File Contents:" << endl;
-    for (const auto& change : changes) {
-        cout << change.node1 << " " << change.node2 << " " << change.cost << endl;
+    history.commit(changed, removed);
+
+}
+
+// Print the routing tables of a recorded epoch in the output file format
+void writeEpoch(ostream& out, const History& history, size_t epoch) {
+
+    vector<History::Row> rows = history.rows(epoch);
+
+    for (size_t i = 0; i < rows.size(); i++) {
+
+        out << rows[i].first.second << " " << rows[i].second.hop << " " << rows[i].second.cost << "\n";
+
+        if (i + 1 == rows.size() || rows[i + 1].first.first != rows[i].first.first) {
+            out << "\n";
+        }
+
     }
-    cout << endl; */
-    
-    map<string, map<string, int>> lsdb; // Link State Database: key(node) -> value(neighbor, cost)
-    for (const Link& link : topology) {
+
+}
+
+// Print the size of the epoch history compared with keeping a full copy of every epoch
+void reportHistory(const History& history) {
+
+    size_t epochs = history.epochCount();
+
+    cerr << "history: " << epochs << " epochs, "
+         << (epochs ? history.rowCount(epochs - 1) : 0) << " rows in the latest epoch, "
+         << history.livePages() << " live pages, "
+         << history.getRowsWritten() << " rows written, "
+         << history.storedBytes() << " bytes stored vs "
+         << history.fullCopyBytes() << " bytes for full copies" << endl;
+
+}
+
+// Build the LSDB from the topology
+void buildLsdb(const vector<Link>& topology, map<string, map<string, int>>& lsdb) {
+
+    lsdb.clear();
+
+    for (const auto& link : topology) {
         lsdb[link.node1][link.node2] = link.cost;
         lsdb[link.node2][link.node1] = link.cost; // Add reverse link for undirected graph
     }
 
-    // Routing Tables: key(node) -> value(destination, (nextHop, cost))
-    map<string, map<string, pair<string, int>>> routingTables;
+}
+
+// Compute the initial routing tables: direct links first, infinity for everything else, then Dijkstra
+void initRoutingTables(map<string, map<string, int>>& lsdb, RoutingTables& routingTables) {
 
     // Fill routingTables based on LSDB
     for (const auto& entry : lsdb) {
@@ -242,157 +497,2788 @@ void lsr(const string& topologyFile, const string& messageFile, const string& ch
 
     updateRoutingTables(lsdb, routingTables);
 
-    /* 
+}
 
-    for (const auto& routingTable : routingTables) {
-        std::cout << "Routing table for node " << routingTable.first << ":\n";
-        for (const auto& entry : routingTable.second) {
-            std::cout << "" << entry.first << " " << entry.second.first << " " << entry.second.second << "\n";
+// Apply a change to the topology: an existing link is removed, a new link is added. A router going down moves
+// all its links into failed at once, and coming back up it restores those whose other end is up; a link toggled
+// while one of its ends is down is toggled in failed.
+TopologyDelta applyChange(vector<Link>& topology, const Change& record, FailedRouters& failed) {
+
+    TopologyDelta delta;
+    const Link& change = record.link;
+    auto isDown = [&](const Link& l) { return failed.down.count(l.node1) || failed.down.count(l.node2); };
+
+    if (record.kind == RouterDown) {
+
+        if (failed.down.insert(change.node1).second) {
+            auto it = stable_partition(topology.begin(), topology.end(), [&](const Link& l) { return !isDown(l); });
+            delta.removed.assign(it, topology.end());
+            failed.links.insert(failed.links.end(), it, topology.end());
+            topology.erase(it, topology.end());
         }
-        std::cout << "\n";
+
+        return delta;
+
     }
-    
-    */
-    
-    ofstream outfile(outputFile);
-    if (outfile.is_open()) {
 
-        for (const auto& routingTable : routingTables) {
+    if (record.kind == RouterUp) {
 
-            for (const auto& entry : routingTable.second) {
-                outfile << entry.first << " " << entry.second.first << " " << entry.second.second << "\n";
-            }
+        if (failed.down.erase(change.node1)) {
+            auto it = stable_partition(failed.links.begin(), failed.links.end(), isDown);
+            delta.added.assign(it, failed.links.end());
+            topology.insert(topology.end(), it, failed.links.end());
+            failed.links.erase(it, failed.links.end());
+        }
+
+        return delta;
 
-            outfile << "\n";
+    }
 
-        }  
+    vector<Link>& links = isDown(change) ? failed.links : topology;
 
-        for (const auto& message : messages) {
+    // Check if the link should be added or removed
+    auto it = find_if(links.begin(), links.end(), [&](const Link& l) { return l.node1 == change.node1 && l.node2 == change.node2; });
+    bool exists = (it != links.end());
 
-            // Find shortest path from source to destination
-            string shortestPath;
-            int totalCost = 0; // Initialize total cost to zero
+    if (exists) {
+        // Link exists, remove it
+        links.erase(it);
+    } else {
+        // Link does not exist, add it
+        links.push_back(change);
+    }
 
-            if (routingTables.find(message.source) != routingTables.end() && routingTables[message.source].find(message.destination) != routingTables[message.source].end()) {
-                
-                totalCost = routingTables[message.source][message.destination].second; // Use cost from routing table
-                string currentNode = message.destination; // Start from destination
+    if (&links == &topology) {
+        (exists ? delta.removed : delta.added).push_back(change);
+    }
 
-                while (currentNode != message.source) {
-                    if (currentNode != message.destination) {
-                        shortestPath = currentNode + " " + shortestPath;
-                    }
-                    currentNode = routingTables[message.source][currentNode].first;
-                }
-            }
+    return delta;
 
-            outfile << "from " << message.source << " to " << message.destination << " cost " << totalCost << " hops " << message.source << " " << shortestPath << message.content << "\n";
+}
+
+// Reverse SPF: one Dijkstra rooted at the destination gives every node's cost to it and its next hop on the way,
+// since links are symmetric. Ties go to the next hop that comes first in node order.
+map<string, pair<string, int>> reverseSpf(const map<string, map<string, int>>& lsdb, const string& destination) {
+
+    map<string, pair<string, int>> routes; // node -> (next hop, cost)
+    priority_queue<tuple<int, string, string>, vector<tuple<int, string, string>>, greater<tuple<int, string, string>>> queue;
+    queue.push(make_tuple(0, destination, destination));
+
+    while (!queue.empty()) {
+
+        int cost;
+        string node, next;
+        tie(cost, node, next) = queue.top();
+        queue.pop();
+
+        if (routes.count(node)) {
+            continue;
         }
 
-        outfile << "\n";
+        routes[node] = make_pair(next, cost);
 
-        // Apply changes
-        for (const auto& change : changes) {
+        auto adjacencies = lsdb.find(node);
+        if (adjacencies == lsdb.end()) {
+            continue;
+        }
 
-            // Check if the link should be added or removed
-            auto it = find_if(topology.begin(), topology.end(), [&](const Link& l) { return l.node1 == change.node1 && l.node2 == change.node2; });
-            
-            if (it != topology.end()) {
-                // Link exists, remove it
-                topology.erase(it);
-            } else {
-                // Link does not exist, add it
-                topology.push_back(change);
+        for (const auto& neighbor : adjacencies->second) {
+            if (!routes.count(neighbor.first)) {
+                queue.push(make_tuple(cost + neighbor.second, neighbor.first, node));
             }
+        }
 
-            // Update routing tables based on modified topology
-            lsdb.clear();
-            routingTables.clear();
+    }
 
-            for (const auto& link : topology) {
-                lsdb[link.node1][link.node2] = link.cost;
-                lsdb[link.node2][link.node1] = link.cost; // Add reverse link for undirected graph
-            }
+    return routes;
 
-            // Add entry for each node to itself with distance 0
-            for (const auto& entry : lsdb) {
-                string node = entry.first;
-                routingTables[node][node] = make_pair(node, 0); // Node's entry for itself
-            }
+}
+
+// Routes of every node towards each critical destination: key(destination) -> value(node, (next hop, cost))
+typedef map<string, map<string, pair<string, int>>> CriticalRoutes;
 
-            // Update routing tables based on the modified topology
-            updateRoutingTables(lsdb, routingTables);
+// Compute the routes to the critical destinations with one reverse SPF each and publish them on standard output as
+// "critical: epoch E destination D: node nextHop cost" lines, one per node that reaches D
+CriticalRoutes routeCriticalDestinations(int epoch, const map<string, map<string, int>>& lsdb, const vector<string>& critical) {
 
-            vector<string> nodeIds;
+    CriticalRoutes published;
 
-            for (const auto& entry : routingTables) {
-                nodeIds.push_back(entry.first);
+    for (const auto& destination : critical) {
+        if (lsdb.count(destination)) {
+            published[destination] = reverseSpf(lsdb, destination);
+        }
+    }
+
+    for (const auto& destination : published) {
+        for (const auto& route : destination.second) {
+            cout << "critical: epoch " << epoch << " destination " << destination.first << ": " << route.first << " "
+                 << route.second.first << " " << route.second.second << "\n";
+        }
+    }
+
+    cout.flush();
+
+    return published;
+
+}
+
+// Report the time to the critical routes next to the time to full convergence, and how many critical route costs
+// the full tables disagree with
+void reportCriticalRoutes(ostream& out, int epoch, const CriticalRoutes& published, const RoutingTables& routingTables,
+                          double criticalSeconds, double fullSeconds) {
+
+    int costChanges = 0;
+
+    for (const auto& destination : published) {
+        for (const auto& routingTable : routingTables) {
+            auto route = destination.second.find(routingTable.first);
+            auto entry = routingTable.second.find(destination.first);
+            int cost = (route == destination.second.end()) ? INT_MAX : route->second.second;
+            if ((entry == routingTable.second.end() ? INT_MAX : entry->second.second) != cost) {
+                costChanges++;
             }
-            sort(nodeIds.begin(), nodeIds.end());
+        }
+    }
 
-            for (const auto& nodeId : nodeIds) {
+    out << "priority: epoch " << epoch << ": " << published.size() << " critical destinations published after " << criticalSeconds
+        << " s, full convergence after " << fullSeconds << " s; the full run changed " << costChanges << " critical route costs" << endl;
 
-                for (const auto& entry : routingTables[nodeId]) {
-                    outfile << entry.first << " " << entry.second.first << " " << entry.second.second << "\n";
-                }
+}
+
+// Release the held-down links whose penalty has decayed to the reuse threshold and report them
+void releaseDampedLinks(FlapDamper<string>& damper, double time, int epoch) {
+    for (const auto& link : damper.release(time)) {
+        cerr << "damping: epoch " << epoch << ": link " << link.first << "-" << link.second << " released" << endl;
+    }
+}
+
+// The topology in use under flap damping becomes the actual links that are not held down. Returns the links that
+// entered and left it.
+TopologyDelta selectDampedLinks(const FlapDamper<string>& damper, const vector<Link>& actualTopology, vector<Link>& topology) {
+
+    vector<Link> inUse;
+    for (const auto& link : actualTopology) {
+        if (!damper.isSuppressed(link.node1, link.node2)) {
+            inUse.push_back(link);
+        }
+    }
 
-                outfile << "\n";
+    // Links present on one side only; the rest is matched one to one
+    TopologyDelta delta;
+    vector<bool> matched(topology.size(), false);
+
+    for (const auto& link : inUse) {
+        bool found = false;
+        for (size_t i = 0; i < topology.size() && !found; i++) {
+            if (!matched[i] && topology[i].node1 == link.node1 && topology[i].node2 == link.node2 && topology[i].cost == link.cost) {
+                matched[i] = found = true;
             }
+        }
+        if (!found) {
+            delta.added.push_back(link);
+        }
+    }
 
-            // Output messages based on the modified topology
-            for (const auto& message : messages) {
+    for (size_t i = 0; i < topology.size(); i++) {
+        if (!matched[i]) {
+            delta.removed.push_back(topology[i]);
+        }
+    }
+
+    topology.swap(inUse);
 
-                // Find shortest path from source to destination
-                string shortestPath;
-                int totalCost = 0; // Initialize total cost to zero
+    return delta;
 
-                if (routingTables.find(message.source) != routingTables.end() && routingTables[message.source].find(message.destination) != routingTables[message.source].end()) {
-                    totalCost = routingTables[message.source][message.destination].second; // Use cost from routing table
-                    string currentNode = message.destination; // Start from destination
+}
 
-                    while (currentNode != message.source) {
+// Apply a change under flap damping: the change goes to actualTopology and charges the changed link a flap. After
+// the links whose penalty has decayed are released, the topology in use becomes the actual links that are not held
+// down. Suppressions and releases are reported. Returns the links that entered and left the topology in use. A
+// release that falls between two changes is an epoch of its own.
+TopologyDelta applyDampedChange(const Change& change, double time, int epoch, FlapDamper<string>& damper,
+                                vector<Link>& actualTopology, FailedRouters& failed, vector<Link>& topology) {
 
-                        if (currentNode != message.destination) {
-                            shortestPath = currentNode + " " + shortestPath;
-                        }
+    applyChange(actualTopology, change, failed);
 
-                        currentNode = routingTables[message.source][currentNode].first;
+    releaseDampedLinks(damper, time, epoch);
 
-                    }
+    if (change.kind == LinkChange) {
+        const Link& link = change.link;
+        bool suppressed = damper.isSuppressed(link.node1, link.node2);
+        if (damper.flap(link.node1, link.node2, time) && !suppressed) {
+            cerr << "damping: epoch " << epoch << ": link " << min(link.node1, link.node2) << "-" << max(link.node1, link.node2)
+                 << " suppressed (penalty " << damper.getPenalty(link.node1, link.node2, time) << ")" << endl;
+        }
+    }
+
+    return selectDampedLinks(damper, actualTopology, topology);
+
+}
+
+// Count the routes whose cost differs from the shortest paths over the actual topology, which measures what flap
+// damping costs in routing accuracy; adds the number of routes compared to total
+long long countStaleRoutes(const RoutingTables& routingTables, const vector<Link>& actualTopology, long long& total) {
+
+    map<string, map<string, int>> lsdb;
+    buildLsdb(actualTopology, lsdb);
+
+    long long stale = 0;
+
+    for (const auto& source : lsdb) {
+
+        map<string, int> distance;
+        priority_queue<pair<int, string>, vector<pair<int, string>>, greater<pair<int, string>>> queue;
+        distance[source.first] = 0;
+        queue.push(make_pair(0, source.first));
+
+        while (!queue.empty()) {
+            pair<int, string> top = queue.top();
+            queue.pop();
+            if (top.first > distance[top.second]) {
+                continue;
+            }
+            for (const auto& neighbor : lsdb[top.second]) {
+                auto it = distance.find(neighbor.first);
+                if (it == distance.end() || top.first + neighbor.second < it->second) {
+                    distance[neighbor.first] = top.first + neighbor.second;
+                    queue.push(make_pair(top.first + neighbor.second, neighbor.first));
                 }
+            }
+        }
 
-                outfile << "from " << message.source << " to " << message.destination << " cost " << totalCost << " hops " << message.source << " " << shortestPath << message.content << "\n";
-                outfile << endl;
+        auto table = routingTables.find(source.first);
 
+        for (const auto& destination : lsdb) {
+            auto it = distance.find(destination.first);
+            int exact = (it == distance.end()) ? INT_MAX : it->second;
+            int used = INT_MAX;
+            if (table != routingTables.end() && table->second.count(destination.first)) {
+                used = table->second.at(destination.first).second;
             }
+            if (used != exact) {
+                stale++;
+            }
+            total++;
+        }
+
+    }
+
+    return stale;
+
+}
+
+// Rebuild the LSDB and routing tables from scratch after a change to the topology
+void rebuildRoutingTables(const vector<Link>& topology, map<string, map<string, int>>& lsdb, RoutingTables& routingTables,
+                          const RoutingTables* previous = nullptr) {
+
+    buildLsdb(topology, lsdb);
+    routingTables.clear();
+
+    // Add entry for each node to itself with distance 0
+    for (const auto& entry : lsdb) {
+        string node = entry.first;
+        routingTables[node][node] = make_pair(node, 0); // Node's entry for itself
+    }
 
+    // Update routing tables based on the modified topology
+    updateRoutingTables(lsdb, routingTables, previous);
+
+}
+
+// Write every node's routing table, one block per node in node order
+void writeRoutingTables(ostream& outfile, const RoutingTables& routingTables) {
+
+    for (const auto& routingTable : routingTables) {
+
+        for (const auto& entry : routingTable.second) {
+            outfile << entry.first << " " << entry.second.first << " " << entry.second.second << "\n";
         }
 
-        outfile.close();
-    } else {
-        cerr << "Unable to open output file." << endl;
+        outfile << "\n";
+
     }
 
 }
 
-int main(int argc, char** argv) {
-    if (argc != 4 && argc != 5) {
-        cerr << "Usage: " << argv[0] << " <topologyFile> <messageFile> <changesFile> [<outputFile>]" << endl;
+// Write the path to the chosen member of a message sent to an anycast group; returns false if the destination is not a group
+bool writeAnycastMessage(ostream& outfile, const AnycastTables* anycast, const Message& message) {
+
+    if (anycast == nullptr || !anycast->count(message.destination)) {
+        return false;
+    }
+
+    const map<string, AnycastEntry>& routes = anycast->at(message.destination);
+    auto route = routes.find(message.source);
+
+    outfile << "from " << message.source << " to " << message.destination;
+
+    if (route == routes.end()) {
+        outfile << " member none cost infinite hops unreachable" << message.content << "\n";
+        return true;
+    }
+
+    string path = message.source + " ";
+
+    for (string node = route->second.next; node != route->second.member; node = routes.at(node).next) {
+        path += node + " ";
+    }
+
+    outfile << " member " << route->second.member << " cost " << route->second.cost << " hops " << path << message.content << "\n";
+
+    return true;
+
+}
+
+// Write a multicast message, whose destinations are a comma-separated list, over the source's shortest-path
+// tree pruned to the destinations. Each tree link is counted once and the total cost is the sum of the tree
+// links. With predecessor tables the tree is grown from each destination towards the source and stops at the
+// first node already in the tree, so every tree link is visited once; with next-hop tables, passed with the LSDB
+// that prices their links, the forwarded paths are merged. Returns false if the message is not a multicast message.
+bool writeMulticastMessage(ostream& outfile, const RoutingTables& routingTables, const Message& message,
+                           const map<string, map<string, int>>* lsdb = nullptr) {
+
+    if (message.destination.find(',') == string::npos) {
+        return false;
+    }
+
+    vector<string> destinations;
+    stringstream ss(message.destination);
+    string destination;
+    while (getline(ss, destination, ',')) {
+        if (!destination.empty()) {
+            destinations.push_back(destination);
+        }
+    }
+
+    auto reachable = [&](const string& node, const string& target) {
+        auto table = routingTables.find(node);
+        if (table == routingTables.end()) {
+            return false;
+        }
+        auto entry = table->second.find(target);
+        return entry != table->second.end() && !entry->second.first.empty() && entry->second.second != INT_MAX;
+    };
+
+    set<pair<string, string>> tree;
+    set<string> inTree = {message.source};
+    vector<string> unreachable;
+    long long totalCost = 0;
+
+    for (const string& target : destinations) {
+
+        if (!reachable(message.source, target)) {
+            unreachable.push_back(target);
+            continue;
+        }
+
+        if (lsdb) {
+
+            // Forward hop by hop, guarding against loops; the path joins the tree only if it reaches the target
+            vector<pair<string, string>> path;
+            string node = message.source;
+            for (size_t hops = 0; node != target && hops < routingTables.size() && reachable(node, target); hops++) {
+                string next = routingTables.find(node)->second.find(target)->second.first;
+                path.push_back(make_pair(node, next));
+                node = next;
+            }
+
+            if (node != target) {
+                unreachable.push_back(target);
+                continue;
+            }
+
+            for (const auto& link : path) {
+                auto adjacencies = lsdb->find(link.first);
+                if (adjacencies != lsdb->end() && adjacencies->second.count(link.second) && tree.insert(link).second) {
+                    totalCost += adjacencies->second.at(link.second);
+                }
+            }
+
+        } else {
+
+            // Climb the source's tree through the predecessors until the tree built so far is reached
+            const map<string, pair<string, int>>& table = routingTables.at(message.source);
+            for (string node = target; !inTree.count(node); node = table.at(node).first) {
+                const string& predecessor = table.at(node).first;
+                inTree.insert(node);
+                tree.insert(make_pair(predecessor, node));
+                totalCost += table.at(node).second - table.at(predecessor).second;
+            }
+
+        }
+
+    }
+
+    outfile << "from " << message.source << " to " << message.destination << " cost " << totalCost << " tree";
+
+    for (const auto& link : tree) {
+        outfile << " " << link.first << "-" << link.second;
+    }
+
+    for (const string& target : unreachable) {
+        outfile << " unreachable " << target;
+    }
+
+    outfile << message.content << "\n";
+
+    return true;
+
+}
+
+// Write the path and cost of every message; after a change each message is followed by a blank line
+void writeMessages(ostream& outfile, RoutingTables& routingTables, const vector<Message>& messages, bool blankLineAfterEach, const AnycastTables* anycast = nullptr) {
+
+    for (const auto& message : messages) {
+
+        if (writeAnycastMessage(outfile, anycast, message) || writeMulticastMessage(outfile, routingTables, message)) {
+            if (blankLineAfterEach) {
+                outfile << endl;
+            }
+            continue;
+        }
+
+        // Find shortest path from source to destination
+        string shortestPath;
+        int totalCost = 0; // Initialize total cost to zero
+
+        if (routingTables.find(message.source) != routingTables.end() && routingTables[message.source].find(message.destination) != routingTables[message.source].end()) {
+
+            totalCost = routingTables[message.source][message.destination].second; // Use cost from routing table
+            string currentNode = message.destination; // Start from destination
+
+            // An empty hop marks an unreachable destination
+            while (currentNode != message.source && !currentNode.empty()) {
+
+                if (currentNode != message.destination) {
+                    shortestPath = currentNode + " " + shortestPath;
+                }
+
+                currentNode = routingTables[message.source][currentNode].first;
+
+            }
+        }
+
+        outfile << "from " << message.source << " to " << message.destination << " cost " << totalCost << " hops " << message.source << " " << shortestPath << message.content << "\n";
+
+        if (blankLineAfterEach) {
+            outfile << endl;
+        }
+
+    }
+
+    if (!blankLineAfterEach) {
+        outfile << "\n";
+    }
+
+}
+
+// Append-only journal of changes with a full snapshot of the routing state every snapshotEvery epochs.
+// The byte offset of each snapshot is listed in the index file <journal>.idx.
+class ChangeJournal {
+public:
+
+    ChangeJournal(const string& journalFile, int snapshotEvery)
+        : journal(journalFile, ofstream::out), index(journalFile + ".idx", ofstream::out), snapshotEvery(snapshotEvery) {
+
+        if (!journal.is_open() || !index.is_open()) {
+            cerr << "Unable to open journal file: " << journalFile << endl;
+            exit(EXIT_FAILURE);
+        }
+
+    }
+
+    void recordChange(int epoch, const Change& change) {
+        journal << "change " << epoch << " ";
+        if (change.kind == LinkChange) {
+            journal << change.link.node1 << " " << change.link.node2 << " " << change.link.cost << "\n";
+        } else {
+            journal << (change.kind == RouterDown ? "down " : "up ") << change.link.node1 << "\n";
+        }
+    }
+
+    // Snapshot the topology and routing tables if the epoch falls on the snapshot cadence.
+    // Unreachable entries have an empty hop, which is journaled as "-".
+    void recordEpoch(int epoch, const vector<Link>& topology, const FailedRouters& failed, const RoutingTables& routingTables) {
+
+        if (epoch % snapshotEvery != 0) {
+            return;
+        }
+
+        journal.flush();
+        index << epoch << " " << journal.tellp() << "\n";
+        index.flush();
+
+        journal << "snapshot " << epoch << "\n";
+
+        for (const auto& link : topology) {
+            journal << "link " << link.node1 << " " << link.node2 << " " << link.cost << "\n";
+        }
+
+        for (const auto& node : failed.down) {
+            journal << "down " << node << "\n";
+        }
+
+        for (const auto& link : failed.links) {
+            journal << "failed " << link.node1 << " " << link.node2 << " " << link.cost << "\n";
+        }
+
+        for (const auto& routingTable : routingTables) {
+            for (const auto& entry : routingTable.second) {
+                string hop = entry.second.first.empty() ? "-" : entry.second.first;
+                journal << "route " << routingTable.first << " " << entry.first << " " << hop << " " << entry.second.second << "\n";
+            }
+        }
+
+        journal << "end\n";
+
+    }
+
+private:
+    ofstream journal;
+    ofstream index;
+    int snapshotEvery;
+};
+
+// Restore the topology and routing tables of an epoch: load the nearest snapshot at or before it
+// and replay the journaled changes that follow
+void seekToEpoch(const string& journalFile, int epoch, vector<Link>& topology, map<string, map<string, int>>& lsdb, RoutingTables& routingTables) {
+
+    ifstream index(journalFile + ".idx");
+
+    if (!index.is_open()) {
+        cerr << "Unable to open journal index: " << journalFile << ".idx" << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    int snapshotEpoch = -1, indexedEpoch;
+    long long offset = 0, indexedOffset;
+
+    while (index >> indexedEpoch >> indexedOffset) {
+        if (indexedEpoch <= epoch && indexedEpoch > snapshotEpoch) {
+            snapshotEpoch = indexedEpoch;
+            offset = indexedOffset;
+        }
+    }
+
+    ifstream journal(journalFile);
+
+    if (snapshotEpoch < 0 || !journal.is_open()) {
+        cerr << "No snapshot at or before epoch " << epoch << " in journal: " << journalFile << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    journal.seekg(offset);
+
+    string line, kind;
+    FailedRouters failed;
+    getline(journal, line);
+
+    while (getline(journal, line) && line != "end") {
+
+        stringstream ss(line);
+        string node1, node2, hop;
+        int cost;
+
+        ss >> kind >> node1 >> node2;
+
+        if (kind == "link" && ss >> cost) {
+            topology.push_back({node1, node2, cost});
+        } else if (kind == "down") {
+            failed.down.insert(node1);
+        } else if (kind == "failed" && ss >> cost) {
+            failed.links.push_back({node1, node2, cost});
+        } else if (kind == "route" && ss >> hop >> cost) {
+            routingTables[node1][node2] = make_pair(hop == "-" ? "" : hop, cost);
+        }
+
+    }
+
+    buildLsdb(topology, lsdb);
+
+    int reached = snapshotEpoch;
+
+    while (reached < epoch && getline(journal, line)) {
+
+        stringstream ss(line);
+        string record;
+        int changeEpoch;
+        Change change;
+        double time = 0;
+
+        if (!(ss >> kind >> changeEpoch) || kind != "change" || !getline(ss, record) || !parseChangeLine(record, change, time)) {
+            continue;
+        }
+
+        applyChange(topology, change, failed);
+        rebuildRoutingTables(topology, lsdb, routingTables);
+        reached = changeEpoch;
+
+    }
+
+    if (reached != epoch) {
+        cerr << "Epoch " << epoch << " is beyond the end of the journal: " << journalFile << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    cerr << "seek: loaded snapshot of epoch " << snapshotEpoch << ", replayed " << (epoch - snapshotEpoch) << " changes" << endl;
+
+}
+
+// Dense, index-based view of the LSDB used by the engines that do not work on the string maps
+struct IndexedGraph {
+    vector<string> names;               // index -> node name, in sorted order
+    map<string, int> index;             // node name -> index
+    vector<vector<pair<int, int>>> adj; // index -> (neighbor index, cost)
+};
+
+IndexedGraph buildIndexedGraph(const map<string, map<string, int>>& lsdb) {
+
+    IndexedGraph graph;
+
+    for (const auto& entry : lsdb) {
+        graph.index[entry.first] = graph.names.size();
+        graph.names.push_back(entry.first);
+    }
+
+    graph.adj.resize(graph.names.size());
+
+    for (const auto& entry : lsdb) {
+        for (const auto& neighbor : entry.second) {
+            graph.adj[graph.index[entry.first]].push_back(make_pair(graph.index[neighbor.first], neighbor.second));
+        }
+    }
+
+    return graph;
+
+}
+
+// Edge of a graph the area engine runs SPF on; hop is the physical next hop used when the edge is the first one on a path
+struct SpfEdge {
+    int to;
+    int cost;
+    int hop;
+};
+
+// Single-source Dijkstra with a binary heap; firstHop[v] is the hop of the first edge on the shortest path to v
+void runSpf(const vector<vector<SpfEdge>>& adj, int source, vector<int>& distance, vector<int>& firstHop) {
+
+    distance.assign(adj.size(), INT_MAX);
+    firstHop.assign(adj.size(), -1);
+    distance[source] = 0;
+
+    priority_queue<pair<int, int>, vector<pair<int, int>>, greater<pair<int, int>>> queue;
+    queue.push(make_pair(0, source));
+
+    while (!queue.empty()) {
+
+        int current = queue.top().second;
+        int currentDistance = queue.top().first;
+        queue.pop();
+
+        if (currentDistance > distance[current]) {
+            continue;
+        }
+
+        for (const SpfEdge& edge : adj[current]) {
+
+            int candidate = currentDistance + edge.cost;
+
+            if (candidate < distance[edge.to]) {
+                distance[edge.to] = candidate;
+                firstHop[edge.to] = (current == source) ? edge.hop : firstHop[current];
+                queue.push(make_pair(candidate, edge.to));
+            }
+
+        }
+
+    }
+
+}
+
+// Parse the anycast groups file: one "group member member ..." line per group
+map<string, vector<string>> parseGroupsFile(const string& filename) {
+    map<string, vector<string>> groups;
+    ifstream file(filename);
+
+    if (file.is_open()) {
+
+        string line;
+
+        while (getline(file, line)) {
+            stringstream ss(line);
+            string group, member;
+            if (ss >> group) {
+                while (ss >> member) {
+                    groups[group].push_back(member);
+                }
+            }
+        }
+
+        file.close();
+
+    } else {
+        cerr << "Unable to open file: " << filename << endl;
+    }
+
+    return groups;
+}
+
+// Resolve every anycast group with one multi-source Dijkstra: all members start at distance 0, so each
+// node is settled from its nearest member and its predecessor in that search is its next hop towards it.
+// Ties between members at the same distance go to the member that sorts first.
+void resolveAnycast(const map<string, vector<string>>& groups, const map<string, map<string, int>>& lsdb, AnycastTables& anycast) {
+
+    IndexedGraph graph = buildIndexedGraph(lsdb);
+    size_t n = graph.names.size();
+
+    anycast.clear();
+
+    for (const auto& group : groups) {
+
+        map<string, AnycastEntry>& routes = anycast[group.first];
+
+        vector<int> distance(n, INT_MAX), member(n, INT_MAX), next(n, -1);
+
+        // (distance, member, node); members are node indices, which follow the sorted node names
+        priority_queue<tuple<int, int, int>, vector<tuple<int, int, int>>, greater<tuple<int, int, int>>> queue;
+
+        for (const string& name : group.second) {
+            auto it = graph.index.find(name);
+            if (it != graph.index.end() && distance[it->second] != 0) {
+                distance[it->second] = 0;
+                member[it->second] = it->second;
+                next[it->second] = it->second;
+                queue.push(make_tuple(0, it->second, it->second));
+            }
+        }
+
+        while (!queue.empty()) {
+
+            int currentDistance = get<0>(queue.top());
+            int currentMember = get<1>(queue.top());
+            int current = get<2>(queue.top());
+            queue.pop();
+
+            if (currentDistance != distance[current] || currentMember != member[current]) {
+                continue;
+            }
+
+            // Links are symmetric, so the reverse SPF runs on the same adjacency
+            for (const auto& edge : graph.adj[current]) {
+
+                int candidate = currentDistance + edge.second;
+
+                if (make_pair(candidate, currentMember) < make_pair(distance[edge.first], member[edge.first])) {
+                    distance[edge.first] = candidate;
+                    member[edge.first] = currentMember;
+                    next[edge.first] = current;
+                    queue.push(make_tuple(candidate, currentMember, edge.first));
+                }
+
+            }
+
+        }
+
+        for (size_t node = 0; node < n; node++) {
+            if (distance[node] != INT_MAX) {
+                routes[graph.names[node]] = {graph.names[member[node]], graph.names[next[node]], distance[node]};
+            }
+        }
+
+    }
+
+}
+
+// Parse the areas file: one "router area" pair per line, area 0 is the backbone
+map<string, int> parseAreasFile(const string& filename) {
+    map<string, int> areas;
+    ifstream file(filename);
+
+    if (file.is_open()) {
+
+        string line;
+
+        while (getline(file, line)) {
+            stringstream ss(line);
+            string node;
+            int area;
+            if (ss >> node >> area) {
+                areas[node] = area;
+            }
+        }
+
+        file.close();
+
+    } else {
+        cerr << "Unable to open file: " << filename << endl;
+    }
+
+    return areas;
+}
+
+// OSPF-style hierarchical routing. Every router belongs to one area (routers not listed are in the
+// backbone area 0). Each non-backbone area runs its own all-pairs SPF over its internal links; the
+// backbone graph holds the area 0 routers and the area border routers (routers with a link into
+// another area), connected by the backbone and inter-area links plus one summary edge per pair of
+// border routers of the same area. Inter-area routes are derived from the summaries: the cost from a
+// backbone router to a destination is the best backbone cost to one of the destination area's
+// border routers plus that border router's intra-area cost. The tables hold real next hops.
+class AreaRouting {
+public:
+
+    AreaRouting(const map<string, int>& areaOf, ThreadPool& pool) : areaOf(areaOf), pool(pool) {}
+
+    // Recompute after a change. Only the area holding the changed link is recomputed; the backbone is
+    // recomputed when the change touches it or when that area's border-to-border costs moved.
+    void update(const map<string, map<string, int>>& lsdb, const Link* change) {
+
+        IndexedGraph next = buildIndexedGraph(lsdb);
+        bool fullRecompute = (change == nullptr) || next.names != graph.names;
+        graph = next;
+
+        area.assign(graph.names.size(), 0);
+        for (size_t v = 0; v < graph.names.size(); v++) {
+            auto it = areaOf.find(graph.names[v]);
+            area[v] = (it != areaOf.end()) ? it->second : 0;
+        }
+
+        set<int> dirtyAreas;
+        bool backboneDirty = fullRecompute;
+
+        if (fullRecompute) {
+            areas.clear();
+            for (size_t v = 0; v < graph.names.size(); v++) {
+                if (area[v] != 0) {
+                    dirtyAreas.insert(area[v]);
+                }
+            }
+        } else {
+            int area1 = area[graph.index[change->node1]];
+            int area2 = area[graph.index[change->node2]];
+            if (area1 == area2 && area1 != 0) {
+                dirtyAreas.insert(area1);
+            } else {
+                backboneDirty = true;
+            }
+        }
+
+        // Border routers depend on the inter-area links only, so they are cheap to refresh every time
+        border.assign(graph.names.size(), false);
+        for (size_t v = 0; v < graph.names.size(); v++) {
+            for (const auto& neighbor : graph.adj[v]) {
+                if (area[v] != 0 && area[neighbor.first] != area[v]) {
+                    border[v] = true;
+                }
+            }
+        }
+
+        map<int, vector<int>> oldSummaries;
+        for (int a : dirtyAreas) {
+            oldSummaries[a] = borderCosts(a);
+            buildArea(a);
+        }
+
+        for (int a : dirtyAreas) {
+            Area& target = areas[a];
+            size_t n = target.members.size();
+            target.distance.assign(n, vector<int>());
+            target.firstHop.assign(n, vector<int>());
+            for (size_t s = 0; s < n; s++) {
+                pool.submit([&target, s]() { runSpf(target.adj, s, target.distance[s], target.firstHop[s]); });
+            }
+        }
+        pool.wait();
+
+        for (auto& entry : areas) {
+            entry.second.borderRouters.clear();
+            for (size_t i = 0; i < entry.second.members.size(); i++) {
+                if (border[entry.second.members[i]]) {
+                    entry.second.borderRouters.push_back(i);
+                }
+            }
+        }
+
+        for (int a : dirtyAreas) {
+            if (borderCosts(a) != oldSummaries[a]) {
+                backboneDirty = true;
+            }
+        }
+
+        if (backboneDirty) {
+            buildBackbone();
+        }
+
+        buildSummaries();
+
+        stats.epochs++;
+        stats.areaRecomputes += dirtyAreas.size();
+        stats.backboneRecomputes += backboneDirty ? 1 : 0;
+        lastDirtyAreas = dirtyAreas.size();
+        lastBackboneDirty = backboneDirty;
+
+    }
+
+    // Fill the routing tables with (next hop, cost) for every reachable destination
+    void fillRoutingTables(RoutingTables& routingTables) const {
+
+        size_t n = graph.names.size();
+
+        for (size_t s = 0; s < n; s++) {
+
+            map<string, pair<string, int>>& table = routingTables[graph.names[s]];
+
+            for (size_t d = 0; d < n; d++) {
+
+                int hop, cost;
+                route(s, d, hop, cost);
+
+                if (cost != INT_MAX) {
+                    table[graph.names[d]] = make_pair(s == d ? graph.names[s] : graph.names[hop], cost);
+                }
+
+            }
+
+        }
+
+    }
+
+    void report(ostream& out) const {
+        out << "areas: " << areas.size() << " areas, " << backbone.members.size() << " backbone routers, last change recomputed "
+            << lastDirtyAreas << " area(s)" << (lastBackboneDirty ? " and the backbone" : "") << "; over "
+            << stats.epochs << " epochs " << stats.areaRecomputes << " area SPF runs and "
+            << stats.backboneRecomputes << " backbone SPF runs" << endl;
+    }
+
+private:
+
+    struct Area {
+        vector<int> members;                 // global indices
+        map<int, int> local;                 // global index -> local index
+        vector<int> borderRouters;           // local indices of the area border routers
+        vector<vector<SpfEdge>> adj;         // intra-area links, hop is the global index of the neighbor
+        vector<vector<int>> distance;        // local x local
+        vector<vector<int>> firstHop;        // local x local, global index of the next hop
+    };
+
+    struct Stats {
+        size_t epochs = 0;
+        size_t areaRecomputes = 0;
+        size_t backboneRecomputes = 0;
+    };
+
+    void buildArea(int a) {
+
+        Area& target = areas[a];
+        target = Area();
+
+        for (size_t v = 0; v < graph.names.size(); v++) {
+            if (area[v] == a) {
+                target.local[v] = target.members.size();
+                target.members.push_back(v);
+            }
+        }
+
+        target.adj.resize(target.members.size());
+
+        for (size_t i = 0; i < target.members.size(); i++) {
+            for (const auto& neighbor : graph.adj[target.members[i]]) {
+                if (area[neighbor.first] == a) {
+                    target.adj[i].push_back({target.local[neighbor.first], neighbor.second, neighbor.first});
+                }
+            }
+        }
+
+    }
+
+    // Costs between every ordered pair of border routers of an area, i.e. the summary edges it feeds into the backbone
+    vector<int> borderCosts(int a) const {
+
+        vector<int> costs;
+        auto it = areas.find(a);
+
+        if (it == areas.end() || it->second.distance.empty()) {
+            return costs;
+        }
+
+        for (size_t i = 0; i < it->second.members.size(); i++) {
+            if (!border[it->second.members[i]]) {
+                continue;
+            }
+            for (size_t j = 0; j < it->second.members.size(); j++) {
+                if (border[it->second.members[j]]) {
+                    costs.push_back(it->second.members[i]);
+                    costs.push_back(it->second.distance[i][j]);
+                }
+            }
+        }
+
+        return costs;
+
+    }
+
+    void buildBackbone() {
+
+        backbone = Area();
+        backboneIndex.assign(graph.names.size(), -1);
+
+        for (size_t v = 0; v < graph.names.size(); v++) {
+            if (area[v] == 0 || border[v]) {
+                backboneIndex[v] = backbone.members.size();
+                backbone.members.push_back(v);
+            }
+        }
+
+        backbone.adj.resize(backbone.members.size());
+
+        for (size_t i = 0; i < backbone.members.size(); i++) {
+
+            int v = backbone.members[i];
+
+            // Backbone links and inter-area links
+            for (const auto& neighbor : graph.adj[v]) {
+                if (backboneIndex[neighbor.first] >= 0 && (area[v] != area[neighbor.first] || area[v] == 0)) {
+                    backbone.adj[i].push_back({backboneIndex[neighbor.first], neighbor.second, neighbor.first});
+                }
+            }
+
+            // Summary edges to the other border routers of the same area
+            if (area[v] != 0) {
+                const Area& own = areas.at(area[v]);
+                int from = own.local.at(v);
+                for (int to : own.borderRouters) {
+                    if (to != from && own.distance[from][to] != INT_MAX) {
+                        backbone.adj[i].push_back({backboneIndex[own.members[to]], own.distance[from][to], own.firstHop[from][to]});
+                    }
+                }
+            }
+
+        }
+
+        size_t n = backbone.members.size();
+        backbone.distance.assign(n, vector<int>());
+        backbone.firstHop.assign(n, vector<int>());
+
+        for (size_t s = 0; s < n; s++) {
+            pool.submit([this, s]() { runSpf(backbone.adj, s, backbone.distance[s], backbone.firstHop[s]); });
+        }
+        pool.wait();
+
+    }
+
+    // summary[x][d]: best cost from backbone router x to destination d, and the border router (or d itself) it goes through
+    void buildSummaries() {
+
+        size_t n = graph.names.size();
+        summaryCost.assign(backbone.members.size(), vector<int>(n, INT_MAX));
+        summaryVia.assign(backbone.members.size(), vector<int>(n, -1));
+
+        for (size_t x = 0; x < backbone.members.size(); x++) {
+            pool.submit([this, x, n]() {
+                for (size_t d = 0; d < n; d++) {
+                    if (backboneIndex[d] >= 0) {
+                        summaryCost[x][d] = backbone.distance[x][backboneIndex[d]];
+                        summaryVia[x][d] = d;
+                    }
+                    if (area[d] == 0) {
+                        continue;
+                    }
+                    const Area& target = areas.at(area[d]);
+                    int local = target.local.at(d);
+                    for (int b : target.borderRouters) {
+                        int toBorder = backbone.distance[x][backboneIndex[target.members[b]]];
+                        int inArea = target.distance[b][local];
+                        if (toBorder != INT_MAX && inArea != INT_MAX && toBorder + inArea < summaryCost[x][d]) {
+                            summaryCost[x][d] = toBorder + inArea;
+                            summaryVia[x][d] = target.members[b];
+                        }
+                    }
+                }
+            });
+        }
+        pool.wait();
+
+    }
+
+    // Next hop and cost from s to d: intra-area routes first, inter-area routes from the summaries otherwise
+    void route(int s, int d, int& hop, int& cost) const {
+
+        hop = -1;
+        cost = INT_MAX;
+
+        if (s == d) {
+            hop = s;
+            cost = 0;
+            return;
+        }
+
+        if (area[s] != 0 && area[s] == area[d]) {
+            const Area& own = areas.at(area[s]);
+            int from = own.local.at(s), to = own.local.at(d);
+            if (own.distance[from][to] != INT_MAX) {
+                hop = own.firstHop[from][to];
+                cost = own.distance[from][to];
+                return;
+            }
+        }
+
+        if (backboneIndex[s] >= 0) {
+            int x = backboneIndex[s];
+            int via = summaryVia[x][d];
+            if (via < 0) {
+                return;
+            }
+            cost = summaryCost[x][d];
+            if (via == s) {
+                const Area& target = areas.at(area[d]);
+                hop = target.firstHop[target.local.at(s)][target.local.at(d)];
+            } else {
+                hop = backbone.firstHop[x][backboneIndex[via]];
+            }
+            return;
+        }
+
+        // Non-backbone source: leave the area through the border router with the best total cost
+        const Area& own = areas.at(area[s]);
+        int from = own.local.at(s);
+        for (int b : own.borderRouters) {
+            int toBorder = own.distance[from][b];
+            int beyond = summaryCost[backboneIndex[own.members[b]]][d];
+            if (toBorder != INT_MAX && beyond != INT_MAX && toBorder + beyond < cost) {
+                cost = toBorder + beyond;
+                hop = own.firstHop[from][b];
+            }
+        }
+
+    }
+
+    map<string, int> areaOf;
+    ThreadPool& pool;
+    IndexedGraph graph;
+    vector<int> area;                        // global index -> area
+    vector<bool> border;                     // global index -> is an area border router
+    map<int, Area> areas;                    // non-backbone areas
+    Area backbone;                           // area 0 plus the area border routers
+    vector<int> backboneIndex;               // global index -> backbone index or -1
+    vector<vector<int>> summaryCost;
+    vector<vector<int>> summaryVia;
+    Stats stats;
+    size_t lastDirtyAreas = 0;
+    bool lastBackboneDirty = false;
+};
+
+// Link-state advertisement: the origin's adjacencies, versioned by a sequence number
+struct Lsa {
+    int sequence;
+    map<string, int> neighbors;
+};
+
+// Per-change flooding figures
+struct FloodStats {
+    int originated = 0;       // LSAs originated
+    int sent = 0;             // LSA transmissions over links
+    int duplicates = 0;       // receptions suppressed because the sequence number was not newer
+    int installed = 0;        // LSDB installations across all routers
+    int completionTime = 0;   // time of the last installation, links take their cost to cross
+    int inconsistent = 0;     // routers whose LSDB differs from the topology after flooding
+};
+
+// Cost of synchronizing the LSDBs of a new adjacency, with Merkle digests and with a full database description
+struct SyncStats {
+    int merkleRounds = 0;
+    size_t merkleBytes = 0;
+    int fullRounds = 0;
+    size_t fullBytes = 0;
+    int transferred = 0;      // LSAs copied to the side that lacked them
+};
+
+// Event-driven simulation of reliable LSA flooding. Every router keeps its own LSDB; a changed link makes
+// both ends originate a new LSA, which travels over the links (a link takes its cost in time units) and is
+// installed and re-flooded by a router only if its sequence number is newer than the installed one. In
+// reduction mode LSAs are only forwarded over the designated flooding links, a minimum spanning tree.
+class FloodingSimulator {
+public:
+
+    explicit FloodingSimulator(bool reduced) : reduced(reduced) {}
+
+    FloodStats flood(const map<string, map<string, int>>& lsdb, const vector<string>& originators) {
+
+        FloodStats stats;
+        floodingLinks = reduced ? spanningTree(lsdb) : set<pair<string, string>>();
+
+        // (time, order) keeps events deterministic; each event carries an LSA from one router to a neighbor
+        typedef pair<pair<int, long long>, size_t> Event;
+        priority_queue<Event, vector<Event>, greater<Event>> events;
+        vector<pair<pair<string, string>, pair<string, Lsa>>> payloads; // ((from, to), (origin, lsa))
+        long long order = 0;
+
+        auto send = [&](int now, const string& from, const string& origin, const Lsa& lsa, const string& except) {
+            auto adjacencies = lsdb.find(from);
+            if (adjacencies == lsdb.end()) {
+                return;
+            }
+            for (const auto& neighbor : adjacencies->second) {
+                if (neighbor.first == except || !floods(from, neighbor.first)) {
+                    continue;
+                }
+                payloads.push_back(make_pair(make_pair(from, neighbor.first), make_pair(origin, lsa)));
+                events.push(make_pair(make_pair(now + neighbor.second, order++), payloads.size() - 1));
+                stats.sent++;
+            }
+        };
+
+        for (const string& origin : originators) {
+
+            Lsa lsa;
+            lsa.sequence = ++sequence[origin];
+            auto adjacencies = lsdb.find(origin);
+            if (adjacencies != lsdb.end()) {
+                lsa.neighbors = adjacencies->second;
+            }
+
+            routerLsdbs[origin][origin] = lsa;
+            stats.originated++;
+            stats.installed++;
+            send(0, origin, origin, lsa, "");
+
+        }
+
+        // LSAs learned through a database synchronization are flooded on by the router that learned them
+        for (const auto& relay : relays) {
+            send(0, relay.first, relay.second, routerLsdbs[relay.first][relay.second], "");
+        }
+        relays.clear();
+
+        while (!events.empty()) {
+
+            int now = events.top().first.first;
+            const auto payload = payloads[events.top().second];
+            events.pop();
+
+            const string& from = payload.first.first;
+            const string& to = payload.first.second;
+            const string& origin = payload.second.first;
+            const Lsa& lsa = payload.second.second;
+
+            auto installed = routerLsdbs[to].find(origin);
+            if (installed != routerLsdbs[to].end() && installed->second.sequence >= lsa.sequence) {
+                stats.duplicates++;
+                continue;
+            }
+
+            routerLsdbs[to][origin] = lsa;
+            stats.installed++;
+            stats.completionTime = max(stats.completionTime, now);
+            send(now, to, origin, lsa, from);
+
+        }
+
+        for (const auto& entry : lsdb) {
+            if (!consistent(entry.first, lsdb)) {
+                stats.inconsistent++;
+            }
+        }
+
+        return stats;
+
+    }
+
+    // Synchronize the LSDBs of the two ends of a new adjacency with a Merkle digest exchange: LSAs are hashed
+    // into 2^depth buckets by origin, the two routers compare digests top-down one tree level per round and
+    // exchange LSA headers and then LSAs only for the buckets whose digests differ. The same synchronization
+    // done with a full database-description exchange (all headers, then the differing LSAs) is costed for
+    // comparison. Both routers end up with the newer copy of every LSA.
+    SyncStats synchronize(const string& router1, const string& router2) {
+
+        SyncStats stats;
+        map<string, Lsa>& lsdb1 = routerLsdbs[router1];
+        map<string, Lsa>& lsdb2 = routerLsdbs[router2];
+
+        int depth = 0;
+        while ((size_t(1) << depth) < max(lsdb1.size(), lsdb2.size()) && depth < 20) {
+            depth++;
+        }
+
+        vector<uint64_t> tree1 = merkleTree(lsdb1, depth);
+        vector<uint64_t> tree2 = merkleTree(lsdb2, depth);
+
+        // Round 1: roots (and LSDB sizes, which fix the tree depth)
+        stats.merkleRounds = 1;
+        stats.merkleBytes = 2 * (sizeof(uint64_t) + sizeof(uint32_t));
+
+        vector<size_t> frontier;
+        if (tree1[1] != tree2[1]) {
+            frontier.push_back(1);
+        }
+
+        for (int level = 0; level < depth && !frontier.empty(); level++) {
+
+            vector<size_t> next;
+            for (size_t node : frontier) {
+                for (size_t child = 2 * node; child <= 2 * node + 1; child++) {
+                    if (tree1[child] != tree2[child]) {
+                        next.push_back(child);
+                    }
+                }
+            }
+
+            stats.merkleRounds++;
+            stats.merkleBytes += 2 * 2 * frontier.size() * sizeof(uint64_t);
+            frontier = next;
+
+        }
+
+        // Full database description: both routers send every LSA header
+        stats.fullRounds = 1;
+        stats.fullBytes = headerBytes(lsdb1) + headerBytes(lsdb2);
+
+        if (frontier.empty()) {
+            return stats;
+        }
+
+        set<size_t> buckets(frontier.begin(), frontier.end());
+        set<string> differing;
+
+        // Headers of the differing buckets, then the LSAs the other side is missing or has an older copy of
+        stats.merkleRounds += 2;
+        for (int side = 0; side < 2; side++) {
+            const map<string, Lsa>& own = side ? lsdb2 : lsdb1;
+            for (const auto& entry : own) {
+                if (buckets.count(leaf(entry.first, depth))) {
+                    stats.merkleBytes += entry.first.size() + 1 + sizeof(uint32_t);
+                    differing.insert(entry.first);
+                }
+            }
+        }
+
+        stats.fullRounds++;
+
+        for (const string& origin : differing) {
+
+            auto lsa1 = lsdb1.find(origin);
+            auto lsa2 = lsdb2.find(origin);
+            bool newer1 = lsa1 != lsdb1.end() && (lsa2 == lsdb2.end() || lsa1->second.sequence > lsa2->second.sequence);
+            bool newer2 = lsa2 != lsdb2.end() && (lsa1 == lsdb1.end() || lsa2->second.sequence > lsa1->second.sequence);
+
+            if (newer1) {
+                size_t bytes = lsaBytes(origin, lsa1->second);
+                stats.merkleBytes += bytes;
+                stats.fullBytes += bytes;
+                stats.transferred++;
+                lsdb2[origin] = lsa1->second;
+                relays.push_back(make_pair(router2, origin));
+            } else if (newer2) {
+                size_t bytes = lsaBytes(origin, lsa2->second);
+                stats.merkleBytes += bytes;
+                stats.fullBytes += bytes;
+                stats.transferred++;
+                lsdb1[origin] = lsa2->second;
+                relays.push_back(make_pair(router1, origin));
+            }
+
+        }
+
+        return stats;
+
+    }
+
+private:
+
+    // FNV-1a hash of an LSA's origin and sequence number
+    static uint64_t lsaHash(const string& origin, int sequence) {
+        uint64_t hash = 14695981039346656037ULL;
+        string key = origin + "#" + to_string(sequence);
+        for (char c : key) {
+            hash = (hash ^ (unsigned char) c) * 1099511628211ULL;
+        }
+        return hash;
+    }
+
+    static size_t leaf(const string& origin, int depth) {
+        // A tree of depth 0 is its root alone, and shifting a 64-bit hash by 64 is undefined
+        if (depth == 0) {
+            return 1;
+        }
+        return (size_t(1) << depth) + (lsaHash(origin, 0) >> (64 - depth) & ((size_t(1) << depth) - 1));
+    }
+
+    // Heap-ordered Merkle tree: node 1 is the root, leaves are 2^depth .. 2^(depth+1)-1
+    static vector<uint64_t> merkleTree(const map<string, Lsa>& lsdb, int depth) {
+
+        size_t leaves = size_t(1) << depth;
+        vector<uint64_t> tree(2 * leaves, 0);
+
+        for (const auto& entry : lsdb) {
+            uint64_t& bucket = tree[leaf(entry.first, depth)];
+            bucket = (bucket ^ lsaHash(entry.first, entry.second.sequence)) * 1099511628211ULL + 1;
+        }
+
+        for (size_t node = leaves - 1; node >= 1; node--) {
+            tree[node] = (tree[2 * node] * 31 + tree[2 * node + 1]) ^ (tree[2 * node] >> 17);
+        }
+
+        return tree;
+
+    }
+
+    static size_t headerBytes(const map<string, Lsa>& lsdb) {
+        size_t bytes = 0;
+        for (const auto& entry : lsdb) {
+            bytes += entry.first.size() + 1 + sizeof(uint32_t);
+        }
+        return bytes;
+    }
+
+    static size_t lsaBytes(const string& origin, const Lsa& lsa) {
+        size_t bytes = origin.size() + 1 + sizeof(uint32_t);
+        for (const auto& neighbor : lsa.neighbors) {
+            bytes += neighbor.first.size() + 1 + sizeof(uint32_t);
+        }
+        return bytes;
+    }
+
+    bool floods(const string& from, const string& to) const {
+        return !reduced || floodingLinks.count(make_pair(min(from, to), max(from, to)));
+    }
+
+    // A router is consistent when it holds the current adjacencies of every router it can reach
+    bool consistent(const string& router, const map<string, map<string, int>>& lsdb) const {
+
+        auto own = routerLsdbs.find(router);
+        if (own == routerLsdbs.end()) {
+            return false;
+        }
+
+        set<string> reached;
+        vector<string> stack(1, router);
+        reached.insert(router);
+
+        while (!stack.empty()) {
+
+            string current = stack.back();
+            stack.pop_back();
+
+            auto lsa = own->second.find(current);
+            if (lsa == own->second.end() || lsa->second.neighbors != lsdb.at(current)) {
+                return false;
+            }
+
+            for (const auto& neighbor : lsdb.at(current)) {
+                if (reached.insert(neighbor.first).second) {
+                    stack.push_back(neighbor.first);
+                }
+            }
+
+        }
+
+        return true;
+
+    }
+
+    // Kruskal minimum spanning forest of the topology, used as the designated flooding links
+    static set<pair<string, string>> spanningTree(const map<string, map<string, int>>& lsdb) {
+
+        vector<pair<int, pair<string, string>>> edges;
+        for (const auto& entry : lsdb) {
+            for (const auto& neighbor : entry.second) {
+                if (entry.first < neighbor.first) {
+                    edges.push_back(make_pair(neighbor.second, make_pair(entry.first, neighbor.first)));
+                }
+            }
+        }
+        sort(edges.begin(), edges.end());
+
+        map<string, string> parent;
+        for (const auto& entry : lsdb) {
+            parent[entry.first] = entry.first;
+        }
+
+        auto find = [&](string node) {
+            while (parent[node] != node) {
+                parent[node] = parent[parent[node]];
+                node = parent[node];
+            }
+            return node;
+        };
+
+        set<pair<string, string>> tree;
+        for (const auto& edge : edges) {
+            string root1 = find(edge.second.first), root2 = find(edge.second.second);
+            if (root1 != root2) {
+                parent[root1] = root2;
+                tree.insert(edge.second);
+            }
+        }
+
+        return tree;
+
+    }
+
+    bool reduced;
+    map<string, int> sequence;                    // origin -> last sequence number it used
+    map<string, map<string, Lsa>> routerLsdbs;    // router -> (origin -> installed LSA)
+    set<pair<string, string>> floodingLinks;      // designated flooding links in reduction mode
+    vector<pair<string, string>> relays;          // (router, origin) learned by synchronization, flooded next
+};
+
+void reportSync(ostream& out, const Link& link, const SyncStats& stats) {
+    out << "sync " << link.node1 << "-" << link.node2 << ": merkle " << stats.merkleRounds << " rounds " << stats.merkleBytes
+        << " bytes, full database description " << stats.fullRounds << " rounds " << stats.fullBytes << " bytes, "
+        << stats.transferred << " LSAs transferred" << endl;
+}
+
+void reportFlooding(ostream& out, int epoch, const FloodStats& stats) {
+    out << "flooding: epoch " << epoch << ": " << stats.originated << " LSAs originated, " << stats.sent << " messages sent, "
+        << stats.duplicates << " duplicates suppressed, " << stats.installed << " installs, completed at t="
+        << stats.completionTime << (stats.inconsistent ? ", " + to_string(stats.inconsistent) + " routers inconsistent" : "") << endl;
+}
+
+// Write the path and cost of every message by forwarding it hop by hop on next-hop routing tables
+void writeForwardedMessages(ostream& outfile, const RoutingTables& routingTables, const map<string, map<string, int>>& lsdb,
+                            const vector<Message>& messages, bool blankLineAfterEach, const AnycastTables* anycast = nullptr) {
+
+    for (const auto& message : messages) {
+
+        if (writeAnycastMessage(outfile, anycast, message) || writeMulticastMessage(outfile, routingTables, message, &lsdb)) {
+            if (blankLineAfterEach) {
+                outfile << endl;
+            }
+            continue;
+        }
+
+        string shortestPath;
+        int totalCost = 0;
+
+        auto source = routingTables.find(message.source);
+
+        if (source != routingTables.end() && source->second.count(message.destination)) {
+
+            totalCost = source->second.at(message.destination).second;
+            string currentNode = source->second.at(message.destination).first;
+
+            // Forward until the destination is reached, guarding against loops
+            for (size_t hops = 0; currentNode != message.destination && hops < routingTables.size(); hops++) {
+
+                shortestPath += currentNode + " ";
+
+                auto table = routingTables.find(currentNode);
+                if (table == routingTables.end() || !table->second.count(message.destination)) {
+                    break;
+                }
+
+                currentNode = table->second.at(message.destination).first;
+
+            }
+
+        }
+
+        outfile << "from " << message.source << " to " << message.destination << " cost " << totalCost << " hops " << message.source << " " << shortestPath << message.content << "\n";
+
+        if (blankLineAfterEach) {
+            outfile << endl;
+        }
+
+    }
+
+    if (!blankLineAfterEach) {
+        outfile << "\n";
+    }
+
+}
+
+// Derive every node's FIB from the routing tables. Predecessor tables are turned into next hops per
+// source by climbing towards the source and reusing the first hop of every node already resolved;
+// area tables already hold next hops.
+Fib buildFib(const RoutingTables& routingTables, bool nextHopTables) {
+
+    Fib fib;
+
+    for (const auto& routingTable : routingTables) {
+
+        const string& source = routingTable.first;
+        map<string, string>& firstHop = fib[source];
+
+        for (const auto& entry : routingTable.second) {
+
+            if (entry.first == source || entry.second.first.empty() || entry.second.second == INT_MAX) {
+                continue;
+            }
+
+            if (nextHopTables) {
+                firstHop[entry.first] = entry.second.first;
+                continue;
+            }
+
+            vector<string> path;
+            string node = entry.first;
+
+            while (!firstHop.count(node) && path.size() < routingTables.size()) {
+
+                const pair<string, int>& hop = routingTable.second.at(node);
+                path.push_back(node);
+
+                if (hop.first == source || hop.first.empty()) {
+                    break;
+                }
+
+                node = hop.first;
+
+            }
+
+            string first = firstHop.count(node) ? firstHop[node] : path.back();
+
+            for (const string& resolved : path) {
+                firstHop[resolved] = first;
+            }
+
+        }
+
+    }
+
+    return fib;
+
+}
+
+// Count the FIB entries whose next hop differs between two epochs, including routes that appeared or disappeared
+long long countFibUpdates(const Fib& previous, const Fib& current, long long& entries) {
+
+    long long updates = 0;
+    entries = 0;
+
+    for (const auto& table : current) {
+        auto old = previous.find(table.first);
+        for (const auto& hop : table.second) {
+            entries++;
+            if (old == previous.end() || !old->second.count(hop.first) || old->second.at(hop.first) != hop.second) {
+                updates++;
+            }
+        }
+        if (old != previous.end()) {
+            for (const auto& hop : old->second) {
+                if (!table.second.count(hop.first)) {
+                    updates++;
+                }
+            }
+        }
+    }
+
+    for (const auto& table : previous) {
+        if (!current.count(table.first)) {
+            updates += table.second.size();
+        }
+    }
+
+    return updates;
+
+}
+
+// Simulate the traffic packet by packet on the current routing tables and report latency, drops and
+// link utilization.
+void simulatePackets(int epoch, const vector<Link>& topology, const RoutingTables& routingTables, bool nextHopTables,
+                     const vector<TrafficLine>& traffic, const PacketSimConfig& config) {
+
+    vector<string> names;
+    map<string, int> index;
+
+    for (const auto& routingTable : routingTables) {
+        index[routingTable.first] = names.size();
+        names.push_back(routingTable.first);
+    }
+
+    Fib fib = buildFib(routingTables, nextHopTables);
+
+    // Next hops are read from the FIB when the simulator first needs them
+    PacketSimulator simulator(names.size(), config, [&](int node, int destination) {
+        auto table = fib.find(names[node]);
+        if (table == fib.end()) {
+            return -1;
+        }
+        auto hop = table->second.find(names[destination]);
+        auto next = (hop == table->second.end()) ? index.end() : index.find(hop->second);
+        return (next == index.end()) ? -1 : next->second;
+    });
+
+    for (const auto& link : topology) {
+        if (index.count(link.node1) && index.count(link.node2)) {
+            simulator.addLink(index[link.node1], index[link.node2], link.cost);
+        }
+    }
+
+    for (const auto& line : traffic) {
+        if (index.count(line.source) && index.count(line.destination)) {
+            simulator.addFlow(index[line.source], index[line.destination], line.start, line.packets);
+        }
+    }
+
+    simulator.run();
+
+    simulator.report(cerr, epoch, names);
+
+}
+
+// The routing tables with nodes numbered 0 to n - 1 in name order: sorted neighbour lists, next hops from the
+// FIB (the router itself for its own entry, -1 if unreachable) and costs (-1 if unreachable)
+struct DenseTables {
+    vector<string> names;
+    map<string, int> index;
+    vector<vector<int>> neighbours;
+    vector<vector<int>> nextHops;
+    vector<vector<int>> costs;
+};
+
+DenseTables buildDenseTables(const vector<Link>& topology, const RoutingTables& routingTables, bool nextHopTables) {
+
+    DenseTables dense;
+
+    for (const auto& routingTable : routingTables) {
+        dense.index[routingTable.first] = dense.names.size();
+        dense.names.push_back(routingTable.first);
+    }
+
+    size_t n = dense.names.size();
+    map<string, int>& index = dense.index;
+
+    dense.neighbours.resize(n);
+    dense.nextHops.assign(n, vector<int>(n, -1));
+    dense.costs.assign(n, vector<int>(n, -1));
+
+    for (const auto& link : topology) {
+        if (index.count(link.node1) && index.count(link.node2)) {
+            dense.neighbours[index[link.node1]].push_back(index[link.node2]);
+            dense.neighbours[index[link.node2]].push_back(index[link.node1]);
+        }
+    }
+
+    for (auto& list : dense.neighbours) {
+        sort(list.begin(), list.end());
+        list.erase(unique(list.begin(), list.end()), list.end());
+    }
+
+    Fib fib = buildFib(routingTables, nextHopTables);
+
+    for (const auto& routingTable : routingTables) {
+        int r = index[routingTable.first];
+        dense.nextHops[r][r] = r;
+        for (const auto& entry : routingTable.second) {
+            if (entry.second.second != INT_MAX && index.count(entry.first)) {
+                dense.costs[r][index[entry.first]] = entry.second.second;
+            }
+        }
+        for (const auto& hop : fib[routingTable.first]) {
+            if (index.count(hop.first) && index.count(hop.second)) {
+                dense.nextHops[r][index[hop.first]] = index[hop.second];
+            }
+        }
+    }
+
+    return dense;
+
+}
+
+// Pack the FIB and costs into a PackedNextHopTable, check every lookup against the routing tables, and report
+// the size next to that of the FIB maps and of plain int arrays.
+void reportPackedTables(int epoch, const vector<Link>& topology, const RoutingTables& routingTables, bool nextHopTables) {
+
+    DenseTables dense = buildDenseTables(topology, routingTables, nextHopTables);
+    const vector<vector<int>>& nextHops = dense.nextHops;
+    const vector<vector<int>>& costs = dense.costs;
+    size_t n = dense.names.size();
+    long long fibEntries = 0;
+
+    for (size_t r = 0; r < n; r++) {
+        for (size_t d = 0; d < n; d++) {
+            if (d != r && nextHops[r][d] >= 0) {
+                fibEntries++;
+            }
+        }
+    }
+
+    PackedNextHopTable packed(dense.neighbours, nextHops, costs);
+    long long mismatches = 0;
+
+    for (size_t r = 0; r < n; r++) {
+        for (size_t d = 0; d < n; d++) {
+            if (packed.nextHop(r, d) != nextHops[r][d] || packed.cost(r, d) != costs[r][d]) {
+                mismatches++;
+            }
+        }
+    }
+
+    // A FIB entry is a node of the source's map<string, string>; the names' inline parts live in the node
+    double packedBytes = packed.memoryBytes();
+    double mapBytes = fibEntries * MemoryFootprint::treeNodeBytes<map<string, string>::value_type>();
+    double arrayBytes = static_cast<double>(n) * n * 2 * sizeof(int);
+
+    cerr << "packed: epoch " << epoch << ": " << n * n << " entries in " << packed.memoryBytes() << " bytes ("
+         << packed.averageHopBits() << " next hop bits and " << packed.averageCostBits() << " cost bits per entry); "
+         << (packedBytes > 0 ? mapBytes / packedBytes : 0) << "x smaller than the FIB maps (" << static_cast<long long>(mapBytes) << " bytes), "
+         << (packedBytes > 0 ? arrayBytes / packedBytes : 0) << "x smaller than int arrays (" << static_cast<long long>(arrayBytes) << " bytes); "
+         << mismatches << " lookups differ" << endl;
+
+}
+
+// Compress the FIB into an IntervalNextHopTable, report its size, and write the messages as writeMessages does
+// but with every hop looked up in the compressed table. The destinations follow a reverse Cuthill-McKee order,
+// or name order where that gives fewer runs; the cost of a message is still the source's table entry.
+void writeIntervalMessages(ostream& outfile, int epoch, const vector<Link>& topology, RoutingTables& routingTables,
+                           const vector<Message>& messages, bool blankLineAfterEach, const AnycastTables* anycast = nullptr) {
+
+    DenseTables dense = buildDenseTables(topology, routingTables, false);
+    size_t n = dense.names.size();
+    long long mismatches = 0;
+    vector<int> identity(n);
+
+    for (size_t i = 0; i < n; i++) {
+        identity[i] = i;
+    }
+
+    IntervalNextHopTable table(dense.nextHops, reverseCuthillMcKee(dense.neighbours));
+    IntervalNextHopTable unordered(dense.nextHops, identity);
+    size_t orderedRuns = table.runs();
+
+    if (unordered.runs() < orderedRuns) {
+        swap(table, unordered);
+    }
+
+    for (size_t r = 0; r < n; r++) {
+        for (size_t d = 0; d < n; d++) {
+            if (table.nextHop(r, d) != dense.nextHops[r][d]) {
+                mismatches++;
+            }
+        }
+    }
+
+    double denseBytes = static_cast<double>(n) * n * sizeof(int);
+
+    cerr << "interval: epoch " << epoch << ": " << n * n << " entries in " << table.runs() << " runs ("
+         << (n > 0 ? static_cast<double>(table.runs()) / n : 0) << " per router), " << table.memoryBytes() << " bytes, "
+         << (table.memoryBytes() > 0 ? denseBytes / table.memoryBytes() : 0) << "x smaller than a next hop array ("
+         << static_cast<long long>(denseBytes) << " bytes); " << orderedRuns << " runs in reverse Cuthill-McKee order, "
+         << (orderedRuns == table.runs() ? unordered.runs() : table.runs()) << " in name order; "
+         << mismatches << " lookups differ" << endl;
+
+    for (const auto& message : messages) {
+
+        if (writeAnycastMessage(outfile, anycast, message) || writeMulticastMessage(outfile, routingTables, message)) {
+            if (blankLineAfterEach) {
+                outfile << endl;
+            }
+            continue;
+        }
+
+        string shortestPath;
+        int totalCost = 0;
+
+        auto source = dense.index.find(message.source);
+        auto destination = dense.index.find(message.destination);
+
+        if (source != dense.index.end() && routingTables[message.source].count(message.destination)) {
+
+            totalCost = routingTables[message.source][message.destination].second;
+
+            // An unreachable destination has no next hop, which leaves the path empty
+            if (destination != dense.index.end()) {
+                int current = table.nextHop(source->second, destination->second);
+                for (size_t hops = 0; current >= 0 && current != destination->second && hops < n; hops++) {
+                    shortestPath += dense.names[current] + " ";
+                    current = table.nextHop(current, destination->second);
+                }
+            }
+
+        }
+
+        outfile << "from " << message.source << " to " << message.destination << " cost " << totalCost << " hops " << message.source << " " << shortestPath << message.content << "\n";
+
+        if (blankLineAfterEach) {
+            outfile << endl;
+        }
+
+    }
+
+    if (!blankLineAfterEach) {
+        outfile << "\n";
+    }
+
+}
+
+// Split the FIB into blocks shared through a DedupNextHopTable, check every lookup against the routing tables,
+// and report how many blocks are distinct. The destinations follow a reverse Cuthill-McKee order, or name order
+// where that leaves fewer distinct blocks.
+void reportDedupTables(int epoch, const vector<Link>& topology, const RoutingTables& routingTables, bool nextHopTables, size_t blockSize) {
+
+    DenseTables dense = buildDenseTables(topology, routingTables, nextHopTables);
+    size_t n = dense.names.size();
+    long long mismatches = 0;
+    vector<int> identity(n);
+
+    for (size_t i = 0; i < n; i++) {
+        identity[i] = i;
+    }
+
+    DedupNextHopTable table(dense.nextHops, reverseCuthillMcKee(dense.neighbours), blockSize);
+    DedupNextHopTable unordered(dense.nextHops, identity, blockSize);
+    size_t orderedUnique = table.uniqueBlocks();
+
+    if (unordered.uniqueBlocks() < orderedUnique) {
+        swap(table, unordered);
+    }
+
+    for (size_t r = 0; r < n; r++) {
+        for (size_t d = 0; d < n; d++) {
+            if (table.nextHop(r, d) != dense.nextHops[r][d]) {
+                mismatches++;
+            }
+        }
+    }
+
+    double denseBytes = static_cast<double>(n) * n * sizeof(int);
+
+    cerr << "dedup: epoch " << epoch << ": " << table.blockCount() << " blocks of " << blockSize << " next hops, "
+         << table.uniqueBlocks() << " distinct (" << (table.uniqueBlocks() > 0 ? static_cast<double>(table.blockCount()) / table.uniqueBlocks() : 0)
+         << "x deduplication), " << table.memoryBytes() << " bytes, "
+         << (table.memoryBytes() > 0 ? denseBytes / table.memoryBytes() : 0) << "x smaller than a next hop array ("
+         << static_cast<long long>(denseBytes) << " bytes); " << orderedUnique << " distinct in reverse Cuthill-McKee order, "
+         << (orderedUnique == table.uniqueBlocks() ? unordered.uniqueBlocks() : table.uniqueBlocks()) << " in name order; "
+         << mismatches << " lookups differ" << endl;
+
+}
+
+// Report the bytes held by the data structures, measured on the live structures, next to the resident set size.
+// Structure lines count their containers with the 32-byte inline part of every name they hold; the heap of names
+// longer than 15 characters is the node names line. Scratch is the distance map and visited set of one SPF run.
+void reportMemory(const vector<Link>& topology, const map<string, map<string, int>>& lsdb, const RoutingTables& routingTables,
+                  const vector<Message>& messages) {
+
+    MemoryFootprint footprint(lsdb.size(), topology.size());
+    size_t nameBytes = 0, names = 0, lsdbEntries = 0, tableEntries = 0, messageBytes = MemoryFootprint::vectorBytes(messages);
+
+    auto name = [&](const string& text) {
+        nameBytes += MemoryFootprint::stringBytes(text);
+        names++;
+    };
+
+    for (const auto& link : topology) {
+        name(link.node1);
+        name(link.node2);
+    }
+    for (const auto& entry : lsdb) {
+        name(entry.first);
+        for (const auto& neighbor : entry.second) {
+            name(neighbor.first);
+            lsdbEntries++;
+        }
+    }
+    for (const auto& table : routingTables) {
+        name(table.first);
+        for (const auto& entry : table.second) {
+            name(entry.first);
+            name(entry.second.first);
+            tableEntries++;
+        }
+    }
+    for (const auto& message : messages) {
+        messageBytes += MemoryFootprint::stringBytes(message.source) + MemoryFootprint::stringBytes(message.destination) +
+                        MemoryFootprint::stringBytes(message.content);
+    }
+
+    size_t scratchBytes = lsdb.size() * (MemoryFootprint::treeNodeBytes<map<string, int>::value_type>() +
+                                         MemoryFootprint::treeNodeBytes<string>());
+    for (const auto& entry : lsdb) {
+        scratchBytes += 2 * MemoryFootprint::stringBytes(entry.first);
+    }
+
+    footprint.add("node names", nameBytes, names, "name");
+    footprint.add("link store", MemoryFootprint::vectorBytes(topology), topology.size(), "link");
+    footprint.add("lsdb", lsdb.size() * MemoryFootprint::treeNodeBytes<map<string, map<string, int>>::value_type>() +
+                  lsdbEntries * MemoryFootprint::treeNodeBytes<map<string, int>::value_type>(), lsdbEntries, "entry");
+    footprint.add("routingTables", routingTables.size() * MemoryFootprint::treeNodeBytes<RoutingTables::value_type>() +
+                  tableEntries * MemoryFootprint::treeNodeBytes<RoutingTables::mapped_type::value_type>(), tableEntries, "entry");
+    footprint.add("messages", messageBytes, messages.size(), "message");
+    footprint.add("scratch", scratchBytes, lsdb.size(), "node");
+
+    footprint.write(cerr, "memory: ");
+
+    size_t resident = MemoryFootprint::residentBytes();
+    if (resident > 0) {
+        cerr << "memory: process resident set: " << resident << " bytes (" << resident / 1048576.0 << " MiB)" << endl;
+    }
+
+}
+
+// Predict the bytes of the data structures from node and link counts alone, with the model reportMemory measures by:
+// names of at most 15 characters, every link in the LSDB of both ends, and a routing table entry from every node to
+// every node. Messages are not included.
+void estimateMemory(double nodes, double links) {
+
+    MemoryFootprint footprint(nodes, links);
+
+    footprint.add("node names", 0, 2 * links + nodes + 2 * links + nodes + 2 * nodes * nodes, "name");
+    footprint.add("link store", MemoryFootprint::grownVectorBytes(links, sizeof(Link)), links, "link");
+    footprint.add("lsdb", nodes * MemoryFootprint::treeNodeBytes<map<string, map<string, int>>::value_type>() +
+                  2 * links * MemoryFootprint::treeNodeBytes<map<string, int>::value_type>(), 2 * links, "entry");
+    footprint.add("routingTables", nodes * MemoryFootprint::treeNodeBytes<RoutingTables::value_type>() +
+                  nodes * nodes * MemoryFootprint::treeNodeBytes<RoutingTables::mapped_type::value_type>(), nodes * nodes, "entry");
+    footprint.add("scratch", nodes * (MemoryFootprint::treeNodeBytes<map<string, int>::value_type>() +
+                                      MemoryFootprint::treeNodeBytes<string>()), nodes, "node");
+
+    footprint.write(cout, "estimate: ");
+
+}
+
+// Classify a change for the change-path latency statistics before it is applied. A change record toggles its link,
+// so there are no cost changes: an existing link is removed and a new one added.
+ChangeLatencyStats::ChangeType classifyChange(const Change& change, const vector<Link>& topology, const FailedRouters& failed) {
+
+    if (change.kind == RouterDown) {
+        return ChangeLatencyStats::Remove;
+    }
+    if (change.kind == RouterUp) {
+        return ChangeLatencyStats::Add;
+    }
+
+    auto sameLink = [&](const Link& l) { return l.node1 == change.link.node1 && l.node2 == change.link.node2; };
+    bool exists = any_of(topology.begin(), topology.end(), sameLink) || any_of(failed.links.begin(), failed.links.end(), sameLink);
+
+    return exists ? ChangeLatencyStats::Remove : ChangeLatencyStats::Add;
+
+}
+
+// Resident mode: keep the converged state and serve commands from a stream until "quit" or the end of the input.
+// A change record is applied, recomputed and published like an epoch of the changes file and then acknowledged with
+// "published <epoch>" on standard output; "stats" writes the change-path latency histograms to standard output, and
+// they are written to standard error at exit as well.
+void serveResident(istream& in, ostream& outfile, vector<Link>& topology, map<string, map<string, int>>& lsdb,
+                   RoutingTables& routingTables, FailedRouters& failed, const vector<Message>& messages, int epoch,
+                   const map<string, vector<string>>& groups, AnycastTables* anycast) {
+
+    typedef chrono::steady_clock Clock;
+
+    auto nanoseconds = [](Clock::time_point from, Clock::time_point to) {
+        return (uint64_t) chrono::duration_cast<chrono::nanoseconds>(to - from).count();
+    };
+
+    ChangeLatencyStats stats;
+    string line;
+    double time = 0;
+
+    while (getline(in, line)) {
+
+        auto arrival = Clock::now();
+
+        stringstream ss(line);
+        string command;
+        if (!(ss >> command)) {
+            continue;
+        }
+
+        if (command == "quit") {
+            break;
+        }
+
+        if (command == "stats") {
+            stats.write(cout);
+            continue;
+        }
+
+        Change change;
+        if (!parseChangeLine(line, change, time)) {
+            cerr << "Invalid command: " << line << endl;
+            continue;
+        }
+
+        auto hasRouter = [&](const Link& l) { return l.node1 == change.link.node1 || l.node2 == change.link.node1; };
+        if (change.kind != LinkChange && !failed.down.count(change.link.node1) &&
+            none_of(topology.begin(), topology.end(), hasRouter) && none_of(failed.links.begin(), failed.links.end(), hasRouter)) {
+            cerr << "Unknown router: " << line << endl;
+            continue;
+        }
+
+        ChangeLatencyStats::ChangeType type = classifyChange(change, topology, failed);
+        auto parsed = Clock::now();
+
+        applyChange(topology, change, failed);
+        auto applied = Clock::now();
+
+        rebuildRoutingTables(topology, lsdb, routingTables);
+        if (anycast) {
+            resolveAnycast(groups, lsdb, *anycast);
+        }
+        auto recomputed = Clock::now();
+
+        writeRoutingTables(outfile, routingTables);
+        writeMessages(outfile, routingTables, messages, true, anycast);
+        outfile.flush();
+        auto published = Clock::now();
+
+        epoch++;
+        stats.record(type, ChangeLatencyStats::Parse, nanoseconds(arrival, parsed));
+        stats.record(type, ChangeLatencyStats::Apply, nanoseconds(parsed, applied));
+        stats.record(type, ChangeLatencyStats::Recompute, nanoseconds(applied, recomputed));
+        stats.record(type, ChangeLatencyStats::Publish, nanoseconds(recomputed, published));
+        stats.record(type, ChangeLatencyStats::Total, nanoseconds(arrival, published));
+
+        cout << "published " << epoch << endl;
+
+    }
+
+    stats.write(cerr);
+
+}
+
+// One run of a batch: a topology with its own messages, changes and output file
+struct Scenario {
+    string topologyFile;
+    string messageFile;
+    string changesFile;
+    string outputFile;
+};
+
+// A parsed topology with its converged routing tables, shared read-only by the scenarios of a batch
+struct Baseline {
+    vector<Link> topology;
+    map<string, map<string, int>> lsdb;
+    RoutingTables routingTables;
+};
+
+// Read a batch manifest with one "topologyFile messageFile changesFile outputFile" line per scenario;
+// blank lines and lines starting with '#' are skipped
+vector<Scenario> parseManifestFile(const string& filename) {
+    vector<Scenario> scenarios;
+    ifstream file(filename);
+    if (!file.is_open()) {
+        cerr << "Unable to open file: " << filename << endl;
+        exit(EXIT_FAILURE);
+    }
+    string line;
+    int lineNumber = 0;
+    while (getline(file, line)) {
+        lineNumber++;
+        stringstream ss(line);
+        Scenario scenario;
+        if (!(ss >> scenario.topologyFile) || scenario.topologyFile[0] == '#') {
+            continue;
+        }
+        if (!(ss >> scenario.messageFile >> scenario.changesFile >> scenario.outputFile)) {
+            cerr << "Invalid manifest line " << lineNumber << ": " << line << endl;
+            exit(EXIT_FAILURE);
+        }
+        scenarios.push_back(scenario);
+    }
+    return scenarios;
+}
+
+// Run one scenario of a batch from its topology's converged baseline; the output is the same as that
+// of a separate run on the scenario's files
+void runScenario(const Baseline& baseline, const Scenario& scenario) {
+
+    vector<Link> topology = baseline.topology;
+    map<string, map<string, int>> lsdb = baseline.lsdb;
+    RoutingTables routingTables = baseline.routingTables;
+    vector<Message> messages = parseMessageFile(scenario.messageFile);
+    vector<double> times;
+    vector<Change> changes = parseChangesFile(scenario.changesFile, topology, times);
+    FailedRouters failed;
+
+    ofstream outfile(scenario.outputFile);
+    if (!outfile.is_open()) {
+        cerr << "Unable to open output file: " << scenario.outputFile << endl;
+        return;
+    }
+
+    writeRoutingTables(outfile, routingTables);
+    writeMessages(outfile, routingTables, messages, false);
+
+    for (const auto& change : changes) {
+        applyChange(topology, change, failed);
+        rebuildRoutingTables(topology, lsdb, routingTables);
+        writeRoutingTables(outfile, routingTables);
+        writeMessages(outfile, routingTables, messages, true);
+    }
+
+}
+
+// Run every scenario of a batch manifest. Each distinct topology is parsed and converged once and its
+// scenarios start from copies of that baseline; baselines and then scenarios run on one shared pool.
+void runBatch(const string& manifestFile, unsigned threads) {
+
+    auto begin = chrono::steady_clock::now();
+    vector<Scenario> scenarios = parseManifestFile(manifestFile);
+
+    map<string, Baseline> baselines;
+    for (const auto& scenario : scenarios) {
+        baselines[scenario.topologyFile];
+    }
+
+    ThreadPool pool(threads);
+
+    for (auto& entry : baselines) {
+        const string& topologyFile = entry.first;
+        Baseline* baseline = &entry.second;
+        pool.submit([&topologyFile, baseline]() {
+            baseline->topology = parseTopologyFile(topologyFile);
+            buildLsdb(baseline->topology, baseline->lsdb);
+            initRoutingTables(baseline->lsdb, baseline->routingTables);
+        });
+    }
+
+    pool.wait();
+
+    double baselineSeconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+
+    for (const auto& scenario : scenarios) {
+        const Baseline* baseline = &baselines.at(scenario.topologyFile);
+        const Scenario* task = &scenario;
+        pool.submit([baseline, task]() { runScenario(*baseline, *task); });
+    }
+
+    pool.wait();
+
+    cerr << "batch: " << scenarios.size() << " scenarios over " << baselines.size() << " topologies on " << pool.size()
+         << " threads; baselines converged in " << baselineSeconds << " s, all scenarios done after "
+         << chrono::duration<double>(chrono::steady_clock::now() - begin).count() << " s" << endl;
+
+}
+
+// Perform Link State Routing (LSR)
+void lsr(const string& topologyFile, const string& messageFile, const string& changesFile, const string& outputFile, const Options& options) {
+
+    History history;
+
+    vector<Link> topology = parseTopologyFile(topologyFile);
+    vector<Message> messages = parseMessageFile(messageFile);
+    vector<double> times;
+    vector<Change> changes = parseChangesFile(changesFile, topology, times);
+
+    /* cout << "Topology File Contents:" << endl;
+    for (const auto& link : topology) {
+        cout << link.node1 << " " << link.node2 << " " << link.cost << endl;
+    }
+    cout << endl;
+
+    cout << "Message File Contents:" << endl;
+    for (const auto& message : messages) {
+        cout << message.source << " " << message.destination << " " << message.content << endl;
+    }
+    cout << endl;
+
+    cout << "Changes File Contents:" << endl;
+    for (const auto& change : changes) {
+        cout << change.node1 << " " << change.node2 << " " << change.cost << endl;
+    }
+    cout << endl; */
+
+    map<string, map<string, int>> lsdb; // Link State Database: key(node) -> value(neighbor, cost)
+
+    // Routing Tables: key(node) -> value(destination, (nextHop, cost))
+    RoutingTables routingTables;
+
+    if (options.seekEpoch >= 0) {
+
+        topology.clear();
+        seekToEpoch(options.journalFile, options.seekEpoch, topology, lsdb, routingTables);
+
+        ofstream outfile(outputFile);
+        if (!outfile.is_open()) {
+            cerr << "Unable to open output file." << endl;
+            return;
+        }
+
+        AnycastTables anycastTables;
+        if (!options.groupsFile.empty()) {
+            resolveAnycast(parseGroupsFile(options.groupsFile), lsdb, anycastTables);
+        }
+
+        writeRoutingTables(outfile, routingTables);
+        writeMessages(outfile, routingTables, messages, true, options.groupsFile.empty() ? nullptr : &anycastTables);
+
+        return;
+
+    }
+
+    FailedRouters failed;
+
+    unique_ptr<FlapDamper<string>> damper;
+    vector<Link> actualTopology; // with flap damping: the links as the changes left them; topology holds the links in use
+    int recomputes = 0, recomputesAvoided = 0;
+    long long staleRoutes = 0, routeCount = 0;
+    if (options.flapDamping) {
+        damper.reset(new FlapDamper<string>(options.damping));
+        actualTopology = topology;
+    }
+
+    unique_ptr<ChangeJournal> journal;
+    if (!options.journalFile.empty()) {
+        journal.reset(new ChangeJournal(options.journalFile, options.snapshotEvery));
+    }
+
+    unique_ptr<ThreadPool> pool;
+    unique_ptr<AreaRouting> areas;
+    if (!options.areasFile.empty()) {
+        pool.reset(new ThreadPool());
+        areas.reset(new AreaRouting(parseAreasFile(options.areasFile), *pool));
+    }
+
+    map<string, vector<string>> groups;
+    AnycastTables anycastTables;
+    const AnycastTables* anycast = nullptr;
+    if (!options.groupsFile.empty()) {
+        groups = parseGroupsFile(options.groupsFile);
+        anycast = &anycastTables;
+    }
+
+    unique_ptr<FloodingSimulator> flooding;
+    if (options.flood) {
+        flooding.reset(new FloodingSimulator(options.floodReduction));
+    }
+
+    // Critical destinations; multicast destination lists contribute each of their members
+    set<string> criticalSet(options.criticalDestinations.begin(), options.criticalDestinations.end());
+    if (options.criticalFromMessages) {
+        for (const auto& message : messages) {
+            stringstream ss(message.destination);
+            string destination;
+            while (getline(ss, destination, ',')) {
+                criticalSet.insert(destination);
+            }
+        }
+    }
+    vector<string> critical(criticalSet.begin(), criticalSet.end());
+
+    buildLsdb(topology, lsdb);
+
+    if (flooding) {
+        vector<string> originators;
+        for (const auto& entry : lsdb) {
+            originators.push_back(entry.first);
+        }
+        reportFlooding(cerr, 0, flooding->flood(lsdb, originators));
+    }
+
+    auto computeStart = chrono::steady_clock::now();
+    CriticalRoutes published = routeCriticalDestinations(0, lsdb, critical);
+    double criticalSeconds = chrono::duration<double>(chrono::steady_clock::now() - computeStart).count();
+
+    if (areas) {
+        areas->update(lsdb, nullptr);
+        areas->fillRoutingTables(routingTables);
+    } else {
+        initRoutingTables(lsdb, routingTables);
+    }
+
+    if (!critical.empty()) {
+        reportCriticalRoutes(cerr, 0, published, routingTables, criticalSeconds,
+                             chrono::duration<double>(chrono::steady_clock::now() - computeStart).count());
+    }
+
+    if (anycast) {
+        resolveAnycast(groups, lsdb, anycastTables);
+    }
+
+    vector<TrafficLine> traffic;
+    if (!options.trafficFile.empty()) {
+        if (!readTrafficFile(options.trafficFile, traffic)) {
+            cerr << "Unable to open file: " << options.trafficFile << endl;
+            exit(EXIT_FAILURE);
+        }
+        simulatePackets(0, topology, routingTables, areas != nullptr, traffic, options.packetSim);
+    }
+
+    Fib fib;
+    long long fibUpdates = 0, fibEntries = 0;
+    if (options.fibUpdates) {
+        fib = buildFib(routingTables, areas != nullptr);
+        countFibUpdates(Fib(), fib, fibEntries);
+        cerr << "fib: epoch 0: " << fibEntries << " entries installed" << endl;
+    }
+
+    if (options.keepHistory) {
+        recordEpoch(history, routingTables);
+    }
+
+    if (journal) {
+        journal->recordEpoch(0, topology, failed, routingTables);
+    }
+
+    if (options.memoryReport) {
+        reportMemory(topology, lsdb, routingTables, messages);
+    }
+
+    if (options.packedTables) {
+        reportPackedTables(0, topology, routingTables, areas != nullptr);
+    }
+
+    if (options.dedupBlock > 0) {
+        reportDedupTables(0, topology, routingTables, areas != nullptr, options.dedupBlock);
+    }
+
+    /* 
+
+    for (const auto& routingTable : routingTables) {
+        std::cout << "Routing table for node " << routingTable.first << ":\n";
+        for (const auto& entry : routingTable.second) {
+            std::cout << "" << entry.first << " " << entry.second.first << " " << entry.second.second << "\n";
+        }
+        std::cout << "\n";
+    }
+    
+    */
+    
+    ofstream outfile(outputFile);
+    if (outfile.is_open()) {
+
+        writeRoutingTables(outfile, routingTables);
+
+        if (areas) {
+            writeForwardedMessages(outfile, routingTables, lsdb, messages, false, anycast);
+        } else if (options.intervalTables) {
+            writeIntervalMessages(outfile, 0, topology, routingTables, messages, false, anycast);
+        } else {
+            writeMessages(outfile, routingTables, messages, false, anycast);
+        }
+
+        // Apply changes; every change is an epoch, and so is the release of held-down links before the next change
+        // or after the last one
+        int epoch = 0;
+        size_t next = 0;
+        const double never = numeric_limits<double>::infinity();
+
+        while (next < changes.size() || (damper && damper->nextRelease() < never)) {
+
+            epoch++;
+
+            double time = (next < changes.size()) ? times[next] : never;
+            TopologyDelta delta;
+            const Link* changedLink = nullptr;
+
+            if (damper && damper->nextRelease() < time) {
+                releaseDampedLinks(*damper, damper->nextRelease(), epoch);
+                delta = selectDampedLinks(*damper, actualTopology, topology);
+            } else {
+                const Change& change = changes[next++];
+                if (journal) {
+                    journal->recordChange(epoch, change);
+                }
+                if (damper) {
+                    delta = applyDampedChange(change, time, epoch, *damper, actualTopology, failed, topology);
+                } else {
+                    delta = applyChange(topology, change, failed);
+                }
+                if (change.kind == LinkChange) {
+                    changedLink = &change.link;
+                }
+            }
+
+            // Under damping a change that leaves the topology in use alone keeps the current tables
+            bool recompute = !damper || !delta.added.empty() || !delta.removed.empty();
+            if (recompute) {
+                recomputes++;
+            } else {
+                recomputesAvoided++;
+            }
+
+            // Every new adjacency first synchronizes the LSDBs of its two ends
+            if (flooding && options.lsdbSync) {
+                for (const auto& link : delta.added) {
+                    reportSync(cerr, link, flooding->synchronize(link.node1, link.node2));
+                }
+            }
+
+            // The ends of every added or removed link originate a new LSA
+            if (flooding && recompute) {
+                set<string> originators;
+                for (const auto& links : {delta.added, delta.removed}) {
+                    for (const auto& link : links) {
+                        originators.insert(link.node1);
+                        originators.insert(link.node2);
+                    }
+                }
+                buildLsdb(topology, lsdb);
+                reportFlooding(cerr, epoch, flooding->flood(lsdb, vector<string>(originators.begin(), originators.end())));
+            }
+
+            // Routes to the critical destinations are published before the full tables
+            computeStart = chrono::steady_clock::now();
+            if (recompute && !critical.empty()) {
+                buildLsdb(topology, lsdb);
+                published = routeCriticalDestinations(epoch, lsdb, critical);
+            }
+            criticalSeconds = chrono::duration<double>(chrono::steady_clock::now() - computeStart).count();
+
+            // Update routing tables based on modified topology
+            if (!recompute) {
+                // The topology in use did not change
+            } else if (areas) {
+                buildLsdb(topology, lsdb);
+                routingTables.clear();
+                areas->update(lsdb, changedLink);
+                areas->fillRoutingTables(routingTables);
+                areas->report(cerr);
+            } else if (options.sticky) {
+                RoutingTables previous;
+                previous.swap(routingTables);
+                rebuildRoutingTables(topology, lsdb, routingTables, &previous);
+            } else {
+                rebuildRoutingTables(topology, lsdb, routingTables);
+            }
+
+            if (options.fibUpdates) {
+                Fib previousFib;
+                previousFib.swap(fib);
+                fib = buildFib(routingTables, areas != nullptr);
+                long long updates = countFibUpdates(previousFib, fib, fibEntries);
+                fibUpdates += updates;
+                cerr << "fib: epoch " << epoch << ": " << updates << " of " << fibEntries << " next hops changed" << endl;
+            }
+
+            if (recompute && !critical.empty()) {
+                reportCriticalRoutes(cerr, epoch, published, routingTables, criticalSeconds,
+                                     chrono::duration<double>(chrono::steady_clock::now() - computeStart).count());
+            }
+
+            if (anycast && recompute) {
+                resolveAnycast(groups, lsdb, anycastTables);
+            }
+
+            if (damper) {
+                staleRoutes += countStaleRoutes(routingTables, actualTopology, routeCount);
+            }
+
+            if (!options.trafficFile.empty()) {
+                simulatePackets(epoch, topology, routingTables, areas != nullptr, traffic, options.packetSim);
+            }
+
+            if (options.packedTables) {
+                reportPackedTables(epoch, topology, routingTables, areas != nullptr);
+            }
+
+            if (options.dedupBlock > 0) {
+                reportDedupTables(epoch, topology, routingTables, areas != nullptr, options.dedupBlock);
+            }
+
+            if (options.keepHistory) {
+                recordEpoch(history, routingTables);
+            }
+
+            if (journal) {
+                journal->recordEpoch(epoch, topology, failed, routingTables);
+            }
+
+            writeRoutingTables(outfile, routingTables);
+
+            // Output messages based on the modified topology
+            if (areas) {
+                writeForwardedMessages(outfile, routingTables, lsdb, messages, true, anycast);
+            } else if (options.intervalTables) {
+                writeIntervalMessages(outfile, epoch, topology, routingTables, messages, true, anycast);
+            } else {
+                writeMessages(outfile, routingTables, messages, true, anycast);
+            }
+
+        }
+
+        if (options.resident) {
+            serveResident(cin, outfile, topology, lsdb, routingTables, failed, messages, epoch, groups, anycast ? &anycastTables : nullptr);
+        }
+
+        outfile.close();
+    } else {
+        cerr << "Unable to open output file." << endl;
+    }
+
+    if (options.fibUpdates) {
+        cerr << "fib: " << changes.size() << " changes, " << fibUpdates << " FIB updates" << endl;
+    }
+
+    if (damper) {
+        cerr << "damping: " << changes.size() << " changes, " << damper->getFlaps() << " link flaps, " << damper->getSuppressions()
+             << " suppressions, " << recomputes << " recomputes, " << recomputesAvoided << " avoided; " << staleRoutes << " of "
+             << routeCount << " routes (" << (routeCount > 0 ? 100.0 * staleRoutes / routeCount : 0)
+             << "%) differed from undamped routing" << endl;
+    }
+
+    if (options.keepHistory) {
+
+        reportHistory(history);
+
+        if (options.queryEpoch >= 0) {
+
+            if ((size_t) options.queryEpoch >= history.epochCount()) {
+                cerr << "Epoch " << options.queryEpoch << " was never recorded." << endl;
+                exit(EXIT_FAILURE);
+            }
+
+            writeEpoch(cout, history, options.queryEpoch);
+
+        }
+
+    }
+
+}
+
+void printUsage(const char* program) {
+    cerr << "Usage: " << program << " [options] <topologyFile> <messageFile> <changesFile> [<outputFile>]\n"
+         << "       " << program << " --batch MANIFEST [--batch-threads N]\n"
+         << "       " << program << " --memory-estimate NODES LINKS\n"
+         << "Options:\n"
+         << "  --history          record the routing tables of every epoch and report the history size\n"
+         << "  --query-epoch N    print the recorded routing tables of epoch N (implies --history)\n"
+         << "  --journal FILE     write every change and periodic snapshots to FILE (index in FILE.idx)\n"
+         << "  --snapshot-every K snapshot the routing state every K epochs in the journal (default 16)\n"
+         << "  --seek-epoch N     restore epoch N from the journal given with --journal and output it\n"
+         << "  --areas FILE       route hierarchically with the \"router area\" map in FILE (area 0 is the backbone)\n"
+         << "  --flood            simulate LSA flooding for every change and report its cost\n"
+         << "  --flood-reduction  flood only over designated flooding links (implies --flood)\n"
+         << "  --lsdb-sync        synchronize LSDBs over every new link with a Merkle digest exchange (implies --flood)\n"
+         << "  --groups FILE      anycast groups, one \"group member member ...\" line each; messages to a group go to its nearest member\n"
+         << "  --packet-sim FILE  simulate the \"time source destination packets\" traffic in FILE packet by packet every epoch\n"
+         << "  --link-bandwidth B link bandwidth in megabits per second (default 100)\n"
+         << "  --link-delay US    propagation delay in microseconds per unit of link cost (default 100)\n"
+         << "  --queue-limit N    packets a link queues behind the one being transmitted (default 64)\n"
+         << "  --packet-size N    packet size in bytes (default 1500)\n"
+         << "  --flap-damping     hold down flapping links instead of recomputing on every change (not with --journal)\n"
+         << "  --half-life S      half-life of the flap penalty in seconds (default 15; implies --flap-damping)\n"
+         << "  --suppress P       penalty at which a link is held down, 1000 per change (default 2000; implies --flap-damping)\n"
+         << "  --reuse P          penalty below which a held-down link is released (default 750; implies --flap-damping)\n"
+         << "  --critical D1,D2   compute the routes to these destinations first and write them to standard output;\n"
+         << "                     \"messages\" adds the message destinations\n"
+         << "  --fib-updates      report the next hops that changed in every epoch\n"
+         << "  --sticky           keep the previous next hop while it remains optimal (implies --fib-updates; not with --journal or --areas)\n"
+         << "  --batch MANIFEST   run the \"topologyFile messageFile changesFile outputFile\" scenarios in MANIFEST concurrently\n"
+         << "  --batch-threads N  threads running the scenarios of --batch (default: hardware threads)\n"
+         << "  --resident         after the changes file, apply changes read from standard input and report latency on \"stats\"\n"
+         << "                     (not with --journal, --areas or --flap-damping)\n"
+         << "  --memory-report    report the bytes of every data structure after the initial convergence\n"
+         << "  --memory-estimate NODES LINKS  predict the bytes of the data structures without running\n"
+         << "  --packed-tables    pack the tables of every epoch into bit-packed neighbour indices and report their size\n"
+         << "  --interval-tables  write the messages from next hop runs in reverse Cuthill-McKee order and report their size\n"
+         << "                     (not with --areas)\n"
+         << "  --dedup-tables B   share equal blocks of B next hops between routers every epoch and report the savings" << endl;
+}
+
+int main(int argc, char** argv) {
+
+    Options options;
+    vector<string> arguments;
+
+    for (int i = 1; i < argc; i++) {
+
+        string arg = argv[i];
+
+        if (arg == "--history") {
+            options.keepHistory = true;
+        } else if (arg == "--query-epoch" && i + 1 < argc) {
+            options.keepHistory = true;
+            options.queryEpoch = atoi(argv[++i]);
+        } else if (arg == "--journal" && i + 1 < argc) {
+            options.journalFile = argv[++i];
+        } else if (arg == "--snapshot-every" && i + 1 < argc) {
+            options.snapshotEvery = max(1, atoi(argv[++i]));
+        } else if (arg == "--seek-epoch" && i + 1 < argc) {
+            options.seekEpoch = atoi(argv[++i]);
+        } else if (arg == "--areas" && i + 1 < argc) {
+            options.areasFile = argv[++i];
+        } else if (arg == "--flood") {
+            options.flood = true;
+        } else if (arg == "--flood-reduction") {
+            options.flood = true;
+            options.floodReduction = true;
+        } else if (arg == "--lsdb-sync") {
+            options.flood = true;
+            options.lsdbSync = true;
+        } else if (arg == "--groups" && i + 1 < argc) {
+            options.groupsFile = argv[++i];
+        } else if (arg == "--packet-sim" && i + 1 < argc) {
+            options.trafficFile = argv[++i];
+        } else if (arg == "--link-bandwidth" && i + 1 < argc) {
+            options.packetSim.bandwidth = max(1e-3, atof(argv[++i]));
+        } else if (arg == "--link-delay" && i + 1 < argc) {
+            options.packetSim.delayPerCost = max(0.0, atof(argv[++i]));
+        } else if (arg == "--queue-limit" && i + 1 < argc) {
+            options.packetSim.queueLimit = max(0, atoi(argv[++i]));
+        } else if (arg == "--packet-size" && i + 1 < argc) {
+            options.packetSim.packetBytes = max(1, atoi(argv[++i]));
+        } else if (arg == "--flap-damping") {
+            options.flapDamping = true;
+        } else if (arg == "--half-life" && i + 1 < argc) {
+            options.flapDamping = true;
+            options.damping.halfLife = max(1e-3, atof(argv[++i]));
+        } else if (arg == "--suppress" && i + 1 < argc) {
+            options.flapDamping = true;
+            options.damping.suppress = atof(argv[++i]);
+        } else if (arg == "--reuse" && i + 1 < argc) {
+            options.flapDamping = true;
+            options.damping.reuse = atof(argv[++i]);
+        } else if (arg == "--fib-updates") {
+            options.fibUpdates = true;
+        } else if (arg == "--sticky") {
+            options.sticky = true;
+            options.fibUpdates = true;
+        } else if (arg == "--memory-report") {
+            options.memoryReport = true;
+        } else if (arg == "--packed-tables") {
+            options.packedTables = true;
+        } else if (arg == "--interval-tables") {
+            options.intervalTables = true;
+        } else if (arg == "--dedup-tables" && i + 1 < argc) {
+            options.dedupBlock = atoi(argv[++i]);
+        } else if (arg == "--memory-estimate" && i + 2 < argc) {
+            options.estimateNodes = atof(argv[++i]);
+            options.estimateLinks = atof(argv[++i]);
+        } else if (arg == "--resident") {
+            options.resident = true;
+        } else if (arg == "--batch" && i + 1 < argc) {
+            options.manifestFile = argv[++i];
+        } else if (arg == "--batch-threads" && i + 1 < argc) {
+            options.batchThreads = atoi(argv[++i]);
+        } else if (arg == "--critical" && i + 1 < argc) {
+            stringstream list(argv[++i]);
+            string destination;
+            while (getline(list, destination, ',')) {
+                if (destination == "messages") {
+                    options.criticalFromMessages = true;
+                } else if (!destination.empty()) {
+                    options.criticalDestinations.push_back(destination);
+                }
+            }
+        } else if (arg.compare(0, 2, "--") == 0) {
+            printUsage(argv[0]);
+            return 1;
+        } else {
+            arguments.push_back(arg);
+        }
+
+    }
+
+    if (options.estimateNodes >= 0 && arguments.empty()) {
+        estimateMemory(options.estimateNodes, options.estimateLinks);
+        return 0;
+    }
+
+    if (!options.manifestFile.empty() && arguments.empty()) {
+        runBatch(options.manifestFile, options.batchThreads);
+        return 0;
+    }
+
+    if ((arguments.size() != 3 && arguments.size() != 4) || (options.seekEpoch >= 0 && (options.journalFile.empty() || !options.areasFile.empty())) ||
+        (options.flapDamping && !options.journalFile.empty()) ||
+        (options.sticky && (!options.journalFile.empty() || !options.areasFile.empty())) || !options.manifestFile.empty() ||
+        (options.intervalTables && !options.areasFile.empty()) ||
+        (options.resident && (!options.journalFile.empty() || !options.areasFile.empty() || options.flapDamping))) {
+        printUsage(argv[0]);
         return 1;
     }
 
-    string topologyFile = argv[1];
-    string messageFile = argv[2];
-    string changesFile = argv[3];
+    string topologyFile = arguments[0];
+    string messageFile = arguments[1];
+    string changesFile = arguments[2];
     string outputFile;
 
-    if (argc == 5) {
-        outputFile = argv[4];
+    if (arguments.size() == 4) {
+        outputFile = arguments[3];
     } else {
         outputFile = "output.txt";
     }
 
-    lsr(topologyFile, messageFile, changesFile, outputFile);
+    lsr(topologyFile, messageFile, changesFile, outputFile, options);
 
     return 0;
 }
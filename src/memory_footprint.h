@@ -0,0 +1,203 @@
+/**
+ * @file memory_footprint.h
+ * @brief Byte accounting of standard containers and a report of the footprint per data structure.
+ *
+ * Sizes follow libstdc++ with glibc malloc on a 64-bit system. A map or set node holds a 32-byte
+ * header (color and three pointers) before its value. A string keeps up to 15 characters inline
+ * and allocates capacity + 1 bytes beyond that. A vector allocates its capacity, which grows by
+ * doubling. Every allocation takes a malloc chunk of the request plus an 8-byte header, rounded up
+ * to 16 bytes, with a minimum of 32. The same rules serve both measurement of live structures and
+ * estimates from node and link counts, so the two agree wherever the counts do.
+ */
+
+#ifndef MEMORY_FOOTPRINT_H
+#define MEMORY_FOOTPRINT_H
+
+#include <cstddef>
+#include <fstream>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+/**
+ * @class MemoryFootprint
+ * @brief Collects the bytes of named data structures and writes them with their per-unit cost.
+ */
+class MemoryFootprint {
+public:
+
+    /**
+     * @param request The bytes requested from the allocator.
+     * @return The bytes the allocation occupies, 0 for an empty request.
+     */
+    static std::size_t
+    allocationBytes(std::size_t request) {
+
+        if (request == 0) return 0;
+
+        std::size_t chunk = (request + 8 + 15) & ~static_cast<std::size_t>(15);
+
+        return chunk < 32 ? 32 : chunk;
+
+    }
+
+    /**
+     * @tparam Value The value type of the node, e.g. std::map<K, V>::value_type.
+     * @return The bytes of one node of a map or set.
+     */
+    template <typename Value>
+    static std::size_t
+    treeNodeBytes() {
+
+        return allocationBytes(32 + sizeof(Value));
+
+    }
+
+    /**
+     * @return The heap bytes of a string; its inline part belongs to the object holding it.
+     */
+    static std::size_t
+    stringBytes(const std::string &text) {
+
+        return text.capacity() > 15 ? allocationBytes(text.capacity() + 1) : 0;
+
+    }
+
+    /**
+     * @param length The length of a string built by copying.
+     * @return The heap bytes of such a string.
+     */
+    static std::size_t
+    stringBytes(std::size_t length) {
+
+        return length > 15 ? allocationBytes(length + 1) : 0;
+
+    }
+
+    /**
+     * @return The heap bytes of a vector's buffer, excluding heap memory owned by its elements.
+     */
+    template <typename T>
+    static std::size_t
+    vectorBytes(const std::vector<T> &items) {
+
+        return allocationBytes(items.capacity() * sizeof(T));
+
+    }
+
+    /**
+     * @param count The number of elements appended one by one to an empty vector.
+     * @param elementBytes The size of an element.
+     * @return The heap bytes of the vector's buffer.
+     */
+    static std::size_t
+    grownVectorBytes(std::size_t count, std::size_t elementBytes) {
+
+        std::size_t capacity = 0;
+
+        if (count > 0) for (capacity = 1; capacity < count; capacity *= 2) {}
+
+        return allocationBytes(capacity * elementBytes);
+
+    }
+
+    /**
+     * @return The resident set size of this process, or 0 where /proc is not available.
+     */
+    static std::size_t
+    residentBytes() {
+
+        std::ifstream statm("/proc/self/statm");
+        std::size_t size = 0, resident = 0;
+
+        if (!(statm >> size >> resident)) return 0;
+
+        return resident * static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+
+    }
+
+    /**
+     * @param nodes The number of nodes the per-node cost of the total refers to.
+     * @param links The number of links the per-link cost of the total refers to.
+     */
+    MemoryFootprint(double nodes, double links) : nodes(nodes), links(links) {}
+
+    /**
+     * Adds a data structure to the report.
+     * @param name The name of the structure.
+     * @param bytes Its bytes.
+     * @param units The number of units the structure holds, e.g. its entries.
+     * @param unit The name of a unit, e.g. "entry".
+     */
+    void
+    add(const std::string &name, double bytes, double units, const std::string &unit) {
+
+        structures.push_back({name, bytes, units, unit});
+
+    }
+
+    /**
+     * @return The bytes of all structures added.
+     */
+    double
+    totalBytes() const {
+
+        double total = 0;
+
+        for (const auto &structure : structures) total += structure.bytes;
+
+        return total;
+
+    }
+
+    /**
+     * Writes one line per structure and the total.
+     * @param out The stream to write to.
+     * @param prefix The start of every line, e.g. "memory: ".
+     */
+    void
+    write(std::ostream &out, const std::string &prefix) const {
+
+        for (const auto &structure : structures) {
+
+            out << prefix << structure.name << ": " << static_cast<long long>(structure.bytes) << " bytes ("
+                << structure.bytes / 1048576 << " MiB), " << static_cast<long long>(structure.units) << " x " << structure.unit;
+
+            if (structure.units > 0) out << ", " << structure.bytes / structure.units << " bytes per " << structure.unit;
+
+            out << "\n";
+
+        }
+
+        double total = totalBytes();
+
+        out << prefix << "total: " << static_cast<long long>(total) << " bytes (" << total / 1048576 << " MiB)";
+
+        if (nodes > 0) out << ", " << total / nodes << " bytes per node";
+        if (links > 0) out << ", " << total / links << " bytes per link";
+
+        out << "\n";
+        out.flush();
+
+    }
+
+private:
+
+    /**
+     * @struct Structure
+     * @brief One line of the report.
+     */
+    struct Structure {
+        std::string name;
+        double bytes;
+        double units;
+        std::string unit;
+    };
+
+    double nodes;
+    double links;
+    std::vector<Structure> structures;
+};
+
+#endif
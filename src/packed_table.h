@@ -0,0 +1,243 @@
+/**
+ * @file packed_table.h
+ * @brief All-pairs routing tables with next hops stored as bit-packed neighbour indices.
+ *
+ * A next hop is always a neighbour of the router, so every router keeps a sorted list of its next
+ * hops and stores, per destination, the index into that list in ceil(log2(degree + 1)) bits. The
+ * extra code stands for "no next hop": the router itself, or an unreachable destination. Costs are
+ * stored apart in the fewest bits that hold the router's largest finite cost, with the all-ones
+ * code for unreachable. A lookup reads one or two 64-bit words per array and stays O(1).
+ */
+
+#ifndef PACKED_TABLE_H
+#define PACKED_TABLE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @class PackedNextHopTable
+ * @brief Next hops and costs of n routers toward n destinations, numbered 0 to n - 1, in packed form.
+ */
+class PackedNextHopTable {
+public:
+
+    /**
+     * @param neighbours The neighbours of every router. Next hops outside a router's list are added to it.
+     * @param nextHops nextHops[r][d]: the next hop of router r toward d, r itself for d == r, or -1 if unreachable.
+     * @param costs costs[r][d]: the cost of router r toward d, or -1 if unreachable.
+     */
+    PackedNextHopTable(const std::vector<std::vector<int>> &neighbours, const std::vector<std::vector<int>> &nextHops,
+                       const std::vector<std::vector<int>> &costs) : routers(nextHops.size()) {
+
+        uint64_t hopBitsTotal = 0, costBitsTotal = 0;
+
+        for (std::size_t r = 0; r < routers.size(); ++r) {
+
+            std::vector<int> list = neighbours[r];
+
+            for (int hop : nextHops[r]) {
+                if (hop >= 0 && hop != static_cast<int>(r)) list.push_back(hop);
+            }
+
+            std::sort(list.begin(), list.end());
+            list.erase(std::unique(list.begin(), list.end()), list.end());
+
+            int maxCost = 0;
+
+            for (int cost : costs[r]) maxCost = std::max(maxCost, cost);
+
+            Router &router = routers[r];
+
+            router.listBegin = hops.size();
+            router.listSize = list.size();
+            router.hopBits = bitsFor(list.size());
+            router.costBits = bitsFor(static_cast<uint64_t>(maxCost) + 1);
+            router.hopOffset = hopBitsTotal;
+            router.costOffset = costBitsTotal;
+
+            hops.insert(hops.end(), list.begin(), list.end());
+            hopBitsTotal += static_cast<uint64_t>(router.hopBits) * nextHops[r].size();
+            costBitsTotal += static_cast<uint64_t>(router.costBits) * costs[r].size();
+
+        }
+
+        hopWords.assign((hopBitsTotal + 63) / 64 + 1, 0);
+        costWords.assign((costBitsTotal + 63) / 64 + 1, 0);
+
+        for (std::size_t r = 0; r < routers.size(); ++r) {
+
+            const Router &router = routers[r];
+            auto first = hops.begin() + router.listBegin, last = first + router.listSize;
+
+            for (std::size_t d = 0; d < nextHops[r].size(); ++d) {
+
+                int hop = nextHops[r][d];
+                uint64_t code = (hop < 0 || hop == static_cast<int>(r)) ? router.listSize : std::lower_bound(first, last, hop) - first;
+
+                writeBits(hopWords, router.hopOffset + d * router.hopBits, router.hopBits, code);
+
+            }
+
+            uint64_t unreachable = (1ULL << router.costBits) - 1;
+
+            for (std::size_t d = 0; d < costs[r].size(); ++d) {
+                writeBits(costWords, router.costOffset + d * router.costBits, router.costBits, costs[r][d] < 0 ? unreachable : costs[r][d]);
+            }
+
+        }
+
+        hopWords.shrink_to_fit();
+        costWords.shrink_to_fit();
+        hops.shrink_to_fit();
+
+    }
+
+    /**
+     * @return The next hop of a router toward a destination, the router itself for its own entry, or -1 if unreachable.
+     */
+    int
+    nextHop(int router, int destination) const {
+
+        const Router &entry = routers[router];
+        uint64_t code = readBits(hopWords, entry.hopOffset + static_cast<uint64_t>(destination) * entry.hopBits, entry.hopBits);
+
+        if (code < entry.listSize) return hops[entry.listBegin + code];
+
+        return (destination == router) ? router : -1;
+
+    }
+
+    /**
+     * @return The cost of a router toward a destination, or -1 if unreachable.
+     */
+    int
+    cost(int router, int destination) const {
+
+        const Router &entry = routers[router];
+        uint64_t code = readBits(costWords, entry.costOffset + static_cast<uint64_t>(destination) * entry.costBits, entry.costBits);
+
+        return (code == (1ULL << entry.costBits) - 1) ? -1 : static_cast<int>(code);
+
+    }
+
+    /**
+     * @return The number of routers.
+     */
+    std::size_t
+    size() const {
+
+        return routers.size();
+
+    }
+
+    /**
+     * @return The bytes of the packed arrays, the next hop lists and the per-router headers.
+     */
+    std::size_t
+    memoryBytes() const {
+
+        return (hopWords.capacity() + costWords.capacity()) * sizeof(uint64_t) + hops.capacity() * sizeof(int) +
+               routers.capacity() * sizeof(Router);
+
+    }
+
+    /**
+     * @return The mean bits per next hop over all entries.
+     */
+    double
+    averageHopBits() const {
+
+        return averageBits(&Router::hopBits);
+
+    }
+
+    /**
+     * @return The mean bits per cost over all entries.
+     */
+    double
+    averageCostBits() const {
+
+        return averageBits(&Router::costBits);
+
+    }
+
+private:
+
+    /**
+     * @struct Router
+     * @brief Where a router's entries and next hop list live and how wide they are.
+     */
+    struct Router {
+        uint64_t hopOffset = 0;     ///< Bit offset of the first next hop code in hopWords.
+        uint64_t costOffset = 0;    ///< Bit offset of the first cost in costWords.
+        uint32_t listBegin = 0;     ///< First next hop of the router in hops.
+        uint32_t listSize = 0;      ///< Number of next hops; this code stands for no next hop.
+        uint8_t hopBits = 0;
+        uint8_t costBits = 0;
+    };
+
+    /**
+     * @return The fewest bits that hold every value from 0 to value.
+     */
+    static uint8_t
+    bitsFor(uint64_t value) {
+
+        uint8_t bits = 0;
+
+        while (bits < 64 && (value >> bits) != 0) ++bits;
+
+        return bits;
+
+    }
+
+    static uint64_t
+    readBits(const std::vector<uint64_t> &words, uint64_t offset, unsigned width) {
+
+        if (width == 0) return 0;
+
+        uint64_t index = offset >> 6;
+        unsigned shift = offset & 63;
+        uint64_t value = words[index] >> shift;
+
+        if (shift + width > 64) value |= words[index + 1] << (64 - shift);
+
+        return value & ((1ULL << width) - 1);
+
+    }
+
+    static void
+    writeBits(std::vector<uint64_t> &words, uint64_t offset, unsigned width, uint64_t value) {
+
+        if (width == 0) return;
+
+        uint64_t index = offset >> 6;
+        unsigned shift = offset & 63;
+
+        words[index] |= value << shift;
+
+        if (shift + width > 64) words[index + 1] |= value >> (64 - shift);
+
+    }
+
+    double
+    averageBits(uint8_t Router::*field) const {
+
+        double bits = 0;
+
+        // Every router has an entry for every destination, so the mean over routers is the mean over entries
+        for (const auto &router : routers) bits += router.*field;
+
+        return routers.empty() ? 0 : bits / routers.size();
+
+    }
+
+    std::vector<Router> routers;
+    std::vector<int> hops;              ///< The next hop lists of all routers, back to back.
+    std::vector<uint64_t> hopWords;
+    std::vector<uint64_t> costWords;
+};
+
+#endif
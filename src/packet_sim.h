@@ -0,0 +1,586 @@
+/**
+ * @file packet_sim.h
+ * @brief Packet-level discrete-event simulation of message delivery over the routing tables.
+ *
+ * Every link is a pair of one-way channels with a bandwidth, a propagation delay and a bounded
+ * FIFO queue. Flows inject packets at a source at line rate from a given start time; routers
+ * forward each packet on the next hop of the current routing tables. The event core keeps 24-byte
+ * events in a binary heap, packets in a recycled pool and queues in ring buffers. Packets on the
+ * wire of a channel arrive in the order they were sent, so only the first of them is in the heap;
+ * the heap stays at about one event per channel and flow, whatever the load. Memory grows with the
+ * links and the traffic, not with the square of the nodes: channels are found through per-node
+ * neighbour lists, and next hops are asked of the caller's own tables once per node and destination.
+ */
+
+#ifndef PACKET_SIM_H
+#define PACKET_SIM_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * @struct PacketSimConfig
+ * @brief Link and packet parameters shared by all links of a simulation.
+ */
+struct PacketSimConfig {
+    double bandwidth = 100;             ///< Link bandwidth in megabits per second.
+    double delayPerCost = 100;          ///< Propagation delay in microseconds per unit of link cost.
+    std::size_t queueLimit = 64;        ///< Packets a channel can hold waiting behind the one being transmitted.
+    std::size_t packetBytes = 1500;     ///< Size of every packet.
+};
+
+/**
+ * @struct TrafficLine
+ * @brief One line of a traffic file: a message sent as a burst of packets.
+ */
+struct TrafficLine {
+    double start;               ///< Injection time of the first packet, in microseconds.
+    std::string source;         ///< The source node name.
+    std::string destination;    ///< The destination node name.
+    uint32_t packets;           ///< Number of packets the message is split into.
+};
+
+/**
+ * Reads a traffic file with one "time source destination packets" line per message.
+ * @param trafficFile The path to the traffic file.
+ * @param traffic A reference to a vector where the messages will be stored.
+ * @return False if the file cannot be opened.
+ */
+inline bool
+readTrafficFile (const std::string &trafficFile, std::vector<TrafficLine> &traffic) {
+
+    std::ifstream file(trafficFile);
+
+    if (!file.is_open()) return false;
+
+    std::string line;
+
+    while (std::getline(file, line)) {
+
+        std::istringstream iss(line);
+        TrafficLine entry;
+
+        if (iss >> entry.start >> entry.source >> entry.destination >> entry.packets) traffic.push_back(entry);
+
+    }
+
+    return true;
+
+}
+
+/**
+ * @class PacketSimulator
+ * @brief Discrete-event simulator of packets crossing capacity- and queue-limited links.
+ *
+ * Nodes are dense indices 0..n-1; the caller maps its own node IDs onto them. Time is kept in
+ * integer nanoseconds so that events at the same instant are ordered deterministically by the
+ * order in which they were scheduled.
+ */
+class PacketSimulator {
+public:
+
+    /**
+     * @struct FlowStats
+     * @brief Delivery statistics of one traffic line.
+     */
+    struct FlowStats {
+        int source;
+        int destination;
+        uint64_t start;             ///< Injection time of the first packet in nanoseconds.
+        uint32_t packets;           ///< Packets to inject.
+        uint32_t injected = 0;
+        uint32_t delivered = 0;
+        uint32_t dropped = 0;
+        uint64_t latencySum = 0;    ///< Sum of the delivery latencies in nanoseconds.
+        uint64_t latencyMin = UINT64_MAX;
+        uint64_t latencyMax = 0;
+    };
+
+    /**
+     * @struct ChannelStats
+     * @brief Load of one direction of a link.
+     */
+    struct ChannelStats {
+        int from;
+        int to;
+        uint64_t transmitted = 0;   ///< Packets put on the wire.
+        uint64_t dropped = 0;       ///< Packets dropped because the queue was full.
+        uint64_t busy = 0;          ///< Nanoseconds spent transmitting.
+    };
+
+    /**
+     * Creates a simulator without links or traffic.
+     * @param nodes The number of nodes.
+     * @param config The link and packet parameters.
+     * @param route Returns the neighbor a node forwards packets for a destination to, or -1 for no route;
+     *        it must stay valid while the simulator runs.
+     */
+    PacketSimulator(int nodes, const PacketSimConfig &config, std::function<int(int, int)> route)
+        : nodes(nodes), config(config), route(std::move(route)), adjacency(nodes) {
+
+        transmitTime = static_cast<uint64_t>(config.packetBytes * 8 * 1000.0 / config.bandwidth);
+        if (transmitTime == 0) transmitTime = 1;
+
+    }
+
+    /**
+     * Adds a bidirectional link; a second link between the same nodes replaces the first.
+     * @param a One end of the link.
+     * @param b The other end of the link.
+     * @param cost The link cost, which scales the propagation delay.
+     */
+    void
+    addLink(int a, int b, int cost) {
+
+        uint64_t propagation = static_cast<uint64_t>(std::max(0, cost) * config.delayPerCost * 1000.0);
+
+        addChannel(a, b, propagation);
+        addChannel(b, a, propagation);
+
+    }
+
+    /**
+     * Adds a message to inject as a burst of packets, paced at the line rate.
+     * @param source The source node.
+     * @param destination The destination node.
+     * @param start The injection time of the first packet in microseconds.
+     * @param packets The number of packets.
+     */
+    void
+    addFlow(int source, int destination, double start, uint32_t packets) {
+
+        FlowStats flow;
+        flow.source = source;
+        flow.destination = destination;
+        flow.start = static_cast<uint64_t>(std::max(0.0, start) * 1000.0);
+        flow.packets = packets;
+
+        flows.push_back(flow);
+
+    }
+
+    /**
+     * Runs the simulation until every packet has been delivered or dropped.
+     */
+    void
+    run() {
+
+        auto begin = std::chrono::steady_clock::now();
+
+        for (std::size_t f = 0; f < flows.size(); ++f) {
+
+            if (flows[f].packets > 0) schedule(flows[f].start, Inject | static_cast<uint32_t>(f));
+
+        }
+
+        while (!heap.empty()) {
+
+            std::pop_heap(heap.begin(), heap.end(), later);
+            Event event = heap.back();
+            heap.pop_back();
+
+            now = event.time;
+            ++events;
+
+            uint32_t item = event.item & ~KindMask;
+
+            switch (event.item & KindMask) {
+                case Inject: inject(item); break;
+                case Arrive: delivered(item); break;
+                default: transmitted(item); break;
+            }
+
+        }
+
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    }
+
+    /**
+     * Prints the per-message latency, the drops and the link utilization of the last run.
+     * @param out The stream to write to.
+     * @param epoch The epoch whose routing tables were simulated.
+     * @param names The node names, indexed like the simulator nodes.
+     */
+    void
+    report(std::ostream &out, int epoch, const std::vector<std::string> &names) const {
+
+        uint64_t delivered = 0;
+
+        for (const auto &flow : flows) delivered += flow.delivered;
+
+        out << "packet-sim: epoch " << epoch << ": " << events << " events in " << seconds << " s ("
+            << (seconds > 0 ? events / seconds / 1e6 : 0) << " million events/s), " << delivered << " delivered, "
+            << queueDrops << " queue drops, " << routeDrops << " no-route drops, " << loopDrops << " loop drops, ended at t="
+            << now / 1000.0 << " us" << std::endl;
+
+        for (const auto &flow : flows) {
+
+            out << "packet-sim:   " << names[flow.source] << " -> " << names[flow.destination] << ": "
+                << flow.delivered << "/" << flow.packets << " delivered, " << flow.dropped << " dropped";
+
+            if (flow.delivered > 0) {
+
+                out << ", latency avg " << flow.latencySum / 1000.0 / flow.delivered << " min " << flow.latencyMin / 1000.0
+                    << " max " << flow.latencyMax / 1000.0 << " us";
+
+            }
+
+            out << std::endl;
+
+        }
+
+        for (const auto &channel : channels) {
+
+            if (channel.stats.transmitted == 0 && channel.stats.dropped == 0) continue;
+
+            out << "packet-sim:   link " << names[channel.stats.from] << "->" << names[channel.stats.to] << ": "
+                << channel.stats.transmitted << " packets, " << std::fixed << std::setprecision(1)
+                << (now > 0 ? 100.0 * channel.stats.busy / now : 0) << "% utilization, " << channel.stats.dropped
+                << " drops" << std::defaultfloat << std::setprecision(6) << std::endl;
+
+        }
+
+    }
+
+    /**
+     * @return The delivery statistics of every flow, in the order they were added.
+     */
+    const std::vector<FlowStats>&
+    getFlows() const {
+
+        return flows;
+
+    }
+
+    /**
+     * @return The number of events processed by the last run.
+     */
+    uint64_t
+    getEvents() const {
+
+        return events;
+
+    }
+
+private:
+
+    static const uint32_t KindMask = 0xc0000000u;
+    static const uint32_t Inject = 0x00000000u;         ///< Item is a flow injecting its next packet.
+    static const uint32_t Arrive = 0x40000000u;         ///< Item is a channel delivering its first packet on the wire.
+    static const uint32_t Transmitted = 0x80000000u;    ///< Item is a channel finishing its head packet.
+
+    /**
+     * @struct Event
+     * @brief A scheduled event; seq breaks ties between events at the same time.
+     */
+    struct Event {
+        uint64_t time;
+        uint64_t seq;
+        uint32_t item;
+    };
+
+    /**
+     * @struct Packet
+     * @brief A packet in flight.
+     */
+    struct Packet {
+        uint32_t flow;
+        int node;               ///< The node the packet is at, or travelling to.
+        uint32_t hops;
+        uint64_t injected;
+    };
+
+    /**
+     * @class Fifo
+     * @brief Ring buffer that doubles its capacity when full and never shrinks.
+     */
+    template <typename T>
+    class Fifo {
+    public:
+
+        void
+        push(const T &value) {
+
+            if (count == slots.size()) {
+
+                std::vector<T> larger(std::max<std::size_t>(16, slots.size() * 2));
+
+                for (std::size_t i = 0; i < count; ++i) larger[i] = slots[(head + i) & (slots.size() - 1)];
+
+                slots.swap(larger);
+                head = 0;
+
+            }
+
+            slots[(head + count++) & (slots.size() - 1)] = value;
+
+        }
+
+        const T&
+        front() const {
+
+            return slots[head];
+
+        }
+
+        void
+        pop() {
+
+            head = (head + 1) & (slots.size() - 1);
+            --count;
+
+        }
+
+        std::size_t
+        size() const {
+
+            return count;
+
+        }
+
+    private:
+        std::vector<T> slots;       ///< Capacity is a power of two.
+        std::size_t head = 0;
+        std::size_t count = 0;
+    };
+
+    /**
+     * @struct Channel
+     * @brief One direction of a link: the queue of packets waiting for the transmitter and
+     * the packets on the wire with their arrival times.
+     */
+    struct Channel {
+        ChannelStats stats;
+        uint64_t propagation;                           ///< Propagation delay in nanoseconds.
+        Fifo<uint32_t> queue;                           ///< Queued packets; the first one is being transmitted.
+        Fifo<std::pair<uint64_t, uint32_t>> wire;       ///< Packets propagating, with their arrival times.
+    };
+
+    static bool
+    later(const Event &a, const Event &b) {
+
+        return a.time != b.time ? a.time > b.time : a.seq > b.seq;
+
+    }
+
+    void
+    schedule(uint64_t time, uint32_t item) {
+
+        heap.push_back({time, sequence++, item});
+        std::push_heap(heap.begin(), heap.end(), later);
+
+    }
+
+    void
+    addChannel(int from, int to, uint64_t propagation) {
+
+        std::vector<std::pair<int, int>> &neighbours = adjacency[from];
+        auto it = std::lower_bound(neighbours.begin(), neighbours.end(), std::make_pair(to, -1));
+
+        if (it == neighbours.end() || it->first != to) {
+
+            it = neighbours.insert(it, std::make_pair(to, static_cast<int>(channels.size())));
+            channels.emplace_back();
+
+        }
+
+        int index = it->second;
+
+        channels[index].stats.from = from;
+        channels[index].stats.to = to;
+        channels[index].propagation = propagation;
+
+    }
+
+    void
+    inject(uint32_t f) {
+
+        FlowStats &flow = flows[f];
+        uint32_t packet;
+
+        if (freePackets.empty()) {
+
+            packet = static_cast<uint32_t>(packets.size());
+            packets.emplace_back();
+
+        } else {
+
+            packet = freePackets.back();
+            freePackets.pop_back();
+
+        }
+
+        packets[packet] = {f, flow.source, 0, now};
+
+        if (++flow.injected < flow.packets) schedule(now + transmitTime, Inject | f);
+
+        arrive(packet);
+
+    }
+
+    void
+    arrive(uint32_t packet) {
+
+        Packet &p = packets[packet];
+        FlowStats &flow = flows[p.flow];
+
+        if (p.node == flow.destination) {
+
+            uint64_t latency = now - p.injected;
+
+            ++flow.delivered;
+            flow.latencySum += latency;
+            flow.latencyMin = std::min(flow.latencyMin, latency);
+            flow.latencyMax = std::max(flow.latencyMax, latency);
+            freePackets.push_back(packet);
+            return;
+
+        }
+
+        int index = forwardChannel(p.node, flow.destination);
+
+        if (index < 0) {
+
+            drop(packet, routeDrops);
+            return;
+
+        }
+
+        if (++p.hops > static_cast<uint32_t>(nodes)) {
+
+            drop(packet, loopDrops);
+            return;
+
+        }
+
+        Channel &channel = channels[index];
+
+        if (channel.queue.size() > config.queueLimit) {
+
+            ++channel.stats.dropped;
+            drop(packet, queueDrops);
+            return;
+
+        }
+
+        channel.queue.push(packet);
+
+        if (channel.queue.size() == 1) startTransmission(index);
+
+    }
+
+    /**
+     * @return The channel a node forwards packets for a destination on, or -1 for no route; the next hop is asked
+     * of the caller on first use.
+     */
+    int
+    forwardChannel(int node, int destination) {
+
+        auto cached = routes.emplace(static_cast<uint64_t>(node) * nodes + destination, 0);
+
+        if (cached.second) cached.first->second = channelTo(node, route(node, destination));
+
+        return cached.first->second;
+
+    }
+
+    /**
+     * @return The channel from a node to a neighbor, or -1 if they are not linked.
+     */
+    int
+    channelTo(int from, int to) const {
+
+        if (to < 0) return -1;
+
+        const std::vector<std::pair<int, int>> &neighbours = adjacency[from];
+        auto it = std::lower_bound(neighbours.begin(), neighbours.end(), std::make_pair(to, -1));
+
+        return (it == neighbours.end() || it->first != to) ? -1 : it->second;
+
+    }
+
+    void
+    transmitted(uint32_t index) {
+
+        Channel &channel = channels[index];
+        uint32_t packet = channel.queue.front();
+
+        channel.queue.pop();
+
+        packets[packet].node = channel.stats.to;
+        channel.wire.push(std::make_pair(now + channel.propagation, packet));
+
+        if (channel.wire.size() == 1) schedule(now + channel.propagation, Arrive | index);
+
+        if (channel.queue.size() > 0) startTransmission(index);
+
+    }
+
+    void
+    delivered(uint32_t index) {
+
+        Channel &channel = channels[index];
+        uint32_t packet = channel.wire.front().second;
+
+        channel.wire.pop();
+
+        if (channel.wire.size() > 0) schedule(channel.wire.front().first, Arrive | index);
+
+        arrive(packet);
+
+    }
+
+    void
+    startTransmission(uint32_t index) {
+
+        Channel &channel = channels[index];
+
+        ++channel.stats.transmitted;
+        channel.stats.busy += transmitTime;
+        schedule(now + transmitTime, Transmitted | index);
+
+    }
+
+    void
+    drop(uint32_t packet, uint64_t &counter) {
+
+        ++flows[packets[packet].flow].dropped;
+        ++counter;
+        freePackets.push_back(packet);
+
+    }
+
+    int nodes;
+    PacketSimConfig config;
+    uint64_t transmitTime;                  ///< Nanoseconds to put one packet on the wire.
+    std::function<int(int, int)> route;     ///< The caller's next hop lookup.
+    /// node * nodes + destination -> channel to the next hop, or -1, for the pairs asked so far.
+    std::unordered_map<uint64_t, int> routes;
+    /// The neighbors of every node, sorted, with the channel to each.
+    std::vector<std::vector<std::pair<int, int>>> adjacency;
+    std::vector<Channel> channels;
+    std::vector<FlowStats> flows;
+    std::vector<Packet> packets;            ///< Packet pool; freed entries are reused.
+    std::vector<uint32_t> freePackets;
+    std::vector<Event> heap;                ///< Pending events, earliest on top.
+    uint64_t sequence = 0;
+    uint64_t now = 0;                       ///< Current time in nanoseconds.
+    uint64_t events = 0;
+    uint64_t queueDrops = 0;
+    uint64_t routeDrops = 0;
+    uint64_t loopDrops = 0;
+    double seconds = 0;                     ///< Wall-clock time of the last run.
+};
+
+#endif
@@ -0,0 +1,483 @@
+/**
+ * @file replay.cpp
+ * @brief Rate-controlled replay of a change trace into a resident dvr or lsr process.
+ *
+ * The replay starts the simulator with its standard input and output connected to pipes and writes
+ * the change records of a trace at a target rate: constant, Poisson, or the trace's own timestamps
+ * sped up by a factor. The simulator runs with --resident, which the replay adds to its arguments if
+ * they lack it, and acknowledges every change with "published <epoch>" once its routes are out.
+ * Sending is open loop: every change has a scheduled send time fixed in advance, and its latency
+ * runs from that time to its acknowledgement, so a simulator that falls behind is charged for the
+ * whole wait rather than only for its own work.
+ * Every second the replay reports the changes offered and published and the backlog between them.
+ * A simulator that exits or closes its output before acknowledging every change fails the replay.
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <cmath>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "latency_histogram.h"
+
+/**
+ * @struct ReplayOptions
+ * @brief Rate control and reporting selected on the command line.
+ */
+struct ReplayOptions {
+    std::string mode = "constant";  ///< Arrival process: "constant", "poisson" or "timestamps".
+    double rate = 10;               ///< Changes per second of the constant and Poisson modes.
+    double speedup = 1;             ///< Factor the trace timestamps are divided by in the timestamps mode.
+    int repeat = 1;                 ///< Number of times the trace is replayed.
+    uint64_t seed = 1;              ///< Seed of the Poisson arrivals.
+    uint64_t backlogLimit = 100;    ///< Backlog beyond which the simulator counts as no longer keeping up.
+};
+
+/**
+ * @struct TraceRecord
+ * @brief A change record of the trace without its time column, and its time in seconds.
+ */
+struct TraceRecord {
+    std::string record;
+    double time;
+};
+
+typedef std::chrono::steady_clock Clock;
+
+/**
+ * @struct ReplayState
+ * @brief Progress shared by the sending, receiving and reporting threads.
+ */
+struct ReplayState {
+    std::atomic<uint64_t> sent{0};
+    std::atomic<uint64_t> published{0};
+    std::atomic<bool> receiving{true};          ///< False once the simulator closed its output.
+    std::mutex mutex;                           ///< Guards latency and lastPublished.
+    LatencyHistogram latency;                   ///< Scheduled send time to acknowledgement, in nanoseconds.
+    Clock::time_point lastPublished;            ///< Time of the latest acknowledgement.
+};
+
+/**
+ * Reads the change records of a trace in the syntax of a changes file: "node1 node2 cost", "down <id>" or
+ * "up <id>", optionally preceded by the time of the record; a record without one follows the previous by a second.
+ * The records themselves are checked by the resident simulator; a malformed time or field count stops the program.
+ *
+ * @param traceFile The path to the trace.
+ * @param trace A reference to a vector where the records will be stored.
+ */
+void
+readTrace (const std::string &traceFile, std::vector<TraceRecord> &trace) {
+
+    std::ifstream file(traceFile);
+
+    if (!file.is_open()) {
+        std::cerr << "Cannot open trace file: " << traceFile << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    std::string line;
+    double time = 0;
+
+    while (std::getline(file, line)) {
+
+        std::istringstream iss(line);
+        std::vector<std::string> words;
+        std::string word;
+
+        while (iss >> word) words.push_back(word);
+
+        bool routerRecord = words.size() >= 2 && (words[words.size() - 2] == "down" || words[words.size() - 2] == "up");
+        std::size_t fields = routerRecord ? 2 : 3;
+
+        if (words.empty()) continue;
+
+        char *end = nullptr;
+
+        if (words.size() > fields) time = std::strtod(words[0].c_str(), &end);
+
+        if (words.size() < fields || words.size() > fields + 1 || (end != nullptr && *end != '\0')) {
+            std::cerr << "Invalid trace record: " << line << std::endl;
+            exit(EXIT_FAILURE);
+        }
+
+        if (end == nullptr) time = time + 1;
+
+        std::string record;
+
+        for (std::size_t i = words.size() - fields; i < words.size(); ++i) record += (record.empty() ? "" : " ") + words[i];
+
+        trace.push_back({record, time});
+
+    }
+
+}
+
+/**
+ * Computes the send time of every change, in seconds from the start of the replay.
+ *
+ * @param trace A constant reference to the records of the trace.
+ * @param options A constant reference to the rate control.
+ * @return The send times, in the order the records are sent: the trace, repeated options.repeat times.
+ */
+std::vector<double>
+schedule (const std::vector<TraceRecord> &trace, const ReplayOptions &options) {
+
+    std::vector<double> times;
+    std::mt19937_64 random(options.seed);
+    std::exponential_distribution<double> gap(options.rate);
+    double next = 0, offset = 0;
+
+    for (int round = 0; round < options.repeat; ++round) {
+
+        for (const auto &record : trace) {
+
+            if (options.mode == "constant") {
+                times.push_back(next);
+                next += 1 / options.rate;
+            } else if (options.mode == "poisson") {
+                times.push_back(next);
+                next += gap(random);
+            } else {
+                times.push_back(offset + (record.time - trace.front().time) / options.speedup);
+            }
+
+        }
+
+        // The next round of a timestamped trace starts a trace second after the last record of this one
+        if (!trace.empty()) offset = times.back() + 1 / options.speedup;
+
+    }
+
+    return times;
+
+}
+
+/**
+ * Writes all of a buffer to a file descriptor.
+ * @return False if the descriptor was closed, e.g. because the simulator exited.
+ */
+bool
+writeAll (int fd, const std::string &data) {
+
+    std::size_t done = 0;
+
+    while (done < data.size()) {
+
+        ssize_t n = write(fd, data.data() + done, data.size() - done);
+
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+
+        done += n;
+
+    }
+
+    return true;
+
+}
+
+/**
+ * Reads the simulator's output until it closes it. Every "published <epoch>" line acknowledges the oldest change
+ * not yet acknowledged; all other lines, such as the latency statistics, are copied to standard output.
+ *
+ * @param fd The read end of the simulator's standard output.
+ * @param start The start of the replay.
+ * @param times A constant reference to the send times.
+ * @param state A reference to the shared progress.
+ */
+void
+receive (int fd, Clock::time_point start, const std::vector<double> &times, ReplayState &state) {
+
+    std::string pending;
+    char buffer[4096];
+
+    for (;;) {
+
+        ssize_t n = read(fd, buffer, sizeof(buffer));
+
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+
+        auto now = Clock::now();
+
+        pending.append(buffer, n);
+
+        std::size_t end;
+
+        while ((end = pending.find('\n')) != std::string::npos) {
+
+            std::string line = pending.substr(0, end);
+            pending.erase(0, end + 1);
+
+            if (line.compare(0, 10, "published ") != 0) {
+                std::cout << line << "\n";
+                continue;
+            }
+
+            uint64_t index = state.published.load();
+
+            if (index < times.size()) {
+
+                auto scheduled = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(times[index]));
+                std::lock_guard<std::mutex> lock(state.mutex);
+
+                state.latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(now - scheduled).count());
+                state.lastPublished = now;
+
+            }
+
+            state.published = index + 1;
+
+        }
+
+    }
+
+    std::cout.flush();
+    state.receiving = false;
+
+}
+
+/**
+ * Prints the command line usage of the program.
+ * @param program The name the program was invoked with.
+ */
+void
+printUsage (const char *program) {
+
+    std::cerr << "Usage: " << program << " [options] <traceFile> <simulator> [<simulator arguments>...]\n"
+              << "Replays the change records of traceFile into the standard input of the simulator, which is run with --resident (added if missing).\n"
+              << "Options:\n"
+              << "  --rate R           send R changes per second at constant intervals (default 10)\n"
+              << "  --poisson R        send R changes per second on average with exponential gaps\n"
+              << "  --timestamps       send at the times of the trace's first column\n"
+              << "  --speedup X        divide the trace times by X (default 1; implies --timestamps)\n"
+              << "  --repeat K         replay the trace K times (default 1)\n"
+              << "  --seed S           seed of the Poisson arrivals (default 1)\n"
+              << "  --backlog-limit N  backlog beyond which the simulator no longer keeps up (default 100)" << std::endl;
+
+}
+
+/**
+ * The entry point of the replay tool.
+ *
+ * @param argc The number of command-line arguments.
+ * @param argv The command-line arguments.
+ * @return 0 when the simulator published every change and exited normally, 1 otherwise.
+ */
+int
+main (int argc, char **argv) {
+
+    ReplayOptions options;
+    int i = 1;
+
+    for (; i < argc; ++i) {
+
+        std::string arg = argv[i];
+
+        if (arg == "--rate" && i + 1 < argc) {
+
+            options.mode = "constant";
+            options.rate = std::atof(argv[++i]);
+
+        } else if (arg == "--poisson" && i + 1 < argc) {
+
+            options.mode = "poisson";
+            options.rate = std::atof(argv[++i]);
+
+        } else if (arg == "--timestamps") {
+
+            options.mode = "timestamps";
+
+        } else if (arg == "--speedup" && i + 1 < argc) {
+
+            options.mode = "timestamps";
+            options.speedup = std::atof(argv[++i]);
+
+        } else if (arg == "--repeat" && i + 1 < argc) {
+
+            options.repeat = std::atoi(argv[++i]);
+
+        } else if (arg == "--seed" && i + 1 < argc) {
+
+            options.seed = std::strtoull(argv[++i], nullptr, 10);
+
+        } else if (arg == "--backlog-limit" && i + 1 < argc) {
+
+            options.backlogLimit = std::strtoull(argv[++i], nullptr, 10);
+
+        } else if (arg.compare(0, 2, "--") == 0) {
+
+            printUsage(argv[0]);
+            return 1;
+
+        } else {
+
+            break;
+
+        }
+
+    }
+
+    if (argc - i < 2 || options.rate <= 0 || options.speedup <= 0 || options.repeat < 1) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    std::vector<TraceRecord> trace;
+
+    readTrace(argv[i], trace);
+
+    std::vector<double> times = schedule(trace, options);
+    std::vector<char *> simulator(argv + i + 1, argv + argc);
+    char resident[] = "--resident";
+    int toSimulator[2], fromSimulator[2];
+
+    // Without --resident the simulator would run its changes file and exit without reading the trace
+    if (std::find_if(simulator.begin(), simulator.end(), [](const char *arg) { return std::strcmp(arg, "--resident") == 0; }) == simulator.end()) {
+        simulator.push_back(resident);
+    }
+
+    simulator.push_back(nullptr);
+
+    if (pipe(toSimulator) != 0 || pipe(fromSimulator) != 0) {
+        std::cerr << "Cannot create pipe: " << std::strerror(errno) << std::endl;
+        return 1;
+    }
+
+    pid_t child = fork();
+
+    if (child < 0) {
+        std::cerr << "Cannot start simulator: " << std::strerror(errno) << std::endl;
+        return 1;
+    }
+
+    if (child == 0) {
+
+        dup2(toSimulator[0], STDIN_FILENO);
+        dup2(fromSimulator[1], STDOUT_FILENO);
+        close(toSimulator[0]); close(toSimulator[1]);
+        close(fromSimulator[0]); close(fromSimulator[1]);
+
+        execvp(simulator[0], simulator.data());
+
+        std::cerr << "Cannot run " << simulator[0] << ": " << std::strerror(errno) << std::endl;
+        _exit(127);
+
+    }
+
+    close(toSimulator[0]);
+    close(fromSimulator[1]);
+    std::signal(SIGPIPE, SIG_IGN);
+
+    ReplayState state;
+    auto start = Clock::now();
+
+    state.lastPublished = start;
+    std::thread receiver(receive, fromSimulator[0], start, std::cref(times), std::ref(state));
+
+    // Send on schedule; a late send does not shift the later ones. Sleeps are sliced so that a simulator that
+    // closed its output stops the sending
+    std::thread sender([&]() {
+
+        for (std::size_t k = 0; k < times.size() && state.receiving; ++k) {
+
+            auto due = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(times[k]));
+
+            while (state.receiving && Clock::now() < due) {
+                std::this_thread::sleep_until(std::min(due, Clock::now() + std::chrono::milliseconds(100)));
+            }
+
+            if (!state.receiving || !writeAll(toSimulator[1], trace[k % trace.size()].record + "\n")) break;
+
+            state.sent = k + 1;
+
+        }
+
+    });
+
+    // Report every second until every change is published or the simulator is gone
+    uint64_t maxBacklog = 0, lastPublished = 0;
+    double behindSince = -1;
+
+    for (int second = 1; state.receiving && state.published < times.size(); ++second) {
+
+        std::this_thread::sleep_until(start + std::chrono::seconds(second));
+
+        uint64_t sent = state.sent, published = state.published;
+        uint64_t offered = std::upper_bound(times.begin(), times.end(), static_cast<double>(second)) - times.begin();
+        uint64_t backlog = offered - std::min(offered, published);
+
+        maxBacklog = std::max(maxBacklog, backlog);
+
+        if (behindSince < 0 && backlog > options.backlogLimit) behindSince = second;
+
+        std::cerr << "replay: " << second << " s: offered " << offered << ", sent " << sent << ", published " << published
+                  << " (" << (published - lastPublished) << "/s), backlog " << backlog << std::endl;
+
+        lastPublished = published;
+
+    }
+
+    sender.join();
+
+    writeAll(toSimulator[1], "stats\nquit\n");
+    close(toSimulator[1]);
+
+    receiver.join();
+    close(fromSimulator[0]);
+
+    int status = 0;
+
+    waitpid(child, &status, 0);
+
+    double elapsed = std::chrono::duration<double>(state.lastPublished - start).count();
+    double span = times.empty() ? 0 : times.back();
+    uint64_t published = state.published;
+
+    std::cerr << "replay: " << times.size() << " changes offered (" << options.mode << ", "
+              << (span > 0 ? (times.size() - 1) / span : 0) << "/s over " << span << " s); " << published
+              << " published in " << elapsed << " s, " << (elapsed > 0 ? published / elapsed : 0) << "/s achieved; max backlog "
+              << maxBacklog << std::endl;
+
+    std::cerr << "replay: change-to-route latency from scheduled send: ";
+    state.latency.write(std::cerr, 1000);
+    std::cerr << " us" << std::endl;
+
+    if (published < times.size()) {
+
+        std::cerr << "replay: failed: the simulator ";
+
+        if (WIFEXITED(status) && WEXITSTATUS(status) != 0) {
+            std::cerr << "exited with status " << WEXITSTATUS(status);
+        } else if (WIFSIGNALED(status)) {
+            std::cerr << "was killed by signal " << WTERMSIG(status);
+        } else {
+            std::cerr << "closed its output";
+        }
+
+        std::cerr << " after publishing " << published << " of " << times.size() << " changes" << std::endl;
+
+    } else if (behindSince >= 0) {
+        std::cerr << "replay: fell behind after " << behindSince << " s: backlog above " << options.backlogLimit << std::endl;
+    } else {
+        std::cerr << "replay: kept up: backlog never above " << options.backlogLimit << std::endl;
+    }
+
+    return (published == times.size() && WIFEXITED(status) && WEXITSTATUS(status) == 0) ? 0 : 1;
+
+}
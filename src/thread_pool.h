@@ -0,0 +1,135 @@
+/**
+ * @file thread_pool.h
+ * @brief Fixed-size pool of worker threads for running independent computations in parallel.
+ */
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+/**
+ * @class ThreadPool
+ * @brief Runs submitted tasks on a fixed set of worker threads.
+ *
+ * Tasks are taken from a single FIFO queue. wait() blocks until every task submitted so
+ * far has finished, which lets callers use the pool as a parallel-for barrier.
+ */
+class ThreadPool {
+public:
+
+    /**
+     * Starts the worker threads.
+     * @param threads The number of workers; 0 selects the number of hardware threads.
+     */
+    explicit ThreadPool(unsigned threads = 0) {
+
+        if (threads == 0) threads = std::thread::hardware_concurrency();
+        if (threads == 0) threads = 1;
+
+        for (unsigned i = 0; i < threads; ++i) workers.emplace_back(&ThreadPool::work, this);
+
+    }
+
+    /**
+     * Finishes the queued tasks and joins the workers.
+     */
+    ~ThreadPool() {
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+
+        available.notify_all();
+
+        for (auto &worker : workers) worker.join();
+
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool& operator=(const ThreadPool &) = delete;
+
+    /**
+     * Queues a task for execution on one of the workers.
+     * @param task The task to run.
+     */
+    void
+    submit(std::function<void()> task) {
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.push(std::move(task));
+            ++pending;
+        }
+
+        available.notify_one();
+
+    }
+
+    /**
+     * Blocks until all submitted tasks have finished.
+     */
+    void
+    wait() {
+
+        std::unique_lock<std::mutex> lock(mutex);
+        idle.wait(lock, [this]() { return pending == 0; });
+
+    }
+
+    /**
+     * @return The number of worker threads.
+     */
+    unsigned
+    size() const {
+
+        return static_cast<unsigned>(workers.size());
+
+    }
+
+private:
+
+    void
+    work() {
+
+        for (;;) {
+
+            std::function<void()> task;
+
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                available.wait(lock, [this]() { return stopping || !tasks.empty(); });
+
+                if (tasks.empty()) return;
+
+                task = std::move(tasks.front());
+                tasks.pop();
+            }
+
+            task();
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (--pending == 0) idle.notify_all();
+            }
+
+        }
+
+    }
+
+    std::vector<std::thread> workers;               ///< The worker threads.
+    std::queue<std::function<void()>> tasks;        ///< Tasks waiting for a worker.
+    std::mutex mutex;                               ///< Guards tasks, pending and stopping.
+    std::condition_variable available;              ///< Signalled when a task is queued or the pool stops.
+    std::condition_variable idle;                   ///< Signalled when the last pending task finishes.
+    unsigned pending = 0;                           ///< Tasks queued or running.
+    bool stopping = false;                          ///< Set when the pool is being destroyed.
+};
+
+#endif
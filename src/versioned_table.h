@@ -0,0 +1,367 @@
+/**
+ * @file versioned_table.h
+ * @brief Persistent, structurally shared storage for routing tables across change epochs.
+ *
+ * Every epoch is a set of rows sorted by key and split into pages of neighbouring keys.
+ * A new epoch starts out sharing all pages of the previous one and is given only the rows
+ * that changed; writing a row copies only the page holding it (copy-on-write through the
+ * page reference count). Pages are found by key, not by position, so a new router's rows
+ * land in the pages around its key and split them when they fill up instead of shifting
+ * every later row. An epoch therefore costs one page directory plus one page per page that
+ * actually changed, and every earlier epoch remains readable.
+ */
+
+#ifndef VERSIONED_TABLE_H
+#define VERSIONED_TABLE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <set>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+/**
+ * @class VersionedTable
+ * @brief Append-only history of keyed row tables with page-level structural sharing.
+ *
+ * @tparam Key Row key; must be copyable and less-than comparable.
+ * @tparam Value Row contents; must be copyable and equality comparable.
+ * @tparam PageRows Number of rows a page holds before it is split.
+ */
+template <typename Key, typename Value, std::size_t PageRows = 64>
+class VersionedTable {
+public:
+
+    typedef std::pair<Key, Value> Row;
+    typedef std::vector<Row> Page;
+    typedef std::shared_ptr<Page> PagePtr;
+
+    /**
+     * Stores the next epoch as the previous one with some rows written and some removed.
+     * Written rows equal to the stored ones are not copied.
+     * @param changed The rows that are new or differ from the previous epoch, in any order.
+     * @param removed The keys of the rows of the previous epoch that are gone.
+     * @return The number of the committed epoch (the first epoch is 0).
+     */
+    std::size_t
+    commit(std::vector<Row> changed, const std::vector<Key> &removed) {
+
+        Epoch next;
+
+        if (!epochs.empty()) next = epochs.back();
+
+        std::sort(changed.begin(), changed.end(), [](const Row &a, const Row &b) { return a.first < b.first; });
+
+        for (const auto &row : changed) write(next, row);
+
+        for (const auto &key : removed) erase(next, key);
+
+        epochs.push_back(std::move(next));
+
+        return epochs.size() - 1;
+
+    }
+
+    /**
+     * @return The number of committed epochs.
+     */
+    std::size_t
+    epochCount() const {
+
+        return epochs.size();
+
+    }
+
+    /**
+     * @param epoch A committed epoch.
+     * @return The number of rows stored for that epoch.
+     */
+    std::size_t
+    rowCount(std::size_t epoch) const {
+
+        return getEpoch(epoch).rows;
+
+    }
+
+    /**
+     * Reads a single row of a historical epoch in O(log rows).
+     * @param epoch A committed epoch.
+     * @param key The key of the row.
+     * @return A pointer to the stored value, or nullptr if the epoch has no such row.
+     */
+    const Value*
+    find(std::size_t epoch, const Key &key) const {
+
+        const Epoch &e = getEpoch(epoch);
+
+        if (e.pages.empty()) return nullptr;
+
+        const Page &page = *e.pages[pageOf(e, key)].second;
+        auto it = std::lower_bound(page.begin(), page.end(), key, lessKey);
+
+        return (it == page.end() || key < it->first) ? nullptr : &it->second;
+
+    }
+
+    /**
+     * Materializes all rows of a historical epoch.
+     * @param epoch A committed epoch.
+     * @return A copy of the epoch's rows in key order.
+     */
+    std::vector<Row>
+    rows(std::size_t epoch) const {
+
+        const Epoch &e = getEpoch(epoch);
+        std::vector<Row> result;
+
+        result.reserve(e.rows);
+
+        for (const auto &page : e.pages) result.insert(result.end(), page.second->begin(), page.second->end());
+
+        return result;
+
+    }
+
+    /**
+     * Calls a function with every row of a historical epoch in key order, without copying them.
+     * @param epoch A committed epoch.
+     * @param visit Called as visit(key, value).
+     */
+    template <typename Visit>
+    void
+    forEach(std::size_t epoch, Visit visit) const {
+
+        for (const auto &page : getEpoch(epoch).pages) {
+
+            for (const auto &row : *page.second) visit(row.first, row.second);
+
+        }
+
+    }
+
+    /**
+     * @return The number of pages allocated over the whole history.
+     */
+    std::size_t
+    getPagesCopied() const {
+
+        return pagesCopied;
+
+    }
+
+    /**
+     * @return The number of rows physically written over the whole history.
+     */
+    std::size_t
+    getRowsWritten() const {
+
+        return rowsWritten;
+
+    }
+
+    /**
+     * @return The number of distinct pages still referenced by some epoch.
+     */
+    std::size_t
+    livePages() const {
+
+        return distinctPages().size();
+
+    }
+
+    /**
+     * Approximates the bytes held by the history: live pages plus page directories.
+     * Heap memory owned by the rows themselves (e.g. string buffers) is not included.
+     * @return The approximate footprint in bytes.
+     */
+    std::size_t
+    storedBytes() const {
+
+        std::size_t bytes = 0;
+
+        for (const Page *page : distinctPages()) bytes += sizeof(Page) + page->size() * sizeof(Row);
+
+        for (const auto &e : epochs) bytes += sizeof(Epoch) + e.pages.size() * sizeof(DirectoryEntry);
+
+        return bytes;
+
+    }
+
+    /**
+     * @return The bytes that storing a full copy of every epoch would take.
+     */
+    std::size_t
+    fullCopyBytes() const {
+
+        std::size_t bytes = 0;
+
+        for (const auto &e : epochs) bytes += e.rows * sizeof(Row);
+
+        return bytes;
+
+    }
+
+private:
+
+    typedef std::pair<Key, PagePtr> DirectoryEntry;    ///< The first key of a page and the page.
+
+    /**
+     * @struct Epoch
+     * @brief The page directory of one committed epoch.
+     */
+    struct Epoch {
+        std::vector<DirectoryEntry> pages;  ///< Pages in key order, possibly shared with other epochs.
+        std::size_t rows = 0;               ///< Number of rows in the epoch.
+    };
+
+    static bool
+    lessKey(const Row &row, const Key &key) {
+
+        return row.first < key;
+
+    }
+
+    /**
+     * @return The directory slot of the page a key belongs to: the last page starting at or before it, or the first page.
+     */
+    static std::size_t
+    pageOf(const Epoch &e, const Key &key) {
+
+        auto it = std::upper_bound(e.pages.begin(), e.pages.end(), key,
+                                   [](const Key &k, const DirectoryEntry &entry) { return k < entry.first; });
+
+        return (it == e.pages.begin()) ? 0 : it - e.pages.begin() - 1;
+
+    }
+
+    /**
+     * Writes a row into the epoch being built, splitting its page in two once it holds twice PageRows rows.
+     */
+    void
+    write(Epoch &e, const Row &row) {
+
+        if (e.pages.empty()) {
+
+            e.pages.emplace_back(row.first, std::make_shared<Page>(1, row));
+            ++pagesCopied;
+            ++rowsWritten;
+            ++e.rows;
+            return;
+
+        }
+
+        std::size_t slot = pageOf(e, row.first);
+        const Page &shared = *e.pages[slot].second;
+        auto it = std::lower_bound(shared.begin(), shared.end(), row.first, lessKey);
+        std::size_t position = it - shared.begin();
+
+        if (it != shared.end() && !(row.first < it->first)) {
+
+            if (it->second == row.second) return;
+
+            writable(e.pages[slot].second)[position].second = row.second;
+            ++rowsWritten;
+            return;
+
+        }
+
+        Page &page = writable(e.pages[slot].second);
+
+        page.insert(page.begin() + position, row);
+        e.pages[slot].first = page.front().first;
+        ++rowsWritten;
+        ++e.rows;
+
+        if (page.size() >= 2 * PageRows) {
+
+            PagePtr upper = std::make_shared<Page>(page.begin() + PageRows, page.end());
+
+            page.resize(PageRows);
+            page.shrink_to_fit();
+            ++pagesCopied;
+            e.pages.insert(e.pages.begin() + slot + 1, DirectoryEntry(upper->front().first, upper));
+
+        }
+
+    }
+
+    /**
+     * Removes a row from the epoch being built, dropping its page once it is empty.
+     */
+    void
+    erase(Epoch &e, const Key &key) {
+
+        if (e.pages.empty()) return;
+
+        std::size_t slot = pageOf(e, key);
+        const Page &shared = *e.pages[slot].second;
+        auto it = std::lower_bound(shared.begin(), shared.end(), key, lessKey);
+
+        if (it == shared.end() || key < it->first) return;
+
+        std::size_t position = it - shared.begin();
+        Page &page = writable(e.pages[slot].second);
+
+        page.erase(page.begin() + position);
+        --e.rows;
+
+        if (page.empty()) {
+            e.pages.erase(e.pages.begin() + slot);
+        } else {
+            e.pages[slot].first = page.front().first;
+        }
+
+    }
+
+    /**
+     * Returns a page that may be modified, copying it first if another epoch still shares it.
+     * @param page The directory slot of the page.
+     * @return A mutable reference to a page owned only by the epoch being built.
+     */
+    Page&
+    writable(PagePtr &page) {
+
+        if (page.use_count() > 1) {
+
+            page = std::make_shared<Page>(*page);
+            ++pagesCopied;
+            rowsWritten += page->size();
+
+        }
+
+        return *page;
+
+    }
+
+    std::set<const Page*>
+    distinctPages() const {
+
+        std::set<const Page*> seen;
+
+        for (const auto &e : epochs) {
+
+            for (const auto &page : e.pages) seen.insert(page.second.get());
+
+        }
+
+        return seen;
+
+    }
+
+    const Epoch&
+    getEpoch(std::size_t epoch) const {
+
+        if (epoch >= epochs.size()) throw std::out_of_range("Epoch has not been committed.");
+
+        return epochs[epoch];
+
+    }
+
+    std::vector<Epoch> epochs;          ///< Committed epochs, oldest first.
+    std::size_t pagesCopied = 0;        ///< Pages allocated or copied on write.
+    std::size_t rowsWritten = 0;        ///< Rows physically stored.
+};
+
+#endif
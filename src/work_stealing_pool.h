@@ -0,0 +1,214 @@
+/**
+ * @file work_stealing_pool.h
+ * @brief Work-stealing scheduler for many small tasks identified by an integer.
+ */
+
+#ifndef WORK_STEALING_POOL_H
+#define WORK_STEALING_POOL_H
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @class WorkStealingPool
+ * @brief Runs integer tasks on worker threads with one deque per worker.
+ *
+ * A worker pushes the tasks it schedules onto the back of its own deque and pops from the back,
+ * which keeps recently touched data hot. An idle worker steals from the front of another worker's
+ * deque. Each deque has its own lock, and only the owner and an occasional thief contend for it.
+ * The pool does not know when the work is finished: run() returns once the caller's predicate says so.
+ */
+class WorkStealingPool {
+public:
+
+    /**
+     * @param threads The number of workers; 0 selects the number of hardware threads.
+     */
+    explicit WorkStealingPool(unsigned threads = 0) {
+
+        if (threads == 0) threads = std::thread::hardware_concurrency();
+        if (threads == 0) threads = 1;
+
+        for (unsigned i = 0; i < threads; ++i) queues.emplace_back(new Queue());
+
+    }
+
+    /**
+     * Schedules a task. From a worker of this pool the task goes to that worker's deque,
+     * otherwise the deques are filled round robin.
+     * @param task The task to run.
+     */
+    void
+    schedule(int task) {
+
+        std::size_t target = (worker().pool == this) ? worker().index : next++ % queues.size();
+        Queue &queue = *queues[target];
+
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(task);
+
+    }
+
+    /**
+     * Runs scheduled tasks on the workers until the predicate holds; it is checked whenever a worker finds no task.
+     * @param handler Called with every task; may schedule further tasks.
+     * @param finished Returns true once no more work can appear.
+     */
+    void
+    run(const std::function<void(int)> &handler, const std::function<bool()> &finished) {
+
+        std::vector<std::thread> workers;
+
+        for (std::size_t w = 0; w < queues.size(); ++w) {
+            workers.emplace_back(&WorkStealingPool::work, this, w, std::cref(handler), std::cref(finished));
+        }
+
+        for (auto &worker : workers) worker.join();
+
+    }
+
+    /**
+     * @return The number of worker threads.
+     */
+    unsigned
+    size() const {
+
+        return static_cast<unsigned>(queues.size());
+
+    }
+
+    /**
+     * @return The number of tasks run so far.
+     */
+    uint64_t
+    getExecuted() const {
+
+        return executed.load();
+
+    }
+
+    /**
+     * @return The number of tasks taken from another worker's deque so far.
+     */
+    uint64_t
+    getSteals() const {
+
+        return steals.load();
+
+    }
+
+private:
+
+    /**
+     * @struct Worker
+     * @brief Identifies the pool and worker the calling thread runs for.
+     */
+    struct Worker {
+        WorkStealingPool *pool;
+        std::size_t index;
+    };
+
+    static Worker&
+    worker() {
+
+        static thread_local Worker current{nullptr, 0};
+
+        return current;
+
+    }
+
+    /**
+     * @struct Queue
+     * @brief One worker's deque of tasks.
+     */
+    struct Queue {
+        std::mutex mutex;
+        std::deque<int> tasks;
+    };
+
+    void
+    work(std::size_t self, const std::function<void(int)> &handler, const std::function<bool()> &finished) {
+
+        worker().pool = this;
+        worker().index = self;
+
+        uint64_t ran = 0, stolen = 0;
+        uint64_t victim = self * 0x9e3779b97f4a7c15ULL + 1;
+
+        for (;;) {
+
+            int task;
+
+            if (take(*queues[self], true, task)) {
+
+                handler(task);
+                ++ran;
+                continue;
+
+            }
+
+            bool found = false;
+
+            for (std::size_t attempt = 0; attempt < queues.size() && !found; ++attempt) {
+
+                victim ^= victim << 13; victim ^= victim >> 7; victim ^= victim << 17;
+
+                std::size_t other = victim % queues.size();
+
+                if (other != self && take(*queues[other], false, task)) found = true;
+
+            }
+
+            if (found) {
+
+                handler(task);
+                ++ran;
+                ++stolen;
+                continue;
+
+            }
+
+            if (finished()) break;
+
+            std::this_thread::yield();
+
+        }
+
+        executed += ran;
+        steals += stolen;
+        worker().pool = nullptr;
+
+    }
+
+    static bool
+    take(Queue &queue, bool back, int &task) {
+
+        std::lock_guard<std::mutex> lock(queue.mutex);
+
+        if (queue.tasks.empty()) return false;
+
+        if (back) {
+            task = queue.tasks.back();
+            queue.tasks.pop_back();
+        } else {
+            task = queue.tasks.front();
+            queue.tasks.pop_front();
+        }
+
+        return true;
+
+    }
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::atomic<std::size_t> next{0};           ///< Round-robin target for tasks scheduled from outside.
+    std::atomic<uint64_t> executed{0};
+    std::atomic<uint64_t> steals{0};
+};
+
+#endif
@@ -0,0 +1,28 @@
+#!/bin/sh
+# --flap-damping with a link that is still held down after the last change. Its penalty decays below the reuse
+# threshold later on, so both engines must release it in an epoch of their own and write that epoch's tables.
+
+set -e
+
+cd "$(dirname "$0")/.."
+
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+
+printf '1 2 8\n2 3 3\n2 5 4\n4 1 1\n4 5 1\n3 6 2\n5 6 7\n' > "$dir/topology.txt"
+printf '1 6 message\n' > "$dir/messages.txt"
+printf '0 4 5 3\n1 4 5 1\n2 4 5 3\n3 4 5 1\n4 4 5 3\n' > "$dir/changes.txt"
+
+for engine in dvr lsr; do
+
+    ./$engine --flap-damping "$dir/topology.txt" "$dir/messages.txt" "$dir/changes.txt" "$dir/output.txt" 2> "$dir/report.txt"
+
+    if ! grep -q "^damping: epoch 6: link 4-5 released$" "$dir/report.txt" || [ "$(grep -c "^from 1 to 6" "$dir/output.txt")" != 7 ]; then
+        cat "$dir/report.txt"
+        echo "FAIL: flap_release_after_last_change ($engine)"
+        exit 1
+    fi
+
+done
+
+echo "PASS: flap_release_after_last_change"
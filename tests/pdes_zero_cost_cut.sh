@@ -0,0 +1,25 @@
+#!/bin/sh
+# --pdes with a zero-cost link between the two partitions of a 2-thread run. With seed 427 the jitter of that link
+# (routers 2 and 3) is 0, so it would take no time at all. Every link must still take at least one tick: the
+# parallel run then keeps a lookahead of one tick and must match the sequential run bit for bit.
+
+set -e
+
+cd "$(dirname "$0")/.."
+
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+
+printf '1 2 1\n2 3 0\n3 4 1\n' > "$dir/topology.txt"
+: > "$dir/messages.txt"
+: > "$dir/changes.txt"
+
+./dvr --pdes 2 --pdes-seed 427 "$dir/topology.txt" "$dir/messages.txt" "$dir/changes.txt" "$dir/output.txt" 2> "$dir/report.txt"
+
+if ! grep -q "2 threads: .* lookahead 1, .* identical$" "$dir/report.txt"; then
+    cat "$dir/report.txt"
+    echo "FAIL: pdes_zero_cost_cut"
+    exit 1
+fi
+
+echo "PASS: pdes_zero_cost_cut"